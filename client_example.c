@@ -16,6 +16,7 @@
 #include "ramis.h"
 #include "resp_protocol.h"
 #include "respClient.h"
+#include "resp_transaction.h"
 
 
 /* 
@@ -45,6 +46,32 @@
    RESPISERRORMSG     if this is not NULL, you've encountered and error. item->loc points to it.
 */
 
+void
+printItem(RESPITEM *item)
+{
+   switch(item->respType)
+   {
+      case RESPISNULL:     printf("A NULL\n");break;
+      
+      case RESPISFLOAT:    printf("Floating Point:%lf\n",item->rfloat);break;
+      
+      case RESPISINT:      printf("Integer: %lld\n",item->rinteger);break;
+      
+      case RESPISARRAY:    printf("An array of %lld items\n",item->nItems);break;
+      
+      case RESPISBULKSTR:  printf("Bulk string (binary) of length %zd: ",item->length);
+                           fwrite(item->loc,1,item->length,stdout);
+                           printf("\n");
+                           break;
+      
+      case RESPISSTR:      printf("%s\n",item->loc);break;
+      
+      case RESPISPLAINTXT: printf("%s\n",item->loc);break;
+      
+      case RESPISERRORMSG: printf("Error message: %s\n",item->loc);break;
+   }
+}
+
 void
 printResponse(RESPROTO *response)
 {
@@ -52,32 +79,8 @@ printResponse(RESPROTO *response)
  
     if(response)
      {
-       RESPITEM *item=response->items;
-      
-       for(i=0;i<response->nItems;i++,item++)
-       {
-         switch(item->respType)
-         {
-            case RESPISNULL:     printf("A NULL\n");break;
-            
-            case RESPISFLOAT:    printf("Floating Point:%lf\n",item->rfloat);break;
-            
-            case RESPISINT:      printf("Integer: %lld\n",item->rinteger);break;
-            
-            case RESPISARRAY:    printf("An array of %lld items\n",item->nItems);break;
-            
-            case RESPISBULKSTR:  printf("Bulk string (binary) of length %zd: ",item->length);
-                                 fwrite(item->loc,1,item->length,stdout);
-                                 printf("\n");
-                                 break;
-            
-            case RESPISSTR:      printf("%s\n",item->loc);break;
-            
-            case RESPISPLAINTXT: printf("%s\n",item->loc);break;
-            
-            case RESPISERRORMSG: printf("Error message: %s\n",item->loc);break;
-         }
-       }
+       for(i=0;i<response->nItems;i++)
+         printItem(&response->items[i]);
      }
     else printf("NULL response == Error\n");
 }
@@ -368,14 +371,21 @@ int main(int argc, const char * argv[])
      }
 
      
-     response=sendRespCommand(respClient,"MULTI");
-     printResponse(response);
-     printErrors(respClient);
-
-     
-     response=sendRespCommand(respClient,"EXEC");
+     // MULTI, the queued commands and EXEC all go to the server in one write
+     RESPTRANS *transaction=respTransactionBegin(respClient);
+     if(!transaction)
+     {
+        printf("ERROR: respTransactionBegin failed\n");
+        exit(EXIT_FAILURE);
+     }
+     respTransactionAddf(transaction,"SET %s %d","txCounter",1);
+     respTransactionAddf(transaction,"INCR %s","txCounter");
+     response=respTransactionExec(transaction);
      printResponse(response);
      printErrors(respClient);
+     if(response)
+        printItem(respTransactionResult(transaction,1)); // just the INCR
+     respTransactionFree(transaction);
 
 
      
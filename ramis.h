@@ -54,6 +54,39 @@ struct ramisCommandStruct
    uint8_t isImplemented;  // is this command functional yet
 };
 
+// RAMISCMD flags
+#define RAMISCMDWRITE       0x0001 // may modify the dataset
+#define RAMISCMDREADONLY    0x0002 // only reads keys
+#define RAMISCMDDENYOOM     0x0004 // may grow memory use, refused when out of memory
+#define RAMISCMDADMIN       0x0008 // administrative
+#define RAMISCMDPUBSUB      0x0010 // Pub/Sub related
+#define RAMISCMDNOSCRIPT    0x0020 // not allowed in scripts
+#define RAMISCMDRANDOM      0x0040 // output may differ with the same input and dataset
+#define RAMISCMDBLOCKING    0x0080 // may block the connection
+#define RAMISCMDLOADING     0x0100 // allowed while the database is loading
+#define RAMISCMDSTALE       0x0200 // allowed on a replica with stale data
+#define RAMISCMDFAST        0x0400 // O(1) or O(log N)
+#define RAMISCMDMOVABLEKEYS 0x0800 // keys aren't only at firstKey..lastKey by keyStep
+#define RAMISCMDCONTAINER   0x1000 // the real command is the second word, CLIENT LIST etc
+
+// RAMISCMD commandClass
+#define RAMISCLASSGENERIC      0
+#define RAMISCLASSSTRING       1
+#define RAMISCLASSBITMAP       2
+#define RAMISCLASSLIST         3
+#define RAMISCLASSSET          4
+#define RAMISCLASSSORTEDSET    5
+#define RAMISCLASSHASH         6
+#define RAMISCLASSHYPERLOGLOG  7
+#define RAMISCLASSGEO          8
+#define RAMISCLASSSTREAM       9
+#define RAMISCLASSPUBSUB      10
+#define RAMISCLASSTRANSACTIONS 11
+#define RAMISCLASSSCRIPTING   12
+#define RAMISCLASSCONNECTION  13
+#define RAMISCLASSSERVER      14
+#define RAMISCLASSCLUSTER     15
+
 #define TCMD struct tempCmdStruct
 TCMD
 {
@@ -0,0 +1,374 @@
+//
+//  ramis_cmdgen.c
+//  rampart
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Generates ramis_commands.c, the command table and the perfect hash ramisFindCommand()
+//  uses to search it, from the command list in ramis_commands.txt:
+//
+//    cc -o ramis_cmdgen ramis_cmdgen.c && ./ramis_cmdgen ramis_commands.txt > ramis_commands.c
+//
+//  The hash is hash and displace. Commands are grouped into buckets by one part of their
+//  hash. Starting with the biggest bucket, each bucket gets the first displacement that puts
+//  all of its commands in slots nobody has yet. Lookup is one hash, two table reads and
+//  one compare to reject names that aren't commands.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ramis.h"
+#include "ramis_cmdhash.h"
+
+#define CMDGENMAXCOMMANDS 2048
+#define CMDGENMAXDISPLACE 65536
+
+static const struct
+{
+  const char *name;
+  uint64_t    flag;
+  const char *define;
+} flagNames[]=
+{
+  {"write",      RAMISCMDWRITE,      "RAMISCMDWRITE"},
+  {"readonly",   RAMISCMDREADONLY,   "RAMISCMDREADONLY"},
+  {"denyoom",    RAMISCMDDENYOOM,    "RAMISCMDDENYOOM"},
+  {"admin",      RAMISCMDADMIN,      "RAMISCMDADMIN"},
+  {"pubsub",     RAMISCMDPUBSUB,     "RAMISCMDPUBSUB"},
+  {"noscript",   RAMISCMDNOSCRIPT,   "RAMISCMDNOSCRIPT"},
+  {"random",     RAMISCMDRANDOM,     "RAMISCMDRANDOM"},
+  {"blocking",   RAMISCMDBLOCKING,   "RAMISCMDBLOCKING"},
+  {"loading",    RAMISCMDLOADING,    "RAMISCMDLOADING"},
+  {"stale",      RAMISCMDSTALE,      "RAMISCMDSTALE"},
+  {"fast",       RAMISCMDFAST,       "RAMISCMDFAST"},
+  {"movablekeys",RAMISCMDMOVABLEKEYS,"RAMISCMDMOVABLEKEYS"},
+  {"container",  RAMISCMDCONTAINER,  "RAMISCMDCONTAINER"},
+  {NULL,0,NULL}
+};
+
+// in RAMISCLASS* order
+static const char *classNames[]=
+{
+  "generic","string","bitmap","list","set","sortedset","hash","hyperloglog",
+  "geo","stream","pubsub","transactions","scripting","connection","server","cluster",NULL
+};
+
+
+static int
+parseFlags(char *list,uint64_t *flags,int lineNo)
+{
+  char *flag;
+  int   i;
+
+  *flags=0;
+  if(!strcmp(list,"-"))
+    return(RAMISOK);
+  for(flag=strtok(list,",");flag;flag=strtok(NULL,","))
+  {
+    for(i=0;flagNames[i].name && strcmp(flagNames[i].name,flag);i++);
+    if(!flagNames[i].name)
+    {
+      fprintf(stderr,"line %d: unknown flag %s\n",lineNo,flag);
+      return(RAMISFAIL);
+    }
+    *flags|=flagNames[i].flag;
+  }
+  return(RAMISOK);
+}
+
+static int
+classOf(const char *group)
+{
+  int i;
+
+  for(i=0;classNames[i] && strcmp(classNames[i],group);i++);
+  return(classNames[i]?i:-1);
+}
+
+// reads the command list, returns how many commands went into cmds or -1
+static int
+readCommands(FILE *fh,TCMD *cmds)
+{
+  char line[1024],group[64],command[64],flagList[512];
+  int  n=0,lineNo=0,i;
+  TCMD *c;
+
+  while(fgets(line,sizeof(line),fh))
+  {
+    ++lineNo;
+    for(i=0;isspace((unsigned char)line[i]);i++);
+    if(!line[i] || line[i]=='#')
+      continue;
+    if(n==CMDGENMAXCOMMANDS)
+    {
+      fprintf(stderr,"line %d: more than %d commands\n",lineNo,CMDGENMAXCOMMANDS);
+      return(-1);
+    }
+    c=&cmds[n];
+    memset(c,0,sizeof(TCMD));
+    if(sscanf(line,"%63s %63s %d %d %d %d %511s",group,command,&c->arity,&c->firstKeyIndex,&c->lastKeyIndex,&c->keyStep,flagList)!=7)
+    {
+      fprintf(stderr,"line %d: expected group command arity firstKey lastKey keyStep flags\n",lineNo);
+      return(-1);
+    }
+    if(classOf(group)<0)
+    {
+      fprintf(stderr,"line %d: unknown group %s\n",lineNo,group);
+      return(-1);
+    }
+    if(!parseFlags(flagList,&c->flags,lineNo))
+      return(-1);
+    for(i=0;command[i];i++)
+      command[i]=tolower((unsigned char)command[i]);
+    c->group=strdup(group);
+    c->command=strdup(command);
+    c->varArgs=c->arity<0;
+    c->minArgs=abs(c->arity)-1;
+    c->optionalArgs=c->varArgs;
+    ++n;
+  }
+  return(n);
+}
+
+static int
+compareCommands(const void *a,const void *b)
+{
+  return(strcmp(((const TCMD *)a)->command,((const TCMD *)b)->command));
+}
+
+static uint32_t
+powerOf2AtLeast(uint32_t n)
+{
+  uint32_t p=1;
+
+  while(p<n)
+    p<<=1;
+  return(p);
+}
+
+
+static TCMD     cmds[CMDGENMAXCOMMANDS];
+static uint64_t hashes[CMDGENMAXCOMMANDS];
+static int      bucketOf[CMDGENMAXCOMMANDS];
+
+static uint32_t *bucketSizes; // for sorting buckets biggest first
+
+static int
+compareBuckets(const void *a,const void *b)
+{
+  uint32_t sa=bucketSizes[*(const uint32_t *)a];
+  uint32_t sb=bucketSizes[*(const uint32_t *)b];
+
+  if(sa!=sb)
+    return(sa>sb?-1:1);
+  return(*(const uint32_t *)a<*(const uint32_t *)b?-1:1);
+}
+
+// finds a displacement for every bucket, fills slots with command indexes
+static int
+buildPerfectHash(int n,uint32_t nBuckets,uint32_t nSlots,uint32_t *displacement,int *slots)
+{
+  uint32_t *order=calloc(nBuckets,sizeof(uint32_t));
+  uint32_t *trial=calloc(n,sizeof(uint32_t));
+  uint32_t  b,d,k;
+  int       i,j,members,ok;
+
+  bucketSizes=calloc(nBuckets,sizeof(uint32_t));
+  if(!order || !trial || !bucketSizes)
+    return(RAMISFAIL);
+
+  for(i=0;i<n;i++)
+  {
+    hashes[i]=ramisCmdHash(cmds[i].command,strlen(cmds[i].command));
+    bucketOf[i]=ramisCmdBucket(hashes[i],nBuckets-1);
+    ++bucketSizes[bucketOf[i]];
+  }
+  for(b=0;b<nBuckets;b++)
+    order[b]=b;
+  qsort(order,nBuckets,sizeof(uint32_t),compareBuckets);
+  for(k=0;k<nSlots;k++)
+    slots[k]=-1;
+
+  for(b=0;b<nBuckets;b++)
+  {
+    displacement[order[b]]=0;
+    if(!bucketSizes[order[b]])
+      continue;
+    for(d=0;d<CMDGENMAXDISPLACE;d++)
+    {
+      for(ok=1,members=0,i=0;ok && i<n;i++)
+      {
+        if(bucketOf[i]!=(int)order[b])
+          continue;
+        trial[members]=ramisCmdSlot(hashes[i],d,nSlots-1);
+        if(slots[trial[members]]>=0)
+          ok=0;
+        for(j=0;ok && j<members;j++)
+          if(trial[j]==trial[members])
+            ok=0;
+        ++members;
+      }
+      if(ok)
+        break;
+    }
+    if(d==CMDGENMAXDISPLACE)
+    {
+      fprintf(stderr,"no displacement works for bucket %u\n",order[b]);
+      return(RAMISFAIL);
+    }
+    displacement[order[b]]=d;
+    for(members=0,i=0;i<n;i++)
+      if(bucketOf[i]==(int)order[b])
+        slots[trial[members++]]=i;
+  }
+  free(order);
+  free(trial);
+  free(bucketSizes);
+  return(RAMISOK);
+}
+
+
+static void
+printFlags(uint64_t flags)
+{
+  int i,printed=0;
+
+  for(i=0;flagNames[i].name;i++)
+    if(flags&flagNames[i].flag)
+      printf("%s%s",printed++?"|":"",flagNames[i].define);
+  if(!printed)
+    printf("0");
+}
+
+static void
+printClass(const char *group)
+{
+  printf("RAMISCLASS");
+  while(*group)
+    putchar(toupper((unsigned char)*group++));
+}
+
+static void
+printTable(int n,uint32_t nBuckets,uint32_t nSlots,uint32_t *displacement,int *slots,char *source)
+{
+  int i;
+  uint32_t k;
+
+  printf("//\n//  ramis_commands.c\n//  rampart\n//\n");
+  printf("//  Generated by ramis_cmdgen from %s, do not edit.\n//\n\n",source);
+  printf("#include <stdio.h>\n#include <stdlib.h>\n#include <strings.h>\n");
+  printf("#include \"ramis.h\"\n#include \"resp_protocol.h\"\n#include \"ramis_cmdhash.h\"\n\n");
+  printf("#define RAMISNCOMMANDS     %d\n",n);
+  printf("#define RAMISCMDBUCKETMASK %u\n",nBuckets-1);
+  printf("#define RAMISCMDSLOTMASK   %u\n\n",nSlots-1);
+
+  printf("// command,syntax,desc,handler,flags,invocations,commandClass,spaceCommand,minArgs,optionalArgs,isVarArg,arity,firstKey,lastKey,keyStep,isImplemented\n");
+  printf("static RAMISCMD ramisCommands[RAMISNCOMMANDS]=\n{\n");
+  for(i=0;i<n;i++)
+  {
+    printf("  {\"%s\",NULL,NULL,NULL,",cmds[i].command);
+    printFlags(cmds[i].flags);
+    printf(",0,");
+    printClass(cmds[i].group);
+    printf(",%d,%d,%d,%d,%d,%d,%d,%d,0}%s\n",(cmds[i].flags&RAMISCMDCONTAINER)?1:0,cmds[i].minArgs,cmds[i].optionalArgs,
+           cmds[i].varArgs,cmds[i].arity,cmds[i].firstKeyIndex,cmds[i].lastKeyIndex,cmds[i].keyStep,i<n-1?",":"");
+  }
+  printf("};\n\n");
+
+  printf("static const uint8_t ramisCmdLength[RAMISNCOMMANDS]=\n{");
+  for(i=0;i<n;i++)
+    printf("%s%zu%s",i%16?"":"\n  ",strlen(cmds[i].command),i<n-1?",":"");
+  printf("\n};\n\n");
+
+  printf("static const uint16_t ramisCmdDisplacement[RAMISCMDBUCKETMASK+1]=\n{");
+  for(k=0;k<nBuckets;k++)
+    printf("%s%u%s",k%16?"":"\n  ",displacement[k],k<nBuckets-1?",":"");
+  printf("\n};\n\n");
+
+  printf("static const int16_t ramisCmdSlots[RAMISCMDSLOTMASK+1]=\n{");
+  for(k=0;k<nSlots;k++)
+    printf("%s%d%s",k%16?"":"\n  ",slots[k],k<nSlots-1?",":"");
+  printf("\n};\n\n");
+
+  printf("%s",
+"\n"
+"// sees if it's a legitimate command and if so provides info about it, case doesn't matter\n"
+"RAMISCMD *\n"
+"ramisFindCommand(register const char *str,register unsigned int len)\n"
+"{\n"
+"  uint64_t h=ramisCmdHash(str,len);\n"
+"  uint32_t d=ramisCmdDisplacement[ramisCmdBucket(h,RAMISCMDBUCKETMASK)];\n"
+"  int      i=ramisCmdSlots[ramisCmdSlot(h,d,RAMISCMDSLOTMASK)];\n"
+"\n"
+"  if(i<0 || ramisCmdLength[i]!=len || strncasecmp(str,ramisCommands[i].command,len))\n"
+"    return(NULL);\n"
+"  return(&ramisCommands[i]);\n"
+"}\n"
+"\n"
+"int\n"
+"ramisCommandCount(void)\n"
+"{\n"
+"  return(RAMISNCOMMANDS);\n"
+"}\n"
+"\n"
+"// the command's position in the table, for keeping per command data in arrays\n"
+"int\n"
+"ramisCommandIndex(const RAMISCMD *cmd)\n"
+"{\n"
+"  return((int)(cmd-ramisCommands));\n"
+"}\n"
+"\n"
+"RAMISCMD *\n"
+"ramisCommandAt(int i)\n"
+"{\n"
+"  if(i<0 || i>=RAMISNCOMMANDS)\n"
+"    return(NULL);\n"
+"  return(&ramisCommands[i]);\n"
+"}\n");
+}
+
+
+int
+main(int argc,char **argv)
+{
+  uint32_t *displacement;
+  int      *slots;
+  uint32_t  nBuckets,nSlots;
+  FILE     *fh;
+  int       n,i;
+
+  if(argc!=2)
+  {
+    fprintf(stderr,"usage: %s ramis_commands.txt > ramis_commands.c\n",argv[0]);
+    return(EXIT_FAILURE);
+  }
+  if(!(fh=fopen(argv[1],"r")))
+  {
+    perror(argv[1]);
+    return(EXIT_FAILURE);
+  }
+  n=readCommands(fh,cmds);
+  fclose(fh);
+  if(n<=0)
+    return(EXIT_FAILURE);
+  qsort(cmds,n,sizeof(TCMD),compareCommands);
+  for(i=1;i<n;i++)
+    if(!strcmp(cmds[i-1].command,cmds[i].command))
+    {
+      fprintf(stderr,"%s is listed twice\n",cmds[i].command);
+      return(EXIT_FAILURE);
+    }
+
+  // about four commands a bucket and a fifth of the slots spare keeps the search short
+  nBuckets=powerOf2AtLeast((n+3)/4);
+  nSlots=powerOf2AtLeast(n+n/4);
+  displacement=calloc(nBuckets,sizeof(uint32_t));
+  slots=calloc(nSlots,sizeof(int));
+  if(!displacement || !slots || !buildPerfectHash(n,nBuckets,nSlots,displacement,slots))
+    return(EXIT_FAILURE);
+
+  printTable(n,nBuckets,nSlots,displacement,slots,argv[1]);
+  return(EXIT_SUCCESS);
+}
@@ -0,0 +1,53 @@
+//
+//  ramis_cmdhash.h
+//  rampart
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The hash behind ramisFindCommand(). ramis_cmdgen uses the same functions to pick the
+//  displacements so the generated table and the lookup can't disagree.
+//  A name hashes to a bucket, and the bucket's displacement picks its slot. The generator
+//  chose the displacements so that every command has a slot of its own.
+//
+
+#ifndef ramis_cmdhash_h
+#define ramis_cmdhash_h
+#include <stdint.h>
+
+// FNV-1a of the name folded to lower case
+static inline uint64_t
+ramisCmdHash(const char *str,unsigned int len)
+{
+  uint64_t h=14695981039346656037ULL;
+
+  while(len--)
+  {
+    unsigned char c=*str++;
+    if(c>='A' && c<='Z')
+      c+='a'-'A';
+    h^=c;
+    h*=1099511628211ULL;
+  }
+  return(h);
+}
+
+static inline uint32_t
+ramisCmdBucket(uint64_t h,uint32_t bucketMask)
+{
+  return((uint32_t)(h>>32)&bucketMask);
+}
+
+static inline uint32_t
+ramisCmdSlot(uint64_t h,uint32_t displacement,uint32_t slotMask)
+{
+  uint32_t x=(uint32_t)h+displacement*0x9e3779b9u;
+
+  x^=x>>16;
+  x*=0x85ebca6b;
+  x^=x>>13;
+  x*=0xc2b2ae35;
+  x^=x>>16;
+  return(x&slotMask);
+}
+
+#endif /* ramis_cmdhash_h */
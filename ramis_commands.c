@@ -0,0 +1,360 @@
+//
+//  ramis_commands.c
+//  rampart
+//
+//  Generated by ramis_cmdgen from ramis_commands.txt, do not edit.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "ramis_cmdhash.h"
+
+#define RAMISNCOMMANDS     240
+#define RAMISCMDBUCKETMASK 63
+#define RAMISCMDSLOTMASK   511
+
+// command,syntax,desc,handler,flags,invocations,commandClass,spaceCommand,minArgs,optionalArgs,isVarArg,arity,firstKey,lastKey,keyStep,isImplemented
+static RAMISCMD ramisCommands[RAMISNCOMMANDS]=
+{
+  {"acl",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSERVER,1,1,1,1,-2,0,0,0,0},
+  {"append",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,2,0,0,3,1,1,1,0},
+  {"asking",NULL,NULL,NULL,RAMISCMDFAST,0,RAMISCLASSCLUSTER,0,0,0,0,1,0,0,0,0},
+  {"auth",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,1,1,1,-2,0,0,0,0},
+  {"bgrewriteaof",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"bgsave",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"bitcount",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSBITMAP,0,1,1,1,-2,1,1,1,0},
+  {"bitfield",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSBITMAP,0,1,1,1,-2,1,1,1,0},
+  {"bitfield_ro",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSBITMAP,0,1,1,1,-2,1,1,1,0},
+  {"bitop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSBITMAP,0,3,1,1,-4,2,-1,1,0},
+  {"bitpos",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSBITMAP,0,2,1,1,-3,1,1,1,0},
+  {"blmove",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDNOSCRIPT|RAMISCMDBLOCKING,0,RAMISCLASSLIST,0,5,0,0,6,1,2,1,0},
+  {"blmpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDBLOCKING|RAMISCMDMOVABLEKEYS,0,RAMISCLASSLIST,0,4,1,1,-5,0,0,0,0},
+  {"blpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDNOSCRIPT|RAMISCMDBLOCKING,0,RAMISCLASSLIST,0,2,1,1,-3,1,-2,1,0},
+  {"brpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDNOSCRIPT|RAMISCMDBLOCKING,0,RAMISCLASSLIST,0,2,1,1,-3,1,-2,1,0},
+  {"brpoplpush",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDNOSCRIPT|RAMISCMDBLOCKING,0,RAMISCLASSLIST,0,3,0,0,4,1,2,1,0},
+  {"bzmpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDBLOCKING|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,4,1,1,-5,0,0,0,0},
+  {"bzpopmax",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDNOSCRIPT|RAMISCMDBLOCKING|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,1,-2,1,0},
+  {"bzpopmin",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDNOSCRIPT|RAMISCMDBLOCKING|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,1,-2,1,0},
+  {"client",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSCONNECTION,1,1,1,1,-2,0,0,0,0},
+  {"cluster",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSCLUSTER,1,1,1,1,-2,0,0,0,0},
+  {"command",NULL,NULL,NULL,RAMISCMDRANDOM|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDCONTAINER,0,RAMISCLASSSERVER,1,0,1,1,-1,0,0,0,0},
+  {"config",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSERVER,1,1,1,1,-2,0,0,0,0},
+  {"copy",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSGENERIC,0,2,1,1,-3,1,2,1,0},
+  {"dbsize",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"debug",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,1,1,1,-2,0,0,0,0},
+  {"decr",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,1,0,0,2,1,1,1,0},
+  {"decrby",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,2,0,0,3,1,1,1,0},
+  {"del",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSGENERIC,0,1,1,1,-2,1,-1,1,0},
+  {"discard",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSTRANSACTIONS,0,0,0,0,1,0,0,0,0},
+  {"dump",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSGENERIC,0,1,0,0,2,1,1,1,0},
+  {"echo",NULL,NULL,NULL,RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,1,0,0,2,0,0,0,0},
+  {"eval",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDSTALE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSCRIPTING,0,2,1,1,-3,0,0,0,0},
+  {"eval_ro",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDNOSCRIPT|RAMISCMDSTALE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSCRIPTING,0,2,1,1,-3,0,0,0,0},
+  {"evalsha",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDSTALE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSCRIPTING,0,2,1,1,-3,0,0,0,0},
+  {"evalsha_ro",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDNOSCRIPT|RAMISCMDSTALE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSCRIPTING,0,2,1,1,-3,0,0,0,0},
+  {"exec",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSTRANSACTIONS,0,0,0,0,1,0,0,0,0},
+  {"exists",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,1,1,-2,1,-1,1,0},
+  {"expire",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,2,1,1,-3,1,1,1,0},
+  {"expireat",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,2,1,1,-3,1,1,1,0},
+  {"expiretime",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,0,0,2,1,1,1,0},
+  {"failover",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"fcall",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDSTALE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSCRIPTING,0,2,1,1,-3,0,0,0,0},
+  {"fcall_ro",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDNOSCRIPT|RAMISCMDSTALE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSCRIPTING,0,2,1,1,-3,0,0,0,0},
+  {"flushall",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"flushdb",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"function",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSCRIPTING,1,1,1,1,-2,0,0,0,0},
+  {"geoadd",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSGEO,0,4,1,1,-5,1,1,1,0},
+  {"geodist",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSGEO,0,3,1,1,-4,1,1,1,0},
+  {"geohash",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSGEO,0,1,1,1,-2,1,1,1,0},
+  {"geopos",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSGEO,0,1,1,1,-2,1,1,1,0},
+  {"georadius",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDMOVABLEKEYS,0,RAMISCLASSGEO,0,5,1,1,-6,1,1,1,0},
+  {"georadius_ro",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSGEO,0,5,1,1,-6,1,1,1,0},
+  {"georadiusbymember",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDMOVABLEKEYS,0,RAMISCLASSGEO,0,4,1,1,-5,1,1,1,0},
+  {"georadiusbymember_ro",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSGEO,0,4,1,1,-5,1,1,1,0},
+  {"geosearch",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSGEO,0,6,1,1,-7,1,1,1,0},
+  {"geosearchstore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSGEO,0,7,1,1,-8,1,2,1,0},
+  {"get",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSTRING,0,1,0,0,2,1,1,1,0},
+  {"getbit",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSBITMAP,0,2,0,0,3,1,1,1,0},
+  {"getdel",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSTRING,0,1,0,0,2,1,1,1,0},
+  {"getex",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSTRING,0,1,1,1,-2,1,1,1,0},
+  {"getrange",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSTRING,0,3,0,0,4,1,1,1,0},
+  {"getset",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,2,0,0,3,1,1,1,0},
+  {"hdel",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSHASH,0,2,1,1,-3,1,1,1,0},
+  {"hello",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,0,1,1,-1,0,0,0,0},
+  {"hexists",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSHASH,0,2,0,0,3,1,1,1,0},
+  {"hget",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSHASH,0,2,0,0,3,1,1,1,0},
+  {"hgetall",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSHASH,0,1,0,0,2,1,1,1,0},
+  {"hincrby",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSHASH,0,3,0,0,4,1,1,1,0},
+  {"hincrbyfloat",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSHASH,0,3,0,0,4,1,1,1,0},
+  {"hkeys",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSHASH,0,1,0,0,2,1,1,1,0},
+  {"hlen",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSHASH,0,1,0,0,2,1,1,1,0},
+  {"hmget",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSHASH,0,2,1,1,-3,1,1,1,0},
+  {"hmset",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSHASH,0,3,1,1,-4,1,1,1,0},
+  {"hrandfield",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSHASH,0,1,1,1,-2,1,1,1,0},
+  {"hscan",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSHASH,0,2,1,1,-3,1,1,1,0},
+  {"hset",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSHASH,0,3,1,1,-4,1,1,1,0},
+  {"hsetnx",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSHASH,0,3,0,0,4,1,1,1,0},
+  {"hstrlen",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSHASH,0,2,0,0,3,1,1,1,0},
+  {"hvals",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSHASH,0,1,0,0,2,1,1,1,0},
+  {"incr",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,1,0,0,2,1,1,1,0},
+  {"incrby",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,2,0,0,3,1,1,1,0},
+  {"incrbyfloat",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,2,0,0,3,1,1,1,0},
+  {"info",NULL,NULL,NULL,RAMISCMDRANDOM|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"keys",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSGENERIC,0,1,0,0,2,0,0,0,0},
+  {"lastsave",NULL,NULL,NULL,RAMISCMDRANDOM|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"latency",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSERVER,1,1,1,1,-2,0,0,0,0},
+  {"lcs",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSTRING,0,2,1,1,-3,1,2,1,0},
+  {"lindex",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSLIST,0,2,0,0,3,1,1,1,0},
+  {"linsert",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSLIST,0,4,0,0,5,1,1,1,0},
+  {"llen",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSLIST,0,1,0,0,2,1,1,1,0},
+  {"lmove",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSLIST,0,4,0,0,5,1,2,1,0},
+  {"lmpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSLIST,0,3,1,1,-4,0,0,0,0},
+  {"lolwut",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"lpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSLIST,0,1,1,1,-2,1,1,1,0},
+  {"lpos",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSLIST,0,2,1,1,-3,1,1,1,0},
+  {"lpush",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSLIST,0,2,1,1,-3,1,1,1,0},
+  {"lpushx",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSLIST,0,2,1,1,-3,1,1,1,0},
+  {"lrange",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSLIST,0,3,0,0,4,1,1,1,0},
+  {"lrem",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSLIST,0,3,0,0,4,1,1,1,0},
+  {"lset",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSLIST,0,3,0,0,4,1,1,1,0},
+  {"ltrim",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSLIST,0,3,0,0,4,1,1,1,0},
+  {"memory",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSERVER,1,1,1,1,-2,0,0,0,0},
+  {"mget",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSTRING,0,1,1,1,-2,1,-1,1,0},
+  {"migrate",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSGENERIC,0,5,1,1,-6,3,3,1,0},
+  {"module",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSERVER,1,1,1,1,-2,0,0,0,0},
+  {"monitor",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"move",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,2,0,0,3,1,1,1,0},
+  {"mset",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSTRING,0,2,1,1,-3,1,-1,2,0},
+  {"msetnx",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSTRING,0,2,1,1,-3,1,-1,2,0},
+  {"multi",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSTRANSACTIONS,0,0,0,0,1,0,0,0,0},
+  {"object",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSGENERIC,1,1,1,1,-2,0,0,0,0},
+  {"persist",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,0,0,2,1,1,1,0},
+  {"pexpire",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,2,1,1,-3,1,1,1,0},
+  {"pexpireat",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,2,1,1,-3,1,1,1,0},
+  {"pexpiretime",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,0,0,2,1,1,1,0},
+  {"pfadd",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSHYPERLOGLOG,0,1,1,1,-2,1,1,1,0},
+  {"pfcount",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSHYPERLOGLOG,0,1,1,1,-2,1,-1,1,0},
+  {"pfdebug",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDADMIN,0,RAMISCLASSHYPERLOGLOG,0,2,0,0,3,2,2,1,0},
+  {"pfmerge",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSHYPERLOGLOG,0,1,1,1,-2,1,-1,1,0},
+  {"pfselftest",NULL,NULL,NULL,RAMISCMDADMIN,0,RAMISCLASSHYPERLOGLOG,0,0,0,0,1,0,0,0,0},
+  {"ping",NULL,NULL,NULL,RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,0,1,1,-1,0,0,0,0},
+  {"psetex",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSTRING,0,3,0,0,4,1,1,1,0},
+  {"psubscribe",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSPUBSUB,0,1,1,1,-2,0,0,0,0},
+  {"psync",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT,0,RAMISCLASSSERVER,0,2,1,1,-3,0,0,0,0},
+  {"pttl",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,0,0,2,1,1,1,0},
+  {"publish",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSPUBSUB,0,2,0,0,3,0,0,0,0},
+  {"pubsub",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSPUBSUB,1,1,1,1,-2,0,0,0,0},
+  {"punsubscribe",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSPUBSUB,0,0,1,1,-1,0,0,0,0},
+  {"quit",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,0,1,1,-1,0,0,0,0},
+  {"randomkey",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSGENERIC,0,0,0,0,1,0,0,0,0},
+  {"readonly",NULL,NULL,NULL,RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,0,0,0,1,0,0,0,0},
+  {"readwrite",NULL,NULL,NULL,RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,0,0,0,1,0,0,0,0},
+  {"rename",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSGENERIC,0,2,0,0,3,1,2,1,0},
+  {"renamenx",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,2,0,0,3,1,2,1,0},
+  {"replconf",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"replicaof",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,2,0,0,3,0,0,0,0},
+  {"reset",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,0,0,0,1,0,0,0,0},
+  {"restore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSGENERIC,0,3,1,1,-4,1,1,1,0},
+  {"role",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"rpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSLIST,0,1,1,1,-2,1,1,1,0},
+  {"rpoplpush",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSLIST,0,2,0,0,3,1,2,1,0},
+  {"rpush",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSLIST,0,2,1,1,-3,1,1,1,0},
+  {"rpushx",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSLIST,0,2,1,1,-3,1,1,1,0},
+  {"sadd",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSET,0,2,1,1,-3,1,1,1,0},
+  {"save",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"scan",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSGENERIC,0,1,1,1,-2,0,0,0,0},
+  {"scard",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSET,0,1,0,0,2,1,1,1,0},
+  {"script",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSCRIPTING,1,1,1,1,-2,0,0,0,0},
+  {"sdiff",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSET,0,1,1,1,-2,1,-1,1,0},
+  {"sdiffstore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSET,0,2,1,1,-3,1,-1,1,0},
+  {"select",NULL,NULL,NULL,RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSCONNECTION,0,1,0,0,2,0,0,0,0},
+  {"set",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSTRING,0,2,1,1,-3,1,1,1,0},
+  {"setbit",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSBITMAP,0,3,0,0,4,1,1,1,0},
+  {"setex",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSTRING,0,3,0,0,4,1,1,1,0},
+  {"setnx",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTRING,0,2,0,0,3,1,1,1,0},
+  {"setrange",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSTRING,0,3,0,0,4,1,1,1,0},
+  {"shutdown",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,0,1,1,-1,0,0,0,0},
+  {"sinter",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSET,0,1,1,1,-2,1,-1,1,0},
+  {"sintercard",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSET,0,2,1,1,-3,0,0,0,0},
+  {"sinterstore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSET,0,2,1,1,-3,1,-1,1,0},
+  {"sismember",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSET,0,2,0,0,3,1,1,1,0},
+  {"slaveof",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT|RAMISCMDSTALE,0,RAMISCLASSSERVER,0,2,0,0,3,0,0,0,0},
+  {"slowlog",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSERVER,1,1,1,1,-2,0,0,0,0},
+  {"smembers",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSET,0,1,0,0,2,1,1,1,0},
+  {"smismember",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSET,0,2,1,1,-3,1,1,1,0},
+  {"smove",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSET,0,3,0,0,4,1,2,1,0},
+  {"sort",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDMOVABLEKEYS,0,RAMISCLASSGENERIC,0,1,1,1,-2,1,1,1,0},
+  {"sort_ro",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDMOVABLEKEYS,0,RAMISCLASSGENERIC,0,1,1,1,-2,1,1,1,0},
+  {"spop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDRANDOM|RAMISCMDFAST,0,RAMISCLASSSET,0,1,1,1,-2,1,1,1,0},
+  {"spublish",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSPUBSUB,0,2,0,0,3,1,1,1,0},
+  {"srandmember",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSSET,0,1,1,1,-2,1,1,1,0},
+  {"srem",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSET,0,2,1,1,-3,1,1,1,0},
+  {"sscan",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSSET,0,2,1,1,-3,1,1,1,0},
+  {"ssubscribe",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSPUBSUB,0,1,1,1,-2,1,-1,1,0},
+  {"strlen",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSTRING,0,1,0,0,2,1,1,1,0},
+  {"subscribe",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSPUBSUB,0,1,1,1,-2,0,0,0,0},
+  {"substr",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSTRING,0,3,0,0,4,1,1,1,0},
+  {"sunion",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSET,0,1,1,1,-2,1,-1,1,0},
+  {"sunionstore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSET,0,2,1,1,-3,1,-1,1,0},
+  {"sunsubscribe",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSPUBSUB,0,0,1,1,-1,1,-1,1,0},
+  {"swapdb",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSERVER,0,2,0,0,3,0,0,0,0},
+  {"sync",NULL,NULL,NULL,RAMISCMDADMIN|RAMISCMDNOSCRIPT,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"time",NULL,NULL,NULL,RAMISCMDRANDOM|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSSERVER,0,0,0,0,1,0,0,0,0},
+  {"touch",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,1,1,-2,1,-1,1,0},
+  {"ttl",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,0,0,2,1,1,1,0},
+  {"type",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,0,0,2,1,1,1,0},
+  {"unlink",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSGENERIC,0,1,1,1,-2,1,-1,1,0},
+  {"unsubscribe",NULL,NULL,NULL,RAMISCMDPUBSUB|RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE,0,RAMISCLASSPUBSUB,0,0,1,1,-1,0,0,0,0},
+  {"unwatch",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSTRANSACTIONS,0,0,0,0,1,0,0,0,0},
+  {"wait",NULL,NULL,NULL,RAMISCMDNOSCRIPT,0,RAMISCLASSGENERIC,0,2,0,0,3,0,0,0,0},
+  {"waitaof",NULL,NULL,NULL,RAMISCMDNOSCRIPT,0,RAMISCLASSGENERIC,0,3,0,0,4,0,0,0,0},
+  {"watch",NULL,NULL,NULL,RAMISCMDNOSCRIPT|RAMISCMDLOADING|RAMISCMDSTALE|RAMISCMDFAST,0,RAMISCLASSTRANSACTIONS,0,1,1,1,-2,1,-1,1,0},
+  {"xack",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSTREAM,0,3,1,1,-4,1,1,1,0},
+  {"xadd",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTREAM,0,4,1,1,-5,1,1,1,0},
+  {"xautoclaim",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSTREAM,0,5,1,1,-6,1,1,1,0},
+  {"xclaim",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSTREAM,0,5,1,1,-6,1,1,1,0},
+  {"xdel",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSTREAM,0,2,1,1,-3,1,1,1,0},
+  {"xgroup",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSTREAM,1,1,1,1,-2,0,0,0,0},
+  {"xinfo",NULL,NULL,NULL,RAMISCMDCONTAINER,0,RAMISCLASSSTREAM,1,1,1,1,-2,0,0,0,0},
+  {"xlen",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSTREAM,0,1,0,0,2,1,1,1,0},
+  {"xpending",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSTREAM,0,2,1,1,-3,1,1,1,0},
+  {"xrange",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSTREAM,0,3,1,1,-4,1,1,1,0},
+  {"xread",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDBLOCKING|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSTREAM,0,3,1,1,-4,0,0,0,0},
+  {"xreadgroup",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDBLOCKING|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSTREAM,0,6,1,1,-7,0,0,0,0},
+  {"xrevrange",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSTREAM,0,3,1,1,-4,1,1,1,0},
+  {"xsetid",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSTREAM,0,2,1,1,-3,1,1,1,0},
+  {"xtrim",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSSTREAM,0,3,1,1,-4,1,1,1,0},
+  {"zadd",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zcard",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,1,0,0,2,1,1,1,0},
+  {"zcount",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,3,0,0,4,1,1,1,0},
+  {"zdiff",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,0,0,0,0},
+  {"zdiffstore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zincrby",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,3,0,0,4,1,1,1,0},
+  {"zinter",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,0,0,0,0},
+  {"zintercard",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,0,0,0,0},
+  {"zinterstore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zlexcount",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,3,0,0,4,1,1,1,0},
+  {"zmpop",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,0,0,0,0},
+  {"zmscore",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,1,1,1,0},
+  {"zpopmax",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,1,1,1,-2,1,1,1,0},
+  {"zpopmin",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,1,1,1,-2,1,1,1,0},
+  {"zrandmember",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSSORTEDSET,0,1,1,1,-2,1,1,1,0},
+  {"zrange",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zrangebylex",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zrangebyscore",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zrangestore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM,0,RAMISCLASSSORTEDSET,0,4,1,1,-5,1,2,1,0},
+  {"zrank",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,1,1,1,0},
+  {"zrem",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,1,1,1,0},
+  {"zremrangebylex",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSSORTEDSET,0,3,0,0,4,1,1,1,0},
+  {"zremrangebyrank",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSSORTEDSET,0,3,0,0,4,1,1,1,0},
+  {"zremrangebyscore",NULL,NULL,NULL,RAMISCMDWRITE,0,RAMISCLASSSORTEDSET,0,3,0,0,4,1,1,1,0},
+  {"zrevrange",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zrevrangebylex",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zrevrangebyscore",NULL,NULL,NULL,RAMISCMDREADONLY,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0},
+  {"zrevrank",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,1,1,1,0},
+  {"zscan",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDRANDOM,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,1,1,1,0},
+  {"zscore",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDFAST,0,RAMISCLASSSORTEDSET,0,2,0,0,3,1,1,1,0},
+  {"zunion",NULL,NULL,NULL,RAMISCMDREADONLY|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,2,1,1,-3,0,0,0,0},
+  {"zunionstore",NULL,NULL,NULL,RAMISCMDWRITE|RAMISCMDDENYOOM|RAMISCMDMOVABLEKEYS,0,RAMISCLASSSORTEDSET,0,3,1,1,-4,1,1,1,0}
+};
+
+static const uint8_t ramisCmdLength[RAMISNCOMMANDS]=
+{
+  3,6,6,4,12,6,8,8,11,5,6,6,6,5,5,10,
+  6,8,8,6,7,7,6,4,6,5,4,6,3,7,4,4,
+  4,7,7,10,4,6,6,8,10,8,5,8,8,7,8,6,
+  7,7,6,9,12,17,20,9,14,3,6,6,5,8,6,4,
+  5,7,4,7,7,12,5,4,5,5,10,5,4,6,7,5,
+  4,6,11,4,4,8,7,3,6,7,4,5,5,6,4,4,
+  5,6,6,4,4,5,6,4,7,6,7,4,4,6,5,6,
+  7,7,9,11,5,7,7,7,10,4,6,10,5,4,7,6,
+  12,4,9,8,9,6,8,8,9,5,7,4,4,9,5,6,
+  4,4,4,5,6,5,10,6,3,6,5,5,8,8,6,10,
+  11,9,7,7,8,10,5,4,7,4,8,11,4,5,10,6,
+  9,6,6,11,12,6,4,4,5,3,4,6,11,7,4,7,
+  5,4,4,10,6,4,6,5,4,8,6,5,10,9,6,5,
+  4,5,6,5,10,7,6,10,11,9,5,7,7,7,11,6,
+  11,13,11,5,4,14,15,16,9,14,16,8,5,6,6,11
+};
+
+static const uint16_t ramisCmdDisplacement[RAMISCMDBUCKETMASK+1]=
+{
+  1,0,0,1,2,0,2,0,1,1,0,2,0,1,0,4,
+  0,1,0,3,1,1,0,1,0,0,1,3,0,3,6,0,
+  0,2,1,4,0,0,0,2,0,0,3,0,7,1,0,0,
+  1,0,2,0,5,1,3,2,0,3,7,1,4,7,6,2
+};
+
+static const int16_t ramisCmdSlots[RAMISCMDSLOTMASK+1]=
+{
+  -1,-1,-1,42,196,51,-1,80,-1,-1,-1,-1,-1,-1,-1,43,
+  26,-1,-1,-1,63,16,-1,127,189,-1,-1,-1,111,-1,-1,181,
+  -1,168,-1,89,91,-1,-1,112,226,-1,25,182,-1,-1,88,-1,
+  -1,-1,68,-1,57,-1,171,-1,-1,56,-1,-1,76,18,-1,-1,
+  -1,143,-1,134,-1,235,-1,-1,104,-1,-1,175,107,7,-1,71,
+  -1,-1,-1,159,-1,28,-1,-1,29,-1,84,217,-1,60,234,38,
+  -1,-1,37,-1,228,-1,-1,220,122,23,-1,150,179,-1,-1,-1,
+  123,-1,198,1,-1,183,-1,-1,94,-1,-1,-1,-1,64,209,-1,
+  -1,191,201,-1,-1,-1,-1,-1,207,-1,-1,-1,-1,138,-1,-1,
+  -1,-1,-1,-1,210,-1,67,108,-1,199,-1,149,151,-1,-1,124,
+  73,90,139,223,97,-1,-1,-1,-1,-1,113,-1,-1,-1,153,177,
+  176,-1,169,-1,-1,-1,-1,-1,118,-1,163,61,35,-1,-1,-1,
+  106,-1,14,193,-1,-1,-1,154,-1,-1,-1,-1,-1,-1,195,-1,
+  -1,-1,116,-1,-1,79,132,-1,205,11,4,-1,33,190,-1,161,
+  -1,-1,-1,222,-1,95,117,-1,-1,58,93,109,-1,-1,65,164,
+  214,-1,30,-1,192,230,219,229,160,-1,-1,-1,125,102,-1,197,
+  -1,-1,-1,137,-1,75,-1,-1,-1,215,-1,184,-1,-1,31,146,
+  40,166,157,202,-1,-1,-1,5,129,208,-1,-1,218,-1,-1,-1,
+  -1,-1,44,6,-1,-1,180,96,155,-1,-1,-1,-1,24,-1,-1,
+  204,110,136,55,85,221,-1,148,-1,213,-1,237,231,-1,34,121,
+  -1,232,-1,-1,-1,10,-1,-1,236,131,-1,-1,188,49,-1,173,
+  114,99,-1,156,-1,-1,152,158,19,-1,21,119,2,-1,101,66,
+  212,-1,-1,-1,62,-1,69,-1,-1,53,130,206,-1,162,17,0,
+  -1,-1,-1,178,-1,227,-1,100,-1,82,-1,-1,135,86,22,41,
+  -1,-1,-1,13,120,-1,-1,172,-1,-1,-1,-1,194,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,103,83,98,27,-1,92,32,200,
+  -1,-1,211,-1,-1,-1,-1,20,-1,70,12,224,105,203,167,187,
+  54,-1,8,-1,-1,50,-1,-1,-1,-1,-1,145,-1,47,-1,-1,
+  -1,-1,78,74,36,87,-1,46,-1,165,-1,-1,142,-1,-1,126,
+  141,216,-1,144,-1,-1,3,-1,-1,77,72,147,39,-1,-1,-1,
+  170,-1,239,-1,45,-1,-1,15,48,-1,225,-1,128,133,233,140,
+  81,-1,238,59,-1,185,-1,186,-1,115,174,-1,-1,52,9,-1
+};
+
+
+// sees if it's a legitimate command and if so provides info about it, case doesn't matter
+RAMISCMD *
+ramisFindCommand(register const char *str,register unsigned int len)
+{
+  uint64_t h=ramisCmdHash(str,len);
+  uint32_t d=ramisCmdDisplacement[ramisCmdBucket(h,RAMISCMDBUCKETMASK)];
+  int      i=ramisCmdSlots[ramisCmdSlot(h,d,RAMISCMDSLOTMASK)];
+
+  if(i<0 || ramisCmdLength[i]!=len || strncasecmp(str,ramisCommands[i].command,len))
+    return(NULL);
+  return(&ramisCommands[i]);
+}
+
+int
+ramisCommandCount(void)
+{
+  return(RAMISNCOMMANDS);
+}
+
+// the command's position in the table, for keeping per command data in arrays
+int
+ramisCommandIndex(const RAMISCMD *cmd)
+{
+  return((int)(cmd-ramisCommands));
+}
+
+RAMISCMD *
+ramisCommandAt(int i)
+{
+  if(i<0 || i>=RAMISNCOMMANDS)
+    return(NULL);
+  return(&ramisCommands[i]);
+}
@@ -0,0 +1,84 @@
+//
+//  ramis_load.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Mass insertion like redis-cli --pipe. Sends the RESP encoded commands in a file, or on
+//  stdin from a generator, as fast as the connection takes them and counts the replies:
+//
+//    cc -O2 -o ramis_load ramis_load.c resp_load.c resp_client.c resp_protocol.c resp_capture.c
+//       resp_compress.c resp_reconnect.c resp_metrics.c resp_trace.c resp_reply.c resp_hotkeys.c
+//       ramis_commands.c -lm -pthread
+//    ./gen_keys | ./ramis_load [-h host] [-p port] [-n]
+//
+//  -n runs the load with CLIENT REPLY OFF, so the server sends nothing back and errors aren't
+//  counted. A generator can write its commands with respPrintf().
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_load.h"
+
+
+static void
+usage(void)
+{
+  fprintf(stderr,"usage: ramis_load [-h host] [-p port] [-n] [file]\n"
+                 "  -n    don't have the server reply, with CLIENT REPLY OFF\n"
+                 "  file  RESP encoded commands, stdin if it isn't given\n");
+  exit(EXIT_FAILURE);
+}
+
+int
+main(int argc,char *argv[])
+{
+  char         *host="localhost";
+  int           port=6379,flags=0,fd=0,c,ok;
+  RESPCLIENT   *rcp;
+  RESPLOADSTATS stats;
+  double        secs;
+
+  while((c=getopt(argc,argv,"h:p:n"))!=-1)
+  {
+    switch(c)
+    {
+      case 'h': host=optarg;              break;
+      case 'p': port=atoi(optarg);        break;
+      case 'n': flags|=RESPLOADREPLYOFF;  break;
+      default:  usage();
+    }
+  }
+  if(optind<argc-1)
+    usage();
+  if(optind==argc-1 && (fd=open(argv[optind],O_RDONLY))<0)
+  {
+    perror(argv[optind]);
+    return(EXIT_FAILURE);
+  }
+  if(!(rcp=connectRespServer(host,port)))
+  {
+    fprintf(stderr,"ramis_load: could not connect to %s:%d\n",host,port);
+    return(EXIT_FAILURE);
+  }
+
+  ok=respBulkLoadFd(rcp,fd,flags,&stats);
+  secs=stats.elapsedNs?stats.elapsedNs/1e9:1e-9;
+  printf("%llu commands, %llu replies, %llu errors, %.1fMB sent in %.3fs, %.1fMB/s, %.0f commands/s\n",
+         (unsigned long long)stats.commands,(unsigned long long)stats.replies,(unsigned long long)stats.errors,
+         stats.bytesOut/1048576.0,secs,stats.bytesOut/1048576.0/secs,stats.commands/secs);
+  if(*stats.firstError)
+    printf("first error: %s\n",stats.firstError);
+  if(!ok)
+    fprintf(stderr,"ramis_load: %s\n",rcp->rppFrom->errorMsg);
+  closeRespClient(rcp);
+  if(fd)
+    close(fd);
+  return(ok && !stats.errors?EXIT_SUCCESS:EXIT_FAILURE);
+}
@@ -0,0 +1,350 @@
+//
+//  ramis_replay.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Sends the commands in a capture made with respClientCapture() to a server and reports the
+//  throughput and latency it got:
+//
+//    cc -O2 -o ramis_replay ramis_replay.c resp_client.c resp_protocol.c resp_stream.c resp_capture.c
+//       resp_compress.c resp_reconnect.c resp_metrics.c resp_trace.c resp_reply.c resp_hotkeys.c
+//       ramis_commands.c -lm -pthread
+//    ./ramis_replay [-h host] [-p port] [-f] [-s speed] [-d depth] capture.file
+//
+//  By default each command goes out at the time it did when it was captured, -s 2 replays at
+//  twice that pace. -f sends as fast as the server answers. Either way no more than depth
+//  commands are waiting on replies at once. Latency is timed from when a command was due rather
+//  than when it could be sent, so a server that falls behind the original pace shows it.
+//
+//  The capture is loaded into memory and split into commands with parseRespRequests(). Each
+//  command must get exactly one reply, so captures of SUBSCRIBE and MONITOR don't replay.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_stream.h"
+#include "resp_capture.h"
+#include "resp_metrics.h"
+
+#ifdef MSG_NOSIGNAL
+#define REPLAYSENDFLAGS MSG_NOSIGNAL
+#else
+#define REPLAYSENDFLAGS 0
+#endif
+
+#define REPLAYDEPTH       16   // default most commands waiting on replies
+#define REPLAYSTALLSECS   30   // give up when the server says nothing for this long
+
+#define REPLAYCMD struct replayCmdStruct
+REPLAYCMD
+{
+  size_t   offset;   // in the command bytes
+  size_t   length;
+  uint64_t dueNs;    // after the first command
+};
+
+#define REPLAY struct replayStruct
+REPLAY
+{
+  byte      *bytes;       // everything the client sent, one frame after another
+  size_t     nBytes;
+  size_t     bytesSize;
+  REPLAYCMD *cmds;
+  int        nCmds;
+  uint64_t   nReplyBytes; // received in the capture, for the summary
+  uint64_t   spanNs;      // from the first command to the last
+};
+
+
+static void
+usage(void)
+{
+  fprintf(stderr,"usage: ramis_replay [-h host] [-p port] [-f] [-s speed] [-d depth] capture.file\n"
+                 "  -f        send as fast as possible instead of at the captured pace\n"
+                 "  -s speed  pace multiplier, 2 is twice as fast as captured (default 1)\n"
+                 "  -d depth  most commands waiting on replies at once (default %d)\n",REPLAYDEPTH);
+  exit(EXIT_FAILURE);
+}
+
+static void
+outOfMemory(void)
+{
+  fprintf(stderr,"ramis_replay: out of memory\n");
+  exit(EXIT_FAILURE);
+}
+
+static void *
+mustRealloc(void *p,size_t n)
+{
+  if(!(p=ramisRealloc(p,n)))
+    outOfMemory();
+  return(p);
+}
+
+// reads the command frames and splits them into commands, each due when its first byte was sent
+static void
+loadCapture(REPLAY *rp,const char *path)
+{
+  RESPCAPTURE  *rcap;
+  RESPREQUESTS *rqp;
+  char         *errorMsg;
+  size_t       *frameOff=NULL;
+  uint64_t     *frameNs=NULL;
+  int           nFrames=0,maxFrames=0,f=0,i,type;
+
+  if(!(rcap=openRespCapture(path,&errorMsg)))
+  {
+    fprintf(stderr,"ramis_replay: %s: %s\n",path,errorMsg);
+    exit(EXIT_FAILURE);
+  }
+  while((type=respCaptureNext(rcap))>0)
+  {
+    if(type==RESPCAPREPLY)
+    {
+      rp->nReplyBytes+=rcap->frameLen;
+      continue;
+    }
+    if(nFrames==maxFrames)
+    {
+      maxFrames=maxFrames?maxFrames*2:1024;
+      frameOff=mustRealloc(frameOff,maxFrames*sizeof(size_t));
+      frameNs=mustRealloc(frameNs,maxFrames*sizeof(uint64_t));
+    }
+    if(rp->nBytes+rcap->frameLen>rp->bytesSize)
+    {
+      rp->bytesSize=(rp->nBytes+rcap->frameLen)*2;
+      rp->bytes=mustRealloc(rp->bytes,rp->bytesSize);
+    }
+    frameOff[nFrames]=rp->nBytes;
+    frameNs[nFrames++]=rcap->frameNs;
+    memcpy(rp->bytes+rp->nBytes,rcap->frame,rcap->frameLen);
+    rp->nBytes+=rcap->frameLen;
+  }
+  if(type<0)
+    fprintf(stderr,"ramis_replay: %s: %s, replaying what came before it\n",path,rcap->errorMsg);
+  freeRespCapture(rcap);
+
+  if(!(rqp=newRespRequests()))
+    outOfMemory();
+  if(parseRespRequests(rqp,rp->bytes,rp->nBytes)<0)
+    fprintf(stderr,"ramis_replay: %s: %s, replaying what came before it\n",path,rqp->errorMsg);
+  else
+  if(rqp->consumed<rp->nBytes)
+    fprintf(stderr,"ramis_replay: %s: the last command is incomplete and is left out\n",path);
+
+  rp->nCmds=rqp->nRequests;
+  rp->cmds=mustRealloc(NULL,(rp->nCmds+1)*sizeof(REPLAYCMD));
+  for(i=0;i<rp->nCmds;i++)
+  {
+    RESPREQUEST *req=&rqp->requests[i];
+
+    while(f+1<nFrames && frameOff[f+1]<=req->offset)
+      f++;
+    rp->cmds[i].offset=req->offset;
+    rp->cmds[i].length=req->length;
+    rp->cmds[i].dueNs=frameNs[f]-frameNs[0];
+  }
+  if(rp->nCmds)
+    rp->spanNs=rp->cmds[rp->nCmds-1].dueNs;
+  freeRespRequests(rqp);
+  if(frameOff)
+    ramisFree(frameOff);
+  if(frameNs)
+    ramisFree(frameNs);
+}
+
+// counts the error replies in what respFeed() just parsed
+static int
+countErrors(RESPROTO *rpp)
+{
+  int i,span,nErrors=0;
+
+  for(i=0;i<rpp->nItems;i+=span)
+  {
+    nErrors+=rpp->items[i].respType==RESPISERRORMSG;
+    if(!(span=respReplySpan(rpp->items,rpp->nItems,i)))
+      break;
+  }
+  return(nErrors);
+}
+
+static void
+printMs(const char *label,uint64_t ns)
+{
+  printf(" %s %.3fms",label,ns/1e6);
+}
+
+int
+main(int argc,char *argv[])
+{
+  char       *host="localhost";
+  int         port=6379,depth=REPLAYDEPTH,fast=0,c;
+  double      speed=1.0;
+  REPLAY      replay;
+  RESPCLIENT *rcp;
+  RESPSTREAM *rsm;
+  RESPHIST   *hist;
+  uint64_t   *dueRing;     // when each command waiting on a reply was due, by command number % depth
+  uint64_t    startNs,now,due,bytesOut=0,bytesIn=0,nErrors=0;
+  size_t      sendFrom=0,sendTo=0,room;
+  int         next=0,done=0,nReplies;
+  ssize_t     n;
+  struct pollfd pfd;
+
+  while((c=getopt(argc,argv,"h:p:fs:d:"))!=-1)
+  {
+    switch(c)
+    {
+      case 'h': host=optarg;             break;
+      case 'p': port=atoi(optarg);       break;
+      case 'f': fast=1;                  break;
+      case 's': speed=atof(optarg);      break;
+      case 'd': depth=atoi(optarg);      break;
+      default:  usage();
+    }
+  }
+  if(optind!=argc-1 || depth<1 || speed<=0)
+    usage();
+
+  memset(&replay,0,sizeof(replay));
+  loadCapture(&replay,argv[optind]);
+  printf("%d commands, %.1fKB sent and %.1fKB received over %.3fs when captured\n",replay.nCmds,
+         replay.nBytes/1024.0,replay.nReplyBytes/1024.0,replay.spanNs/1e9);
+  if(!replay.nCmds)
+    return(EXIT_SUCCESS);
+
+  if(!(rcp=connectRespServer(host,port)))
+  {
+    fprintf(stderr,"ramis_replay: could not connect to %s:%d\n",host,port);
+    return(EXIT_FAILURE);
+  }
+  fcntl(rcp->socket,F_SETFL,fcntl(rcp->socket,F_GETFL)|O_NONBLOCK);
+  rsm=newRespStream();
+  hist=ramisCalloc(1,sizeof(RESPHIST));
+  dueRing=ramisMalloc(depth*sizeof(uint64_t));
+  if(!rsm || !hist || !dueRing)
+    outOfMemory();
+
+  pfd.fd=rcp->socket;
+  startNs=respTraceNow();
+  while(done<replay.nCmds)
+  {
+    int timeout=REPLAYSTALLSECS*1000,stalled=1;
+
+    // queue every command that's due and has room in the pipeline. They're contiguous in the
+    // capture so what's queued is a range of it
+    now=respTraceNow();
+    while(next<replay.nCmds && next-done<depth)
+    {
+      due=fast?now:startNs+(uint64_t)(replay.cmds[next].dueNs/speed);
+      if(due>now)
+      {
+        timeout=(int)((due-now+999999)/1000000);
+        stalled=0;
+        break;
+      }
+      if(sendFrom==sendTo)
+        sendFrom=replay.cmds[next].offset;
+      sendTo=replay.cmds[next].offset+replay.cmds[next].length;
+      dueRing[next%depth]=due;
+      next++;
+    }
+
+    pfd.events=(sendFrom<sendTo?POLLOUT:0)|(next>done?POLLIN:0);
+    pfd.revents=0;
+    if(poll(&pfd,1,timeout)<0)
+    {
+      if(errno==EINTR)
+        continue;
+      perror("ramis_replay: poll");
+      return(EXIT_FAILURE);
+    }
+    if(!pfd.revents && stalled)
+    {
+      fprintf(stderr,"ramis_replay: no reply in %ds after %d of %d commands\n",REPLAYSTALLSECS,done,replay.nCmds);
+      return(EXIT_FAILURE);
+    }
+
+    if(pfd.revents&POLLOUT)
+    {
+      n=send(rcp->socket,replay.bytes+sendFrom,sendTo-sendFrom,REPLAYSENDFLAGS);
+      if(n<0 && errno!=EAGAIN && errno!=EINTR)
+      {
+        perror("ramis_replay: send");
+        return(EXIT_FAILURE);
+      }
+      if(n>0)
+      {
+        sendFrom+=n;
+        bytesOut+=n;
+      }
+    }
+    if(pfd.revents&(POLLIN|POLLHUP|POLLERR))
+    {
+      byte *buf=respStreamReadBuf(rsm,0,&room);
+
+      if(!buf)
+      {
+        fprintf(stderr,"ramis_replay: %s\n",rsm->errorMsg);
+        return(EXIT_FAILURE);
+      }
+      n=recv(rcp->socket,buf,room,0);
+      if(n<0 && (errno==EAGAIN || errno==EINTR))
+        continue;
+      if(n<=0)
+      {
+        fprintf(stderr,"ramis_replay: %s after %d of %d commands\n",n?strerror(errno):"the server closed the connection",done,replay.nCmds);
+        return(EXIT_FAILURE);
+      }
+      bytesIn+=n;
+      if((nReplies=respFeed(rsm,buf,n))<0)
+      {
+        fprintf(stderr,"ramis_replay: %s\n",rsm->errorMsg);
+        return(EXIT_FAILURE);
+      }
+      if(nReplies>next-done)
+      {
+        fprintf(stderr,"ramis_replay: more replies than commands, the capture has pub/sub or MONITOR traffic\n");
+        return(EXIT_FAILURE);
+      }
+      now=respTraceNow();
+      nErrors+=countErrors(rsm->rpp);
+      while(nReplies--)
+      {
+        respHistRecord(hist,now>dueRing[done%depth]?now-dueRing[done%depth]:0);
+        done++;
+      }
+    }
+  }
+  now=respTraceNow();
+
+  printf("%d commands in %.3fs, %.0f ops/s, %llu error replies, %.1fKB sent and %.1fKB received\n",
+         replay.nCmds,(now-startNs)/1e9,replay.nCmds/((now-startNs)/1e9),(unsigned long long)nErrors,
+         bytesOut/1024.0,bytesIn/1024.0);
+  printf("latency");
+  printMs("mean",hist->sumNs/hist->count);
+  printMs("p50",respHistPercentile(hist,0.50));
+  printMs("p90",respHistPercentile(hist,0.90));
+  printMs("p99",respHistPercentile(hist,0.99));
+  printMs("p99.9",respHistPercentile(hist,0.999));
+  printMs("max",hist->maxNs);
+  printf("\n");
+
+  closeRespClient(rcp);
+  freeRespStream(rsm);
+  ramisFree(hist);
+  ramisFree(dueRing);
+  ramisFree(replay.bytes);
+  ramisFree(replay.cmds);
+  return(EXIT_SUCCESS);
+}
@@ -10,8 +10,16 @@
 #ifndef respClient_h
 #define respClient_h
 #include <stdarg.h>
+#include <sys/types.h>
 #include "ramis.h"
 #include "resp_protocol.h"
+#include "resp_compress.h"
+#include "resp_reconnect.h"
+#include "resp_metrics.h"
+#include "resp_trace.h"
+#include "resp_capture.h"
+#include "resp_reply.h"
+#include "resp_hotkeys.h"
 
 #define RESPCLIENTBUFSZ    8192  // Transmit and recieve buffer size
 #define RESPCLIENTTIMEOUT     3  // Number of seconds to wait for a response
@@ -28,12 +36,28 @@ RESPCLIENT
   byte       *fromBuf;           // where we put junk from the server
   byte       *fromReadp;         // where the next read from server will go
   size_t      fromBufSize;       // how big is the buffer overall now
+  byte       *fromNext;          // where replies read along with the last ones start
+  size_t      fromKept;          // and how many bytes of them there are
   byte       *toBuf;             // where we stage stuff destined for the server
   size_t      toBufSz;           // the toBuf's current size
   int         socket;            // the raw socket
   char       *hostname;          // these are kept from the initial open so we can reconnect
   int         port;
   int         waitForever;       // disables RESPCLIENTTIMEOUT for SUBSCRIBE commands
+  RESPCODEC  *codec;             // value compression and its stats, NULL when it's off
+  RESPRECONNECT *reconnect;      // background reconnection, NULL to reconnect in the caller
+  RESPMETRICS *metrics;          // counters and latencies, NULL when they're off
+  RESPTRACE  *trace;             // phase timing and the slow log, NULL when it's off
+  RESPCAPTURE *capture;          // traffic being recorded for replay, NULL when it's off
+  RESPREPLYPOOL *replyPool;      // buffers for detached replies, NULL until one is detached
+  RESPHOTKEYS *hotKeys;          // sampled key counts, NULL when it's off
+  int         trackSession;      // follow SELECT and MULTI in what's sent, set by respCoalesceClient()
+  int         db;                // the SELECTed database, when trackSession is set
+  int         inMulti;           // between MULTI and EXEC or DISCARD, when trackSession is set
+  int         ownerReconnects;   // a lost connection's socket is left for the owner to reconnect
+  byte       *pendBuf;           // appended commands waiting to go out with the next send or read
+  size_t      pendBufSz;
+  size_t      pendUsed;
 };
 
 // https://stackoverflow.com/questions/5891221/variadic-macros-with-zero-arguments explains the ## below
@@ -42,6 +66,21 @@ RESPCLIENT
 // gets a reply from the RESP server and parses it into items list within the RESPROTO struct
 RESPROTO * getRespReply(RESPCLIENT *rcp);
 
+// gets the replies to nReplies pipelined commands as one items list
+RESPROTO * getRespReplies(RESPCLIENT *rcp,int nReplies);
+
+// hands the last reply and the buffer it's in over to a RESPREPLY, free it with freeRespReply()
+RESPREPLY * respDetachReply(RESPCLIENT *rcp);
+
+// gets a reply but streams a bulk string's payload to sink() in buffer sized chunks instead of keeping it
+RESPROTO * getRespReplyToSink(RESPCLIENT *rcp,int (*sink)(void *sinkData,byte *chunk,size_t len),void *sinkData);
+
+// SETs key to len bytes of fd from off (-1 for its current position), using sendfile() where it can
+RESPROTO * respSetFromFd(RESPCLIENT *rcp,const char *key,int fd,off_t off,size_t len);
+
+// GETs key and writes its value to fd, using splice() where it can. items[0].length is its size
+RESPROTO * respGetToFd(RESPCLIENT *rcp,const char *key,int fd);
+
 // closes and reopens the connection to the server and resets the buffers
 int reconnectRespServer(RESPCLIENT *rcp);
 
@@ -54,11 +93,61 @@ RESPCLIENT * closeRespClient(RESPCLIENT *rcp);
 // a formatted way to send data to the server
 RESPROTO * sendRespCommand(RESPCLIENT *rcp,char *fmt,...);
 
+// writes n bytes of already RESP encoded commands to the server
+int transmitRespCommand(RESPCLIENT *rcp,byte *buf,size_t n);
+
+// encodes like sendRespCommand() but appends to *outBufp at offset used instead of sending
+ssize_t appendRespCommandV(RESPCLIENT *rcp,byte **outBufp,size_t *outBufszp,size_t used,char *fmt,va_list *argp);
+
+// encodes like sendRespCommand() into *outBufp at offset used without a client, for event loops.
+// Returns the number of bytes appended or -1 on error. Nothing is compressed
+ssize_t respEncodeInto(byte **outBufp,size_t *outBufszp,size_t used,char *fmt,...);
+ssize_t respEncodeIntoV(byte **outBufp,size_t *outBufszp,size_t used,char **errorMsgp,char *fmt,va_list *argp);
+
+// sends an argument vector and returns the reply, argvlen may be NULL for '\0' terminated args
+RESPROTO * sendRespCommandArgv(RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen);
+
+// queue a command without sending it. Queued commands go out in one write with the next command
+// sent or when a reply is asked for, collect their replies in order with getRespReply()
+int appendRespCommandArgv(RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen);
+int appendRespCommand(RESPCLIENT *rcp,char *fmt,...);
+
+// sends the queued commands now
+int flushRespCommands(RESPCLIENT *rcp);
+
+// sends an argument vector to the server without waiting, collect the reply with getRespReply()
+int postRespCommandArgv(RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen);
+
 // Counts the number of arguments to expect for sendRespCommand()
 // places the count in *nArgs
 // returns an array containing the type of each arg
 int * respCommandArgTypes(char *fmt,int *nArgs);
 
+// compresses %b values of at least threshold bytes and decompresses replies that were, 0 turns it off
+int respClientCompression(RESPCLIENT *rcp,size_t threshold);
+
+// replaces lost connections in a background thread, requests fail fast until it has one
+int respClientBackgroundReconnect(RESPCLIENT *rcp,int onOff);
+
+// turns counting and latency histograms on or off
+int respClientMetrics(RESPCLIENT *rcp,int onOff);
+
+// copies the client's metrics into dst (from newRespMetrics()), merge snapshots to add up clients
+int respClientMetricsSnapshot(RESPCLIENT *rcp,RESPMETRICS *dst);
+
+// times the phases of each command for hook and logs the slow ones, a NULL hook and 0 nSlowLog turn it off
+int respClientTrace(RESPCLIENT *rcp,respTraceHook hook,void *hookData,uint64_t slowNs,int nSlowLog);
+
+// records the traffic to path for ramis_replay, a NULL path stops. maxBytes of 0 is no limit
+int respClientCapture(RESPCLIENT *rcp,const char *path,uint64_t maxBytes);
+
+// keeps the k hottest keys from 1 in sampleEvery writes, writing them to dumpFh every dumpSecs
+// if it isn't NULL. A k of 0 turns it off
+int respClientHotKeys(RESPCLIENT *rcp,int k,uint32_t sampleEvery,FILE *dumpFh,int dumpSecs);
+
+// copies up to max of the hottest keys to out, hottest first, and returns how many there were
+int respClientHotKeysTop(RESPCLIENT *rcp,RESPHOTKEY *out,int max);
+
 // Sees if anything went wrong. If everything's ok returns NULL , otherwise an error message.
 char * respClienError(RESPCLIENT *rcp);
 
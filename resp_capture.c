@@ -0,0 +1,216 @@
+//
+//  resp_capture.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Frames go through stdio's buffer, so capturing costs a clock read and a memcpy per send()
+//  and recv() and a write() per RESPCAPBUFSZ bytes. Nothing is flushed until the buffer fills
+//  or the capture is freed, a process that crashes loses its last frames.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "resp_capture.h"
+
+#define CAPVARINTMAX 10 // bytes in the longest 64 bit varint
+
+
+static uint64_t
+clockNs(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock,&ts);
+  return((uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec);
+}
+
+// seven bits a byte, low bits first, the top bit set on all but the last
+static int
+putVarint(byte *p,uint64_t v)
+{
+  int n=0;
+
+  while(v>=0x80)
+  {
+    p[n++]=(byte)(v|0x80);
+    v>>=7;
+  }
+  p[n++]=(byte)v;
+  return(n);
+}
+
+// 1 if *vp was read, 0 at the end of the file and -1 if the varint is too long
+static int
+getVarint(FILE *fh,uint64_t *vp)
+{
+  uint64_t v=0;
+  int      shift,c;
+
+  for(shift=0;shift<7*CAPVARINTMAX;shift+=7)
+  {
+    if((c=getc(fh))==EOF)
+      return(0);
+    v|=(uint64_t)(c&0x7f)<<shift;
+    if(!(c&0x80))
+    {
+      *vp=v;
+      return(1);
+    }
+  }
+  return(-1);
+}
+
+RESPCAPTURE *
+freeRespCapture(RESPCAPTURE *rcap)
+{
+  if(rcap)
+  {
+    if(rcap->fh)
+      fclose(rcap->fh);
+    if(rcap->frame)
+      ramisFree(rcap->frame);
+    ramisFree(rcap);
+  }
+  return(NULL);
+}
+
+RESPCAPTURE *
+newRespCapture(const char *path,uint64_t maxBytes)
+{
+  RESPCAPTURE *rcap=ramisCalloc(1,sizeof(RESPCAPTURE));
+  byte  header[RESPCAPMAGICLEN+1+CAPVARINTMAX];
+  size_t n;
+
+  if(!rcap)
+    return(NULL);
+  if(!(rcap->fh=fopen(path,"wb")))
+    return(freeRespCapture(rcap));
+  setvbuf(rcap->fh,NULL,_IOFBF,RESPCAPBUFSZ);
+  rcap->maxBytes=maxBytes;
+  rcap->wallStartNs=clockNs(CLOCK_REALTIME);
+  rcap->lastNs=clockNs(CLOCK_MONOTONIC);
+
+  memcpy(header,RESPCAPMAGIC,RESPCAPMAGICLEN);
+  header[RESPCAPMAGICLEN]=RESPCAPVERSION;
+  n=RESPCAPMAGICLEN+1+putVarint(header+RESPCAPMAGICLEN+1,rcap->wallStartNs);
+  if(fwrite(header,1,n,rcap->fh)!=n)
+    return(freeRespCapture(rcap));
+  return(rcap);
+}
+
+void
+respCaptureFrame(RESPCAPTURE *rcap,int type,const byte *buf,size_t n)
+{
+  byte     header[1+2*CAPVARINTMAX];
+  uint64_t now;
+  size_t   len;
+
+  if(rcap->failed || rcap->truncated || !n)
+    return;
+  if(rcap->maxBytes && rcap->nBytes+n>rcap->maxBytes)
+  {
+    rcap->truncated=1;
+    fflush(rcap->fh);
+    return;
+  }
+  now=clockNs(CLOCK_MONOTONIC);
+  header[0]=(byte)type;
+  len=1+putVarint(header+1,now-rcap->lastNs);
+  len+=putVarint(header+len,n);
+  if(fwrite(header,1,len,rcap->fh)!=len || fwrite(buf,1,n,rcap->fh)!=n)
+  {
+    rcap->failed=1;
+    rcap->errorMsg=strerror(errno);
+    return;
+  }
+  rcap->lastNs=now;
+  rcap->nFrames++;
+  rcap->nBytes+=n;
+}
+
+
+/* ********************************* reading ******************************** */
+
+RESPCAPTURE *
+openRespCapture(const char *path,char **errorMsgp)
+{
+  RESPCAPTURE *rcap=ramisCalloc(1,sizeof(RESPCAPTURE));
+  byte header[RESPCAPMAGICLEN+1];
+
+  *errorMsgp="Memory allocation error in openRespCapture()";
+  if(!rcap)
+    return(NULL);
+  if(!(rcap->fh=fopen(path,"rb")))
+  {
+    *errorMsgp=strerror(errno);
+    return(freeRespCapture(rcap));
+  }
+  setvbuf(rcap->fh,NULL,_IOFBF,RESPCAPBUFSZ);
+  if(fread(header,1,sizeof(header),rcap->fh)!=sizeof(header) || memcmp(header,RESPCAPMAGIC,RESPCAPMAGICLEN)
+     || getVarint(rcap->fh,&rcap->wallStartNs)!=1)
+  {
+    *errorMsgp="Not a capture file";
+    return(freeRespCapture(rcap));
+  }
+  if(header[RESPCAPMAGICLEN]!=RESPCAPVERSION)
+  {
+    *errorMsgp="The capture file is from another version";
+    return(freeRespCapture(rcap));
+  }
+  *errorMsgp=NULL;
+  return(rcap);
+}
+
+int
+respCaptureNext(RESPCAPTURE *rcap)
+{
+  uint64_t delta,len;
+  int      type,ret;
+
+  rcap->errorMsg=NULL;
+  if((type=getc(rcap->fh))==EOF)
+    return(0);
+  if(type!=RESPCAPCOMMAND && type!=RESPCAPREPLY)
+  {
+    rcap->errorMsg="Unknown frame type in the capture file";
+    return(-1);
+  }
+  if((ret=getVarint(rcap->fh,&delta))!=1 || (ret=getVarint(rcap->fh,&len))!=1)
+  {
+    if(ret<0)
+      rcap->errorMsg="Bad frame header in the capture file";
+    return(ret);
+  }
+  if(len>RESPCAPMAXFRAME)
+  {
+    rcap->errorMsg="Impossible frame length in the capture file";
+    return(-1);
+  }
+  if(len>rcap->frameSize)
+  {
+    byte *newBuf=ramisRealloc(rcap->frame,len);
+
+    if(!newBuf)
+    {
+      rcap->errorMsg="Memory allocation error in respCaptureNext()";
+      return(-1);
+    }
+    rcap->frame=newBuf;
+    rcap->frameSize=len;
+  }
+  if(fread(rcap->frame,1,len,rcap->fh)!=len)
+    return(0);
+  rcap->lastNs+=delta;
+  rcap->frameNs=rcap->lastNs;
+  rcap->frameType=type;
+  rcap->frameLen=len;
+  rcap->nFrames++;
+  rcap->nBytes+=len;
+  return(type);
+}
@@ -0,0 +1,67 @@
+//
+//  resp_capture.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Records the bytes a client sends and receives, with when, to a file that ramis_replay can
+//  send to a server again. The file is the magic, a version byte and the wall clock start
+//  time, then frames of a type byte, the nanoseconds since the frame before and the length,
+//  both as varints, followed by the bytes. Frames are whatever one send() or recv() moved, so
+//  commands and replies are split or joined as they were on the wire.
+//
+
+#ifndef resp_capture_h
+#define resp_capture_h
+#include <stdio.h>
+#include <stdint.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+
+#define RESPCAPMAGIC     "RAMISCAP"
+#define RESPCAPMAGICLEN  8
+#define RESPCAPVERSION   1
+#define RESPCAPCOMMAND   1      // bytes sent to the server
+#define RESPCAPREPLY     2      // bytes received from it
+#define RESPCAPBUFSZ     65536  // stdio buffer for the file
+#define RESPCAPMAXFRAME  (1024LL*1024*1024) // anything longer in a file is taken as damage
+
+#define RESPCAPTURE struct respCaptureStruct
+RESPCAPTURE
+{
+  FILE     *fh;
+  uint64_t  wallStartNs;   // CLOCK_REALTIME when the capture started
+  uint64_t  lastNs;        // CLOCK_MONOTONIC of the last frame written, or the read frame's offset
+  uint64_t  nFrames;
+  uint64_t  nBytes;        // payload bytes written or read
+  uint64_t  maxBytes;      // writing stops after this many payload bytes, 0 for no limit
+  int       truncated;     // maxBytes was reached
+  int       failed;        // a write failed, nothing more is written
+  char     *errorMsg;      // NULL if all's ok
+
+  // the frame respCaptureNext() read
+  int       frameType;
+  uint64_t  frameNs;       // since the capture started
+  byte     *frame;
+  size_t    frameLen;
+  size_t    frameSize;
+};
+
+// creates or truncates path and writes the header. NULL if it can't
+RESPCAPTURE * newRespCapture(const char *path,uint64_t maxBytes);
+
+// flushes and closes a capture being written or read
+RESPCAPTURE * freeRespCapture(RESPCAPTURE *rcap);
+
+// adds n bytes of type RESPCAPCOMMAND or RESPCAPREPLY. Failures are kept in rcap->failed
+// rather than returned, a client goes on without its capture
+void respCaptureFrame(RESPCAPTURE *rcap,int type,const byte *buf,size_t n);
+
+// opens a capture to read. NULL if it can't be read or isn't one, with *errorMsgp set
+RESPCAPTURE * openRespCapture(const char *path,char **errorMsgp);
+
+// reads the next frame into rcap->frame. Returns its type, 0 at the end of the file or -1 with
+// rcap->errorMsg set if the file is damaged. A frame cut short by a crash counts as the end
+int respCaptureNext(RESPCAPTURE *rcap);
+
+#endif /* resp_capture_h */
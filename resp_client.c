@@ -6,6 +6,9 @@
 //  Copyright © 2020 P. B. Richards. All rights reserved.
 //
 
+#ifdef __linux__
+#define _GNU_SOURCE // splice() and F_SETPIPE_SZ
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
@@ -19,12 +22,29 @@
 #include <math.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 #ifdef RP_USING_DUKTAPE
 #include "duktape.h"
 #endif
 #include "ramis.h"
 #include "resp_protocol.h"
 #include "respClient.h"
+#include "resp_compress.h"
+#include "resp_trace.h"
+#include "resp_capture.h"
+#include "resp_hotkeys.h"
+
+#ifdef MSG_NOSIGNAL // a server that goes away shouldn't SIGPIPE us
+#define RESPSENDFLAGS MSG_NOSIGNAL
+#else
+#define RESPSENDFLAGS 0
+#endif
+
+#define RESPSENDFILEMAX   0x7ffff000 // the most Linux moves in one sendfile()
+#define RESPSPLICEPIPESZ  (1<<20)    // asked for, the pipe may be left at 64K
 
 
 
@@ -45,6 +65,17 @@ closeRespClient(RESPCLIENT *rcp)
       if(rcp->toBuf)
          ramisFree(rcp->toBuf);
 
+      if(rcp->pendBuf)
+         ramisFree(rcp->pendBuf);
+
+      freeRespCodec(rcp->codec);
+      freeRespReconnect(rcp->reconnect); // closes a replacement that was never picked up
+      freeRespMetrics(rcp->metrics);
+      freeRespTrace(rcp->trace);
+      freeRespCapture(rcp->capture);
+      respReplyPoolRelease(rcp->replyPool); // detached replies still out keep it
+      freeRespHotKeys(rcp->hotKeys);
+
       ramisFree(rcp);
   }
  return(NULL);
@@ -122,6 +153,8 @@ reconnectRespServer(RESPCLIENT *rcp)
   if(rcp->socket>-1)
     close(rcp->socket);
   rcp->fromReadp=rcp->fromBuf;
+  rcp->fromKept=0;
+  rcp->db=rcp->inMulti=0; // a new connection is a new session
   return(openRespClientSocket(rcp));
 }
 
@@ -146,6 +179,57 @@ connectRespServer(char *hostname,int port)
 
 
 
+// gives up on the connection. With background reconnection the socket is closed and a
+// replacement is made by the reconnect thread, with ownerReconnects it's left for the
+// owner to call reconnectRespServer(), otherwise it's reopened right here
+static void
+connectionLost(RESPCLIENT *rcp)
+{
+  if(rcp->metrics)
+  {
+    rcp->metrics->reconnects++;
+    rcp->metrics->pendingCommand=-1; // its reply isn't coming
+  }
+  if(rcp->ownerReconnects) // another thread may be shutting the socket down, the owner replaces it
+  {
+    rcp->fromReadp=rcp->fromBuf;
+    rcp->fromKept=0;
+    rcp->db=rcp->inMulti=0;
+    return;
+  }
+  if(!rcp->reconnect)
+  {
+    reconnectRespServer(rcp);
+    return;
+  }
+  if(rcp->socket>-1)
+    close(rcp->socket);
+  rcp->socket=-1;
+  rcp->fromReadp=rcp->fromBuf;
+  rcp->fromKept=0;
+  rcp->db=rcp->inMulti=0;
+  respReconnectLost(rcp->reconnect);
+}
+
+// makes sure there's a socket to send on, picking up one made in the background if need be
+static int
+connectionReady(RESPCLIENT *rcp)
+{
+  int fd;
+
+  if(rcp->socket>-1)
+    return(RAMISOK);
+  if(rcp->reconnect && (fd=respReconnectTake(rcp->reconnect))>-1)
+  {
+    rcp->socket=fd;
+    rcp->fromReadp=rcp->fromBuf;
+    rcp->fromKept=0;
+    return(RAMISOK);
+  }
+  rcp->rppFrom->errorMsg="Not connected to the server, reconnecting";
+  return(RAMISFAIL);
+}
+
 //  Polls the socket waiting for data if Timout
 //  https://man.openbsd.org/poll.2
 static int
@@ -157,24 +241,23 @@ waitForRespData(RESPCLIENT *rcp)
   pfd.fd=rcp->socket;
   pfd.events=POLLIN|POLLHUP;
   ret=poll(&pfd,1,1000*RESPCLIENTTIMEOUT);
+  if(rcp->metrics)
+  {
+    rcp->metrics->pollCalls++;
+    rcp->metrics->timeouts+=!ret;
+  }
   
   if(ret==-1)
   {
     rcp->rppFrom->errorMsg="poll() Error on read from server";
-    if(rcp->socket>-1)
-      close(rcp->socket);
-
-    openRespClientSocket(rcp); // attempt reconnect
+    connectionLost(rcp); // attempt reconnect
     return(0);
   }
   else
   if(!ret)
   {// In this case we probably did something stupid and need to reopen it to prevent corruption
     rcp->rppFrom->errorMsg="Timeout reading from server";
-    if(rcp->socket)
-       close(rcp->socket);
-
-    openRespClientSocket(rcp); // attempt reconnect
+    connectionLost(rcp); // attempt reconnect
     return(0);
   }
   return(1);
@@ -190,72 +273,372 @@ isThereMoreComing(RESPCLIENT *rcp)
   pfd.fd=rcp->socket;
   pfd.events=POLLIN|POLLHUP;
   ret=poll(&pfd,1,0);
+  if(rcp->metrics)
+    rcp->metrics->pollCalls++;
   if(ret==1)
       return(ret);
   return(0);
 }
 
 
-RESPROTO *
-getRespReply(RESPCLIENT *rcp)
+// reads whatever the server has sent into rcp->fromBuf after the first totalRead bytes,
+// growing the buffer when it gets filled. returns the new total or -1 on error
+static ssize_t
+readRespData(RESPCLIENT *rcp,ssize_t totalRead)
 {
   ssize_t nread;
-  int    parseRet;
-  int    newBuffer=1;
-  ssize_t totalRead=0;
-  size_t bufAvailable=rcp->fromBufSize;
-
+  size_t  bufAvailable;
+  
+  if(rcp->socket<0) // whatever we were waiting for went with the connection
+  {
+    rcp->rppFrom->errorMsg="Connection to the server was lost";
+    return(-1);
+  }
   
-  rcp->fromReadp=rcp->fromBuf; // re-init read pointer
+  //if waitForever is set we'll just block on the read instead of polling with a timeout
+  if(!rcp->waitForever)
+  if(!waitForRespData(rcp))
+       return(-1);
   
   do
   {
-       parseRet=RESP_PARSE_INCOMPLETE;
-       //if waitForever is set we'll just block on the read instead of polling with a timeout
-       if(!rcp->waitForever)
-       if(!waitForRespData(rcp))
-            return(NULL);
+    bufAvailable=rcp->fromBufSize-totalRead;
+    nread=recv(rcp->socket,rcp->fromReadp,bufAvailable,0);
+    if(rcp->metrics)
+    {
+      rcp->metrics->recvCalls++;
+      rcp->metrics->bytesIn+=nread>0?nread:0;
+    }
+    if(nread<=0)     // server closed or error
+    {
+       rcp->rppFrom->errorMsg=nread?strerror( errno ):"Server closed the connection";
+       connectionLost(rcp);   // try reconnecting
+       return(-1);
+    }
+    if(rcp->capture)
+      respCaptureFrame(rcp->capture,RESPCAPREPLY,rcp->fromReadp,nread);
     
-       do
+    totalRead+=nread;
+    
+    if(nread==(ssize_t)bufAvailable) // we need a bigger buffer because it got filled
+    {
+       byte *newBuf=respBufRealloc(rcp->rppFrom,rcp->fromBuf,rcp->fromBufSize+RESPCLIENTBUFSZ);
+       if(!newBuf)
        {
-         nread=recv(rcp->socket,rcp->fromReadp,bufAvailable,0);
-         if(nread<=0)     // server closed or error
-         {
-            rcp->rppFrom->errorMsg=strerror( errno );
-            reconnectRespServer(rcp);   // try reconnecting
-            return(NULL);
-         }
-         
-         totalRead+=nread;
-         
-         if(nread==(ssize_t)bufAvailable) // we need a bigger buffer because it got filled
-         {
-            rcp->fromBuf=respBufRealloc(rcp->rppFrom,rcp->fromBuf,rcp->fromBufSize+RESPCLIENTBUFSZ);
-            if(!rcp->fromBuf)
-            {
-               rcp->rppFrom->errorMsg="Could not expand recieve buffer in getRespReply()";
-               return(NULL);
-            }
-            rcp->fromReadp=rcp->fromBuf+totalRead;
-            rcp->fromBufSize=rcp->fromBufSize+RESPCLIENTBUFSZ;
-            bufAvailable=rcp->fromBufSize-totalRead;
-         }
-         else rcp->fromReadp=rcp->fromBuf+totalRead;
-         
-       } while(isThereMoreComing(rcp));
-     
-       
-       parseRet=parseResProto(rcp->rppFrom,rcp->fromBuf,totalRead,newBuffer);
-     
-       if(parseRet==RESP_PARSE_ERROR)
-         return(NULL);
+          rcp->rppFrom->errorMsg="Could not expand recieve buffer in getRespReply()";
+          return(-1);
+       }
+       rcp->fromBuf=newBuf;
+       rcp->fromBufSize=rcp->fromBufSize+RESPCLIENTBUFSZ;
+    }
+    rcp->fromReadp=rcp->fromBuf+totalRead;
+    
+  } while(isThereMoreComing(rcp));
+  
+  return(totalRead);
+}
+
+
+// stops the latency clock and counts the replies and how many of them were errors
+static void
+metricsReplyDone(RESPCLIENT *rcp,int nReplies)
+{
+  RESPROTO *rpp=rcp->rppFrom;
+  int i,span;
+
+  respMetricsReplyDone(rcp->metrics);
+  rcp->metrics->replies+=nReplies;
+  for(i=0;i<rpp->nItems;i+=span)
+  {
+    rcp->metrics->errorReplies+=rpp->items[i].respType==RESPISERRORMSG;
+    if(!(span=respReplySpan(rpp->items,rpp->nItems,i)))
+      break;
+  }
+}
+
+
+// parses the totalRead bytes already in rcp->fromBuf reading more until there are at least
+// nReplies complete replies
+static RESPROTO *
+readAndParseReply(RESPCLIENT *rcp,ssize_t totalRead,int nReplies)
+{
+  int    parseRet=RESP_PARSE_INCOMPLETE;
+  int    newBuffer=1;
+  uint64_t t0=0;
+  
+  rcp->rppFrom->maxReplies=nReplies;
+  if(totalRead)
+  {
+    if(rcp->trace)
+      t0=respTraceNow();
+    parseRet=parseResProto(rcp->rppFrom,rcp->fromBuf,totalRead,newBuffer);
+    newBuffer=0;
+    if(rcp->trace)
+      respTracePhase(rcp->trace,RESPTRACEPARSE,t0);
+  }
+  
+  while(parseRet==RESP_PARSE_INCOMPLETE || (parseRet!=RESP_PARSE_ERROR && rcp->rppFrom->nReplies<nReplies))
+  {
+     if(rcp->trace)
+       t0=respTraceNow();
+     totalRead=readRespData(rcp,totalRead);
+     if(totalRead<0)
+        return(NULL);
+     if(rcp->trace)
+       t0=respTracePhase(rcp->trace,RESPTRACEWAIT,t0);
      
-       newBuffer=0;
-       
-  } while(parseRet==RESP_PARSE_INCOMPLETE);
+     parseRet=parseResProto(rcp->rppFrom,rcp->fromBuf,totalRead,newBuffer);
+     newBuffer=0;
+     if(rcp->trace)
+       respTracePhase(rcp->trace,RESPTRACEPARSE,t0);
+  }
+  
+  if(parseRet==RESP_PARSE_ERROR)
+    return(NULL);
+  rcp->fromNext=rcp->rppFrom->replyEnd; // the start of replies to commands pipelined after these
+  rcp->fromKept=rcp->fromBuf+totalRead-rcp->fromNext;
+  if(rcp->codec)
+  {
+    if(rcp->trace)
+      t0=respTraceNow();
+    if(!respCodecUnpackReply(rcp->codec,rcp->rppFrom))
+      return(NULL);
+    if(rcp->trace)
+      respTracePhase(rcp->trace,RESPTRACEPARSE,t0);
+  }
+  if(rcp->metrics)
+    metricsReplyDone(rcp,rcp->rppFrom->nReplies);
   return(rcp->rppFrom);
 }
 
+static RESPROTO *
+parseRespReply(RESPCLIENT *rcp,ssize_t totalRead,int nReplies)
+{
+  RESPROTO *rpp=readAndParseReply(rcp,totalRead,nReplies);
+  
+  if(rcp->trace)
+    respTraceDone(rcp->trace,!rpp);
+  return(rpp);
+}
+
+
+// moves what came in after the last replies to the front of fromBuf, where the next reply starts
+// Returns how many bytes that is
+static size_t
+takeKeptData(RESPCLIENT *rcp)
+{
+  size_t kept=rcp->fromKept;
+
+  if(kept)
+    memmove(rcp->fromBuf,rcp->fromNext,kept);
+  rcp->fromKept=0;
+  rcp->fromReadp=rcp->fromBuf+kept;
+  return(kept);
+}
+
+
+RESPROTO *
+getRespReply(RESPCLIENT *rcp)
+{
+  if(rcp->pendUsed && !flushRespCommands(rcp))
+    return(NULL);
+  return(parseRespReply(rcp,takeKeptData(rcp),1));
+}
+
+
+// gets the replies to nReplies pipelined commands as one list of items
+// use respReplySpan() to step from one reply to the next
+RESPROTO *
+getRespReplies(RESPCLIENT *rcp,int nReplies)
+{
+  if(rcp->pendUsed && !flushRespCommands(rcp))
+    return(NULL);
+  return(parseRespReply(rcp,takeKeptData(rcp),nReplies));
+}
+
+
+// waits for and reads at most len bytes into buf without growing anything
+// returns the number of bytes read or -1 on error
+static ssize_t
+recvRespData(RESPCLIENT *rcp,byte *buf,size_t len)
+{
+  ssize_t nread;
+  uint64_t t0=0;
+  
+  if(rcp->socket<0)
+  {
+    rcp->rppFrom->errorMsg="Connection to the server was lost";
+    return(-1);
+  }
+  
+  if(rcp->trace)
+    t0=respTraceNow();
+  if(!rcp->waitForever)
+  if(!waitForRespData(rcp))
+       return(-1);
+  
+  nread=recv(rcp->socket,buf,len,0);
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACEWAIT,t0);
+  if(rcp->metrics)
+  {
+    rcp->metrics->recvCalls++;
+    rcp->metrics->bytesIn+=nread>0?nread:0;
+  }
+  if(nread<=0)
+  {
+    rcp->rppFrom->errorMsg=nread?strerror( errno ):"Server closed the connection";
+    connectionLost(rcp);
+    return(-1);
+  }
+  if(rcp->capture)
+    respCaptureFrame(rcp->capture,RESPCAPREPLY,buf,nread);
+  return(nread);
+}
+
+
+// reads a reply's first line. If it's a bulk string the payload length is returned and *chunkp
+// and *chunkLenp are set to what was read of it and its trailer, otherwise the reply is parsed into
+// *rppp (NULL on error) and -1 returned. Replies that came in after the bulk string are kept
+static int64_t
+readBulkHeader(RESPCLIENT *rcp,byte **chunkp,size_t *chunkLenp,RESPROTO **rppp)
+{
+  ssize_t  totalRead=takeKeptData(rcp); // replies that arrived with earlier ones come first
+  ssize_t  nread;
+  byte    *eol=NULL;
+  int64_t  payloadLen;
+  size_t   replyLen;
+  
+  rcp->rppFrom->errorMsg=NULL;
+  *rppp=NULL;
+  
+  for(;;) // get the first line
+  {
+    if(totalRead && *rcp->fromBuf!='$') // only bulk strings stream
+    {
+      *rppp=readAndParseReply(rcp,totalRead,1);
+      return(-1);
+    }
+    if(totalRead && (eol=memchr(rcp->fromBuf,'\n',totalRead)))
+      break;
+    if(totalRead==(ssize_t)rcp->fromBufSize)
+    {
+      rcp->rppFrom->errorMsg="RESP reply header too long";
+      return(-1);
+    }
+    nread=recvRespData(rcp,rcp->fromBuf+totalRead,rcp->fromBufSize-totalRead);
+    if(nread<0)
+      return(-1);
+    totalRead+=nread;
+    rcp->fromReadp=rcp->fromBuf+totalRead;
+  }
+  
+  payloadLen=strtoll((char *)rcp->fromBuf+1,NULL,10);
+  if(payloadLen<0) // a NULL
+  {
+    *rppp=readAndParseReply(rcp,totalRead,1);
+    return(-1);
+  }
+  *chunkp=eol+1;
+  *chunkLenp=totalRead-(*chunkp-rcp->fromBuf);
+  replyLen=(size_t)payloadLen+2;
+  if(*chunkLenp>replyLen) // all of it is here and more, nothing more is read into fromBuf
+  {
+    rcp->fromNext=*chunkp+replyLen;
+    rcp->fromKept=*chunkLenp-replyLen;
+    *chunkLenp=replyLen;
+  }
+  return(payloadLen);
+}
+
+// makes the reply a bulk string of length bytes that were sent somewhere else
+static RESPROTO *
+streamedReply(RESPCLIENT *rcp,size_t length)
+{
+  RESPROTO *rpp=rcp->rppFrom;
+  
+  resetResProto(rpp);
+  rpp->items[0].respType=RESPISBULKSTR;
+  rpp->items[0].length=length;
+  rpp->items[0].loc=NULL;
+  rpp->nItems=1;
+  if(rcp->metrics)
+    metricsReplyDone(rcp,1);
+  return(rpp);
+}
+
+/*
+ * Gets a reply from the server, but if it's a bulk string its payload is handed to sink() in
+ * chunks no bigger than the receive buffer instead of being accumulated. Memory use is constant
+ * no matter how big the value is. Any other kind of reply (errors, NULL, arrays...) is parsed
+ * normally. On success items[0] of the returned RESPROTO describes the bulk string, its length
+ * is the number of bytes streamed and its loc is NULL.
+ * sink() should return RAMISOK to continue. If it returns RAMISFAIL the rest of the payload is
+ * read and discarded to keep in sync with the server and NULL is returned.
+ * Commands may be pipelined before and after it. Replies to the ones before are read first, as
+ * always, and what was read past them is streamed from. Replies to the ones after that arrive with
+ * the payload are kept for the next getRespReply().
+*/
+static RESPROTO *
+streamRespReply(RESPCLIENT *rcp,int (*sink)(void *sinkData,byte *chunk,size_t len),void *sinkData)
+{
+  RESPROTO *rpp;
+  ssize_t  nread;
+  byte    *chunk;
+  size_t   chunkLen;
+  size_t   remaining;   // payload bytes still to come
+  size_t   trailer=2;   // the \r\n after the payload
+  int64_t  payloadLen;
+  int      sinkOk=1;
+  
+  if((payloadLen=readBulkHeader(rcp,&chunk,&chunkLen,&rpp))<0)
+    return(rpp);
+  remaining=(size_t)payloadLen;
+  
+  for(;;)
+  {
+    size_t payloadPart=chunkLen<remaining?chunkLen:remaining;
+    
+    if(payloadPart && sinkOk)
+      sinkOk=sink(sinkData,chunk,payloadPart);
+    remaining-=payloadPart;
+    chunkLen-=payloadPart;
+    trailer-=chunkLen<trailer?chunkLen:trailer;
+    
+    if(!remaining && !trailer)
+      break;
+    
+    // never read past the end of this reply
+    chunk=rcp->fromBuf;
+    chunkLen=remaining+trailer<rcp->fromBufSize?remaining+trailer:rcp->fromBufSize;
+    nread=recvRespData(rcp,chunk,chunkLen);
+    if(nread<0)
+      return(NULL);
+    chunkLen=nread;
+  }
+  
+  if(!sinkOk)
+  {
+    resetResProto(rcp->rppFrom);
+    rcp->rppFrom->errorMsg="Sink refused data in getRespReplyToSink()";
+    return(NULL);
+  }
+  return(streamedReply(rcp,(size_t)payloadLen));
+}
+
+RESPROTO *
+getRespReplyToSink(RESPCLIENT *rcp,int (*sink)(void *sinkData,byte *chunk,size_t len),void *sinkData)
+{
+  RESPROTO *rpp;
+  
+  if(rcp->pendUsed && !flushRespCommands(rcp))
+    return(NULL);
+  rpp=streamRespReply(rcp,sink,sinkData);
+  
+  if(rcp->trace)
+    respTraceDone(rcp->trace,!rpp);
+  return(rpp);
+}
 
 
 // how many individual items are in the format string
@@ -293,6 +676,17 @@ llu,
 pct
 };
 
+// where the printf style encoder puts its output, for a client or any buffer
+#define RESPENCODER struct respEncoderStruct
+RESPENCODER
+{
+  RESPCODEC *codec;      // compresses %b values, NULL for none
+  byte     **bufp;       // grown as needed
+  size_t    *bufSzp;
+  size_t     used;       // the command goes after this many bytes
+  char     **errorMsgp;
+};
+
 // we're using this struct for consistency between the functions that deal with % codes
 #define PCTCODEINFO struct PercentCodeInfoStruct
 PCTCODEINFO
@@ -334,11 +728,12 @@ lookupPctCode(char *s)
 
 // Calculates the amount of buffer needed for sendRespCommand and ensures that allocation exists.
 // returns an array of argument payload lengths or NULL on error
-size_t *
-sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
+static size_t *
+respBufNeededFor(RESPENCODER *enc,char *fmt,va_list *argp)
 {
    va_list arg;
    char *p,*q,t;
+   char *token;
    char numberBuf[80];
    PCTCODEINFO *pctCode;
    size_t bufNeeded=0;
@@ -352,7 +747,7 @@ sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
    argSizes=ramisCalloc(argCount,sizeof(size_t));
    if(!fmtCopy || !argCount)
    {
-      rcp->rppFrom->errorMsg="Memory allocation error in sendRespCommand";
+      *enc->errorMsgp="Memory allocation error in sendRespCommand";
       if(fmtCopy)
          ramisFree(fmtCopy);
       if(argSizes)
@@ -361,6 +756,8 @@ sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
    }
    
   argCount=0; // the code below uses this as an index into argSizes
+  if(enc->codec)
+    respCodecResetPack(enc->codec);
   
   va_copy(arg,*argp);
   RP_VA_ARG
@@ -379,6 +776,7 @@ sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
      
     t=*q;  // save whatever's pointed to by q
     *q='\0';
+    token=p;
     
     thisArgLength=0;
     while(*p)
@@ -403,9 +801,21 @@ sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
             } break;
             case   b:
             {
-              char * thisArg=(char *)VA_ARG(arg,byte *);
-              thisArg=NULL; // this is just to shut up a warning for unused variable
+              byte * thisArg=VA_ARG(arg,byte *);
               size_t thisLen=len=VA_ARG(arg,size_t);
+              // only a %b that is the whole argument is compressed, there's no telling where affixes end
+              if(enc->codec && !strcmp(token,"%b"))
+              {
+                if(!respCodecPack(enc->codec,thisArg,thisLen,&thisLen))
+                {
+                  *enc->errorMsgp="Memory allocation error compressing a %b value";
+                  VA_END(arg);
+                  ramisFree(argSizes);
+                  ramisFree(fmtCopy);
+                  return(NULL);
+                }
+                len=thisLen;
+              }
               bufNeeded+=thisLen;
               thisArgLength+=len;
               p+=pctCode->length;
@@ -478,8 +888,11 @@ sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
             default:
             {
               unknownCode:
-              rcp->rppFrom->errorMsg="Invalid % code in sendRespCommand()";
-              return(0);
+              *enc->errorMsgp="Invalid % code in sendRespCommand()";
+              VA_END(arg);
+              ramisFree(argSizes);
+              ramisFree(fmtCopy);
+              return(NULL);
             }
         }
       }
@@ -498,34 +911,165 @@ sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
   
  VA_END(arg);
   
- if(rcp->toBufSz<bufNeeded)
+ if(*enc->bufSzp<enc->used+bufNeeded)
  { // allocate bigger than needed by RESPCLIENTBUFSZ for future commands that are approx this size
-   rcp->toBuf=ramisRealloc(rcp->toBuf,bufNeeded+RESPCLIENTBUFSZ);
-   if(!rcp->toBuf)
+   byte *newBuf=ramisRealloc(*enc->bufp,enc->used+bufNeeded+RESPCLIENTBUFSZ);
+   if(!newBuf)
    {
-     rcp->rppFrom->errorMsg="Memory allocation error in sendRespCommand";
+     *enc->errorMsgp="Memory allocation error in sendRespCommand";
      ramisFree(argSizes);
      ramisFree(fmtCopy);
      return(NULL);
    }
-   rcp->toBufSz=bufNeeded+RESPCLIENTBUFSZ;
+   *enc->bufp=newBuf;
+   *enc->bufSzp=enc->used+bufNeeded+RESPCLIENTBUFSZ;
  }
  
  ramisFree(fmtCopy);
  return(argSizes);
 }
 
+size_t *
+sendRespBufNeeded(RESPCLIENT *rcp,char *fmt,va_list *argp)
+{
+  RESPENCODER enc={rcp->codec,&rcp->toBuf,&rcp->toBufSz,0,&rcp->rppFrom->errorMsg};
+
+  return(respBufNeededFor(&enc,fmt,argp));
+}
+
+// sends all n bytes, giving up on the connection if it can't
+static int
+sendRespData(RESPCLIENT *rcp,const byte *buf,size_t n)
+{
+  ssize_t nSent;
+
+  do
+  {
+    nSent=send(rcp->socket,buf,n,RESPSENDFLAGS);
+    if(rcp->metrics)
+    {
+      rcp->metrics->sendCalls++;
+      rcp->metrics->bytesOut+=nSent>0?nSent:0;
+    }
+    if(nSent<=0)
+    {
+      rcp->rppFrom->errorMsg="Send to server socket failed";
+      connectionLost(rcp);
+      return(RAMISFAIL);
+    }
+    if(rcp->capture)
+      respCaptureFrame(rcp->capture,RESPCAPCOMMAND,buf,nSent);
+    buf+=nSent;
+    n-=nSent;
+  } while(n);
+  return(RAMISOK);
+}
+
+// adds already encoded commands to the ones waiting to be sent
 static int
+appendPending(RESPCLIENT *rcp,const byte *buf,size_t n)
+{
+  if(rcp->pendUsed+n>rcp->pendBufSz)
+  {
+    size_t newSize=rcp->pendUsed+n+RESPCLIENTBUFSZ;
+    byte  *newBuf=ramisRealloc(rcp->pendBuf,newSize);
+
+    if(!newBuf)
+    {
+      rcp->rppFrom->errorMsg="Memory allocation error queuing a command";
+      return(RAMISFAIL);
+    }
+    rcp->pendBuf=newBuf;
+    rcp->pendBufSz=newSize;
+  }
+  memcpy(rcp->pendBuf+rcp->pendUsed,buf,n);
+  rcp->pendUsed+=n;
+  return(RAMISOK);
+}
+
+// the next "$L\r\n...\r\n" at *pp, NULL if the write ends before it does
+static const byte *
+nextArg(const byte **pp,const byte *end,size_t *lenp)
+{
+  const byte *p=*pp;
+  size_t len=0;
+
+  if(p>=end || *p!='$')
+    return(NULL);
+  for(++p;p<end && isdigit(*p);p++)
+    len=len*10+(*p-'0');
+  p+=2;
+  if(p+len>end)
+    return(NULL);
+  *pp=p+len+2;
+  *lenp=len;
+  return(p);
+}
+
+// keeps db and inMulti up to date with the SELECT, MULTI, EXEC, DISCARD and RESET commands in a write
+static void
+trackSession(RESPCLIENT *rcp,const byte *buf,size_t n)
+{
+  const byte *p=buf,*end=buf+n,*s;
+  size_t len;
+  long nArgs,i;
+
+  while(p<end && *p=='*')
+  {
+    for(nArgs=0,++p;p<end && isdigit(*p);p++)
+      nArgs=nArgs*10+(*p-'0');
+    p+=2;
+    if(nArgs<1 || !(s=nextArg(&p,end,&len)))
+      return;
+    if(len==6 && !strncasecmp((const char *)s,"SELECT",6) && nArgs==2 && (s=nextArg(&p,end,&len)))
+    {
+      rcp->db=(int)strtol((const char *)s,NULL,10);
+      continue;
+    }
+    if(len==5 && !strncasecmp((const char *)s,"MULTI",5))
+      rcp->inMulti=1;
+    else if((len==4 && !strncasecmp((const char *)s,"EXEC",4)) || (len==7 && !strncasecmp((const char *)s,"DISCARD",7)))
+      rcp->inMulti=0;
+    else if(len==5 && !strncasecmp((const char *)s,"RESET",5))
+      rcp->db=rcp->inMulti=0;
+    for(i=1;i<nArgs;i++)
+      if(!nextArg(&p,end,&len))
+        return;
+  }
+}
+
+// writes n bytes of already RESP encoded commands to the server
+int
 transmitRespCommand(RESPCLIENT *rcp,byte *buf,size_t n)
 {
   //struct pollfd ready; // PBR WTF: Not ready to delete this code yet.
-  ssize_t nSent;
+  uint64_t t0=0;
 
   //memset(&ready,0,sizeof(ready));
   //ready.events=POLLOUT; // |POLL_HUP|POLLERR;
 
-  do
+  if(!connectionReady(rcp))
+    return(RAMISFAIL);
+  if(rcp->pendUsed && buf!=rcp->pendBuf) // appended commands go first, in the same write
+  {
+    if(!appendPending(rcp,buf,n))
+      return(RAMISFAIL);
+    buf=rcp->pendBuf;
+    n=rcp->pendUsed;
+  }
+  rcp->pendUsed=0;
+  if(rcp->trackSession)
+    trackSession(rcp,buf,n);
+  if(rcp->metrics)
+    respMetricsRequestSent(rcp->metrics,buf,n);
+  if(rcp->hotKeys)
+    respHotKeysRequest(rcp->hotKeys,buf,n);
+  if(rcp->trace)
   {
+    respTraceRequest(rcp->trace,buf,n);
+    t0=respTraceNow();
+  }
+
     /*
     if(poll(&ready,1,RESPCLIENTTIMEOUT*1000)<0)
     {
@@ -533,29 +1077,378 @@ transmitRespCommand(RESPCLIENT *rcp,byte *buf,size_t n)
       return(RAMISFAIL);
     }
     */
-    nSent=write(rcp->socket,buf,n);
-    if(nSent<=0)
+  if(!sendRespData(rcp,buf,n))
+    return(RAMISFAIL);
+  
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACESEND,t0);
+  return(RAMISOK);
+}
+
+
+// RESP encodes an argument vector and transmits it without waiting for the reply.
+// The reply must be collected with getRespReply(). argvlen may be NULL for '\0' terminated args
+int
+postRespCommandArgv(RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen)
+{
+  ssize_t n;
+  uint64_t t0=0;
+  
+  rcp->rppFrom->errorMsg=NULL;
+  if(rcp->trace)
+    t0=respTraceNow();
+  n=respEncodeArgv(&rcp->toBuf,&rcp->toBufSz,0,argc,argv,argvlen);
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACEENCODE,t0);
+  if(n<0)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in postRespCommandArgv";
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(RAMISFAIL);
+  }
+  if(!transmitRespCommand(rcp,rcp->toBuf,n))
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(RAMISFAIL);
+  }
+  return(RAMISOK);
+}
+
+
+/* ****************************** file backed values ************************** */
+
+// sends len bytes of fd from off, or from its current position if off is -1. sendfile() moves them
+// from the page cache to the socket where it can, anything else is read through toBuf. The
+// header has gone already, so a short file leaves the server waiting and the connection is dropped
+static int
+sendFdPayload(RESPCLIENT *rcp,int fd,off_t off,size_t len)
+{
+  ssize_t n;
+
+#ifdef __linux__
+  while(len && !rcp->capture) // a capture needs the bytes, they're read below
+  {
+    n=sendfile(rcp->socket,fd,off<0?NULL:&off,len<RESPSENDFILEMAX?len:RESPSENDFILEMAX);
+    if(n<0 && errno==EINTR)
+      continue;
+    if(n<0 && (errno==EINVAL || errno==ENOSYS)) // fd can't be mapped, a pipe or some such
+      break;
+    if(rcp->metrics)
     {
-      rcp->rppFrom->errorMsg="Send to server socket failed";
+      rcp->metrics->sendCalls++;
+      rcp->metrics->bytesOut+=n>0?n:0;
+    }
+    if(n<=0)
+    {
+      rcp->rppFrom->errorMsg=n?strerror( errno ):"File ended before len bytes were sent";
+      connectionLost(rcp);
       return(RAMISFAIL);
     }
-    buf+=nSent;
-    n-=nSent;
-  } while(n);
-  
+    len-=n;
+  }
+#endif
+  while(len)
+  {
+    size_t part=len<rcp->toBufSz?len:rcp->toBufSz;
+
+    n=off<0?read(fd,rcp->toBuf,part):pread(fd,rcp->toBuf,part,off);
+    if(n<0 && errno==EINTR)
+      continue;
+    if(n<=0)
+    {
+      rcp->rppFrom->errorMsg=n?strerror( errno ):"File ended before len bytes were sent";
+      connectionLost(rcp);
+      return(RAMISFAIL);
+    }
+    if(!sendRespData(rcp,rcp->toBuf,n))
+      return(RAMISFAIL);
+    off+=off<0?0:n;
+    len-=n;
+  }
   return(RAMISOK);
 }
 
+// SET key to len bytes of fd starting at off, -1 for its current position, without reading them
+// into memory. Values sent this way aren't compressed
+RESPROTO *
+respSetFromFd(RESPCLIENT *rcp,const char *key,int fd,off_t off,size_t len)
+{
+  const char *argv[3]={"SET",key,""};
+  size_t argvlen[3]={3,strlen(key),0};
+  uint64_t t0=0;
+  ssize_t n;
 
-// RESP encodes parameters in a printf kind of way and sends them to the server
-// returns the server's reply in the form of a list of items in RESPROTO
+  rcp->rppFrom->errorMsg=NULL;
+  if(rcp->trace)
+    t0=respTraceNow();
+  // encoded with an empty value whose "$0\r\n\r\n" is replaced by the real length
+  n=respEncodeArgv(&rcp->toBuf,&rcp->toBufSz,0,3,argv,argvlen);
+  if(n>=0 && (size_t)n+RESPMAXDIGITS>rcp->toBufSz)
+  {
+    byte *newBuf=ramisRealloc(rcp->toBuf,n+RESPMAXDIGITS);
+
+    if(newBuf)
+    {
+      rcp->toBuf=newBuf;
+      rcp->toBufSz=n+RESPMAXDIGITS;
+    }
+    else
+      n=-1;
+  }
+  if(n<0)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respSetFromFd()";
+    return(NULL);
+  }
+  n-=6;
+  n+=sprintf((char *)rcp->toBuf+n,"$%zu\r\n",len);
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACEENCODE,t0);
+
+  if(!transmitRespCommand(rcp,rcp->toBuf,n))
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(NULL);
+  }
+  if(rcp->trace)
+    t0=respTraceNow();
+  if(!sendFdPayload(rcp,fd,off,len) || !sendRespData(rcp,(byte *)"\r\n",2))
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(NULL);
+  }
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACESEND,t0);
+  return(getRespReply(rcp));
+}
+
+// writes all n bytes to fd
+static int
+writeFd(int fd,const byte *buf,size_t n)
+{
+  ssize_t nWritten;
+
+  while(n)
+  {
+    nWritten=write(fd,buf,n);
+    if(nWritten<0 && errno==EINTR)
+      continue;
+    if(nWritten<=0)
+      return(RAMISFAIL);
+    buf+=nWritten;
+    n-=nWritten;
+  }
+  return(RAMISOK);
+}
+
+#ifdef __linux__
+// moves payload bytes from the socket to fd through a pipe with splice() so they never enter user
+// space. *remainingp counts down as they come off the socket. If fd can't be spliced to, what's
+// in the pipe is written normally and the caller copies the rest. If writing fails *outOkp is
+// cleared and the pipe's contents dropped, the caller reads and discards the rest
+static int
+spliceToFd(RESPCLIENT *rcp,int fd,size_t *remainingp,int *outOkp)
+{
+  int     pfd[2];
+  size_t  inPipe=0,pipeSize;
+  ssize_t n;
+  uint64_t t0=0;
+  int     ret=RAMISOK;
+
+  if(pipe(pfd)<0)
+    return(RAMISOK); // copied the ordinary way
+  if((n=fcntl(pfd[1],F_SETPIPE_SZ,RESPSPLICEPIPESZ))<0)
+    n=fcntl(pfd[1],F_GETPIPE_SZ);
+  pipeSize=n>0?(size_t)n:4096;
+
+  while(*remainingp || inPipe)
+  {
+    if(*remainingp && !inPipe)
+    {
+      if(rcp->trace)
+        t0=respTraceNow();
+      if(!rcp->waitForever && !waitForRespData(rcp))
+      {
+        ret=RAMISFAIL;
+        break;
+      }
+      n=splice(rcp->socket,NULL,pfd[1],NULL,*remainingp<pipeSize?*remainingp:pipeSize,SPLICE_F_MOVE|SPLICE_F_MORE);
+      if(rcp->trace)
+        respTracePhase(rcp->trace,RESPTRACEWAIT,t0);
+      if(n<0 && (errno==EINTR || errno==EAGAIN))
+        continue;
+      if(n<0 && errno==EINVAL) // this kernel won't splice from the socket
+        break;
+      if(rcp->metrics)
+      {
+        rcp->metrics->recvCalls++;
+        rcp->metrics->bytesIn+=n>0?n:0;
+      }
+      if(n<=0)
+      {
+        rcp->rppFrom->errorMsg=n?strerror( errno ):"Server closed the connection";
+        connectionLost(rcp);
+        ret=RAMISFAIL;
+        break;
+      }
+      *remainingp-=n;
+      inPipe=n;
+    }
+    n=splice(pfd[0],NULL,fd,NULL,inPipe,SPLICE_F_MOVE);
+    if(n<0 && errno==EINTR)
+      continue;
+    if(n<0 && errno==EINVAL) // fd doesn't take splices, an O_APPEND file for one
+    {
+      while(inPipe && (n=read(pfd[0],rcp->fromBuf,inPipe<rcp->fromBufSize?inPipe:rcp->fromBufSize))>0)
+      {
+        if(!writeFd(fd,rcp->fromBuf,n))
+          *outOkp=0;
+        inPipe-=n;
+      }
+      break;
+    }
+    if(n<=0)
+    {
+      *outOkp=0;
+      break;
+    }
+    inPipe-=n;
+  }
+  close(pfd[0]);
+  close(pfd[1]);
+  return(ret);
+}
+#endif
+
+// GETs key and writes its value to fd as it arrives, with splice() where it can. Memory use doesn't
+// depend on the value's size. Returns the reply as getRespReplyToSink() does, NULL if fd couldn't
+// be written to. Compressed values are written as they're stored
 RESPROTO *
-sendRespCommand(RESPCLIENT *rcp,char *fmt,...)
+respGetToFd(RESPCLIENT *rcp,const char *key,int fd)
+{
+  const char *argv[2]={"GET",key};
+  RESPROTO *rpp;
+  ssize_t  nread;
+  byte    *chunk;
+  size_t   chunkLen,part;
+  size_t   remaining;   // payload bytes still on the socket
+  size_t   trailer=2;
+  int64_t  payloadLen;
+  int      outOk=1;
+
+  if(!postRespCommandArgv(rcp,2,argv,NULL))
+    return(NULL);
+  if((payloadLen=readBulkHeader(rcp,&chunk,&chunkLen,&rpp))<0)
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,!rpp);
+    return(rpp);
+  }
+
+  // whatever of the payload and trailer came in with the header
+  part=chunkLen<(size_t)payloadLen?chunkLen:(size_t)payloadLen;
+  outOk=writeFd(fd,chunk,part);
+  remaining=(size_t)payloadLen-part;
+  trailer-=chunkLen-part<trailer?chunkLen-part:trailer;
+
+#ifdef __linux__
+  if(remaining && outOk && !rcp->capture && !spliceToFd(rcp,fd,&remaining,&outOk))
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(NULL);
+  }
+#endif
+  // the rest, and anything to be thrown away to stay in sync with the server
+  while(remaining+trailer)
+  {
+    nread=recvRespData(rcp,rcp->fromBuf,remaining+trailer<rcp->fromBufSize?remaining+trailer:rcp->fromBufSize);
+    if(nread<0)
+    {
+      if(rcp->trace)
+        respTraceDone(rcp->trace,1);
+      return(NULL);
+    }
+    part=(size_t)nread<remaining?(size_t)nread:remaining;
+    if(outOk && part)
+      outOk=writeFd(fd,rcp->fromBuf,part);
+    remaining-=part;
+    trailer-=nread-part;
+  }
+
+  if(rcp->trace)
+    respTraceDone(rcp->trace,!outOk);
+  if(!outOk)
+  {
+    resetResProto(rcp->rppFrom);
+    rcp->rppFrom->errorMsg="Could not write the value to fd in respGetToFd()";
+    return(NULL);
+  }
+  return(streamedReply(rcp,(size_t)payloadLen));
+}
+
+
+// RESP encodes an argument vector, sends it and waits for the reply
+RESPROTO *
+sendRespCommandArgv(RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen)
+{
+  if(!postRespCommandArgv(rcp,argc,argv,argvlen))
+    return(NULL);
+  return(getRespReply(rcp));
+}
+
+int
+appendRespCommandArgv(RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen)
+{
+  ssize_t n=respEncodeArgv(&rcp->pendBuf,&rcp->pendBufSz,rcp->pendUsed,argc,argv,argvlen);
+
+  if(n<0)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in appendRespCommandArgv";
+    return(RAMISFAIL);
+  }
+  rcp->pendUsed+=n;
+  return(RAMISOK);
+}
+
+int
+appendRespCommand(RESPCLIENT *rcp,char *fmt,...)
+{
+  va_list arg;
+  ssize_t n;
+
+  va_start(arg,fmt);
+  n=appendRespCommandV(rcp,&rcp->pendBuf,&rcp->pendBufSz,rcp->pendUsed,fmt,&arg);
+  va_end(arg);
+  if(n<0)
+    return(RAMISFAIL);
+  rcp->pendUsed+=n;
+  return(RAMISOK);
+}
+
+int
+flushRespCommands(RESPCLIENT *rcp)
+{
+  if(!rcp->pendUsed)
+    return(RAMISOK);
+  return(transmitRespCommand(rcp,rcp->pendBuf,rcp->pendUsed));
+}
+
+
+// RESP encodes parameters in a printf kind of way into *enc->bufp at enc->used
+// returns the number of bytes encoded or 0 on error
+static size_t
+encodeRespInto(RESPENCODER *enc,char *fmt,va_list *argp)
 {
   char   *p,*q,t;
+  char   *token;
   char   *outBuffer;
   char   *bufp;
-  char   *fmtCopy=strdup(fmt); // everyone gets pissy if we touch the passed fmt
+  char   *fmtCopy;
   va_list arg;
   size_t *argSizes;
   int     argIndex=0;
@@ -563,35 +1456,32 @@ sendRespCommand(RESPCLIENT *rcp,char *fmt,...)
 // char   *nullBulkString="$-1\r\n"; PBR WTF I have not yet implemented NULL transmission
   
   
-  va_start(arg,fmt);
-
-  argSizes=sendRespBufNeeded(rcp,fmt,&arg);
-  RP_VA_ARG
+  argSizes=respBufNeededFor(enc,fmt,argp);
 
   if(!argSizes)
-   return(NULL); // parser or malloc error
+   return(0); // parser or malloc error
    
+  fmtCopy=strdup(fmt); // everyone gets pissy if we touch the passed fmt
   if(!fmtCopy)
   {
-     bufferFail:
-     if(fmtCopy)
-         ramisFree(fmtCopy);
-     rcp->rppFrom->errorMsg="Malloc error in sendRespCommand";
-     return(NULL);
+     ramisFree(argSizes);
+     *enc->errorMsgp="Malloc error in sendRespCommand";
+     return(0);
   }
   
-  outBuffer=(char *)rcp->toBuf;
+  outBuffer=(char *)*enc->bufp+enc->used;
   bufp=outBuffer;
   
   // print the RESP array header ( this accounting was not
-  rcp->rppFrom->errorMsg=NULL;
+  *enc->errorMsgp=NULL;
   sprintf(bufp,"*%d\r\n",countRespCommandItems(fmt));
   bufp+=strlen(bufp);
   
   bufp+=strlen(bufp);  // not checking for fit here because it has to be long enough
   outBuffer=bufp;
   
-  va_start(arg,fmt);
+  va_copy(arg,*argp);
+  RP_VA_ARG
   for(p=fmtCopy;*p;)
   {
     while(isspace(*p)) ++p;
@@ -605,6 +1495,7 @@ sendRespCommand(RESPCLIENT *rcp,char *fmt,...)
     for(q=p;*q && !isspace(*q);q++); // find the end of this sequence and terminate it
     t=*q;  // save whatever's pointed to by q
     *q='\0';
+    token=p;
      
     while(*p)
     {
@@ -630,6 +1521,12 @@ sendRespCommand(RESPCLIENT *rcp,char *fmt,...)
             {
               char * thisArg=(char *)VA_ARG(arg,byte *);
               size_t thisLen=VA_ARG(arg,size_t);
+              if(enc->codec && !strcmp(token,"%b"))
+              {
+                byte *packed=respCodecNextPacked(enc->codec,&thisLen);
+                if(packed)
+                  thisArg=(char *)packed;
+              }
               memcpy(bufp,thisArg,thisLen);
               bufp+=thisLen;
               p+=pctCode->length;
@@ -693,10 +1590,10 @@ sendRespCommand(RESPCLIENT *rcp,char *fmt,...)
             case unknown:
             default:
             {
-              rcp->rppFrom->errorMsg="Invalid % code in sendRespCommand()";
+              *enc->errorMsgp="Invalid % code in sendRespCommand()";
               ramisFree(argSizes);
               ramisFree(fmtCopy);
-              return(NULL);
+              return(0);
             }
         }
       }
@@ -713,18 +1610,259 @@ sendRespCommand(RESPCLIENT *rcp,char *fmt,...)
   }
   VA_END(arg);
   
-   //fwrite(rcp->toBuf,(byte *)bufp-rcp->toBuf,1,stdout);
+   //fwrite(outBuffer,bufp-outBuffer,1,stdout);
    // printf("\n\n");
    
-  if(!transmitRespCommand(rcp,rcp->toBuf,(byte *)bufp-rcp->toBuf))
-      return(NULL);
-   
   ramisFree(argSizes);
   ramisFree(fmtCopy);
+  return((byte *)bufp-(*enc->bufp+enc->used));
+}
+
+
+// RESP encodes parameters in a printf kind of way into rcp->toBuf
+// returns the number of bytes encoded or 0 on error
+static size_t
+encodeRespCommand(RESPCLIENT *rcp,char *fmt,va_list *argp)
+{
+  RESPENCODER enc={rcp->codec,&rcp->toBuf,&rcp->toBufSz,0,&rcp->rppFrom->errorMsg};
+
+  return(encodeRespInto(&enc,fmt,argp));
+}
+
+
+// RESP encodes parameters in a printf kind of way and appends them to *outBufp at offset used
+// growing it if needed. Nothing is sent. Returns the number of bytes appended or -1 on error
+ssize_t
+appendRespCommandV(RESPCLIENT *rcp,byte **outBufp,size_t *outBufszp,size_t used,char *fmt,va_list *argp)
+{
+  RESPENCODER enc={rcp->codec,outBufp,outBufszp,used,&rcp->rppFrom->errorMsg};
+  size_t n=encodeRespInto(&enc,fmt,argp);
+  
+  return(n?(ssize_t)n:-1);
+}
+
+// the same without a client, so nothing is compressed. errorMsgp may be NULL
+ssize_t
+respEncodeIntoV(byte **outBufp,size_t *outBufszp,size_t used,char **errorMsgp,char *fmt,va_list *argp)
+{
+  char *errorMsg=NULL;
+  RESPENCODER enc={NULL,outBufp,outBufszp,used,errorMsgp?errorMsgp:&errorMsg};
+  size_t n=encodeRespInto(&enc,fmt,argp);
+  
+  return(n?(ssize_t)n:-1);
+}
+
+ssize_t
+respEncodeInto(byte **outBufp,size_t *outBufszp,size_t used,char *fmt,...)
+{
+  va_list arg;
+  ssize_t n;
+  
+  va_start(arg,fmt);
+  n=respEncodeIntoV(outBufp,outBufszp,used,NULL,fmt,&arg);
+  va_end(arg);
+  return(n);
+}
+
+// declared in resp_protocol.h but kept here with the encoder it uses. Writes the command to fh,
+// for programs that generate input for ramis_load. Returns the number of bytes written or -1 with
+// rpp->errorMsg set, rpp may be NULL
+int
+respPrintf(RESPROTO *rpp,FILE *fh,char *fmt,...)
+{
+  byte   *buf=NULL;
+  size_t  bufSz=0;
+  char   *errorMsg=NULL;
+  va_list arg;
+  ssize_t n;
+  
+  va_start(arg,fmt);
+  n=respEncodeIntoV(&buf,&bufSz,0,&errorMsg,fmt,&arg);
+  va_end(arg);
+  if(n>=0 && fwrite(buf,1,n,fh)!=(size_t)n)
+  {
+    errorMsg="Write error in respPrintf()";
+    n=-1;
+  }
+  if(buf)
+    ramisFree(buf);
+  if(rpp)
+    rpp->errorMsg=errorMsg;
+  return(n<0?-1:(int)n);
+}
+
+
+// RESP encodes parameters in a printf kind of way and sends them to the server
+// returns the server's reply in the form of a list of items in RESPROTO
+RESPROTO *
+sendRespCommand(RESPCLIENT *rcp,char *fmt,...)
+{
+  va_list arg;
+  size_t  n;
+  uint64_t t0=0;
+  
+  if(rcp->trace)
+    t0=respTraceNow();
+  va_start(arg,fmt);
+  n=encodeRespCommand(rcp,fmt,&arg);
+  va_end(arg);
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACEENCODE,t0);
+  
+  if(!n || !transmitRespCommand(rcp,rcp->toBuf,n))
+  {
+      if(rcp->trace)
+        respTraceDone(rcp->trace,1);
+      return(NULL);
+  }
+   
   return(getRespReply(rcp)); // everything was fine so far, so return the reply from the server 
 }
 
 
+// Values sent with a %b that is a whole argument and at least threshold bytes long are compressed
+// and tagged. Bulk string replies carrying the tag are decompressed before getRespReply() returns.
+// Every client reading those values needs compression on. A threshold of 0 turns it off.
+int
+respClientCompression(RESPCLIENT *rcp,size_t threshold)
+{
+  if(!threshold)
+  {
+    rcp->codec=freeRespCodec(rcp->codec);
+    return(RAMISOK);
+  }
+  if(!rcp->codec && !(rcp->codec=newRespCodec(threshold)))
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respClientCompression";
+    return(RAMISFAIL);
+  }
+  rcp->codec->threshold=threshold;
+  return(RAMISOK);
+}
+
+
+// With this on, a connection that times out or fails is closed and a background thread makes
+// a new one, backing off between attempts. Until it has, requests fail at once instead of
+// waiting on connect(). Replies that were outstanding on the old connection are lost.
+int
+respClientBackgroundReconnect(RESPCLIENT *rcp,int onOff)
+{
+  if(!onOff)
+  {
+    if(rcp->reconnect && rcp->socket<0)
+      rcp->socket=respReconnectTake(rcp->reconnect);
+    rcp->reconnect=freeRespReconnect(rcp->reconnect);
+    if(rcp->socket<0) // nothing was ready yet, back to reconnecting the old way
+      return(reconnectRespServer(rcp));
+    return(RAMISOK);
+  }
+  if(!rcp->reconnect && !(rcp->reconnect=newRespReconnect(rcp->hostname,rcp->port)))
+  {
+    rcp->rppFrom->errorMsg="Could not start the reconnect thread in respClientBackgroundReconnect()";
+    return(RAMISFAIL);
+  }
+  return(RAMISOK);
+}
+
+
+// Counts what the client does and times each command from send to reply, see resp_metrics.h
+int
+respClientMetrics(RESPCLIENT *rcp,int onOff)
+{
+  if(!onOff)
+    rcp->metrics=freeRespMetrics(rcp->metrics);
+  else
+  if(!rcp->metrics && !(rcp->metrics=newRespMetrics()))
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respClientMetrics()";
+    return(RAMISFAIL);
+  }
+  return(RAMISOK);
+}
+
+// copies the client's metrics into dst, which came from newRespMetrics(). The buffer growth
+// counts are the parser's and go back to when the client was made
+int
+respClientMetricsSnapshot(RESPCLIENT *rcp,RESPMETRICS *dst)
+{
+  respMetricsReset(dst);
+  if(!rcp->metrics)
+    return(RAMISOK);
+  if(!respMetricsMerge(dst,rcp->metrics))
+    return(RAMISFAIL);
+  dst->bufGrowths=rcp->rppFrom->nBufGrowths;
+  dst->itemGrowths=rcp->rppFrom->nItemGrowths;
+  return(RAMISOK);
+}
+
+
+// Times each command's phases, calling hook (which may be NULL) as each one ends, and keeps the
+// last nSlowLog commands that took at least slowNs in the slow log. A NULL hook and nSlowLog
+// of 0 turns tracing off. See resp_trace.h
+int
+respClientTrace(RESPCLIENT *rcp,respTraceHook hook,void *hookData,uint64_t slowNs,int nSlowLog)
+{
+  rcp->trace=freeRespTrace(rcp->trace);
+  if(!hook && nSlowLog<=0)
+    return(RAMISOK);
+  if(!(rcp->trace=newRespTrace(hook,hookData,slowNs,nSlowLog)))
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respClientTrace()";
+    return(RAMISFAIL);
+  }
+  return(RAMISOK);
+}
+
+
+// Writes everything sent and received from now on to path for ramis_replay, stopping once
+// maxBytes (0 for no limit) have been written. A NULL path ends the capture and closes the file.
+// File backed values are read through the client's buffer rather than sendfile() and splice()
+// while capturing. See resp_capture.h
+int
+respClientCapture(RESPCLIENT *rcp,const char *path,uint64_t maxBytes)
+{
+  rcp->capture=freeRespCapture(rcp->capture);
+  if(!path)
+    return(RAMISOK);
+  if(!(rcp->capture=newRespCapture(path,maxBytes)))
+  {
+    rcp->rppFrom->errorMsg="Could not create the capture file in respClientCapture()";
+    return(RAMISFAIL);
+  }
+  return(RAMISOK);
+}
+
+
+// Samples the keys of 1 in sampleEvery writes into a count-min sketch and keeps the k hottest
+// with their reads and writes. With a dumpFh they're written to it every dumpSecs, and the
+// counts start over. A k of 0 turns it off. See resp_hotkeys.h
+int
+respClientHotKeys(RESPCLIENT *rcp,int k,uint32_t sampleEvery,FILE *dumpFh,int dumpSecs)
+{
+  rcp->hotKeys=freeRespHotKeys(rcp->hotKeys);
+  if(k<=0)
+    return(RAMISOK);
+  if(!(rcp->hotKeys=newRespHotKeys(k,sampleEvery)))
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respClientHotKeys()";
+    return(RAMISFAIL);
+  }
+  if(dumpFh)
+    respHotKeysDumpEvery(rcp->hotKeys,dumpFh,dumpSecs);
+  return(RAMISOK);
+}
+
+// copies up to max of the hot keys into out, hottest first. Divide their counts by
+// respHotKeysWindowSecs(rcp->hotKeys) for rates
+int
+respClientHotKeysTop(RESPCLIENT *rcp,RESPHOTKEY *out,int max)
+{
+  if(!rcp->hotKeys)
+    return(0);
+  return(respHotKeysTop(rcp->hotKeys,out,max));
+}
+
+
 // Sees if anything went wrong. If everything's ok returns NULL , otherwise an error message.
 char *
 respClienError(RESPCLIENT *rcp)
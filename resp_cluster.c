@@ -0,0 +1,861 @@
+//
+//  resp_cluster.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Nodes are added as the slot map and redirections name them and connected when first
+//  used. A MOVED fixes the one slot at once and marks the map stale so the whole of it is
+//  reloaded before the next command, since resharding moves many slots together.
+//  Values in the replies to split commands are copied into an arena because parts of a
+//  command that get redirected are sent again on connections whose buffers the earlier
+//  replies are in.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_cluster.h"
+
+#define CLUSTERMERGEARRAY 1 // MGET, an array of values in the caller's key order
+#define CLUSTERMERGEOK    2 // MSET, +OK if every node said so
+#define CLUSTERMERGESUM   3 // DEL and friends, the sum of the nodes' counts
+
+#define CLUSTERMOVED      1
+#define CLUSTERASK        2
+#define CLUSTERTRYAGAIN   3
+
+#define CLUSTERSPLIT struct clusterSplitStruct
+CLUSTERSPLIT
+{
+  const char *command;
+  int         step;    // arguments per key
+  int         merge;   // CLUSTERMERGE*
+};
+
+static const CLUSTERSPLIT splitCommands[]=
+{
+  {"MGET",  1,CLUSTERMERGEARRAY},
+  {"MSET",  2,CLUSTERMERGEOK},
+  {"DEL",   1,CLUSTERMERGESUM},
+  {"UNLINK",1,CLUSTERMERGESUM},
+  {"EXISTS",1,CLUSTERMERGESUM},
+  {"TOUCH", 1,CLUSTERMERGESUM},
+  {NULL,0,0}
+};
+
+// CRC16-CCITT (XMODEM) as the cluster spec has it
+static const uint16_t crc16Table[256]=
+{
+  0x0000,0x1021,0x2042,0x3063,0x4084,0x50a5,0x60c6,0x70e7,
+  0x8108,0x9129,0xa14a,0xb16b,0xc18c,0xd1ad,0xe1ce,0xf1ef,
+  0x1231,0x0210,0x3273,0x2252,0x52b5,0x4294,0x72f7,0x62d6,
+  0x9339,0x8318,0xb37b,0xa35a,0xd3bd,0xc39c,0xf3ff,0xe3de,
+  0x2462,0x3443,0x0420,0x1401,0x64e6,0x74c7,0x44a4,0x5485,
+  0xa56a,0xb54b,0x8528,0x9509,0xe5ee,0xf5cf,0xc5ac,0xd58d,
+  0x3653,0x2672,0x1611,0x0630,0x76d7,0x66f6,0x5695,0x46b4,
+  0xb75b,0xa77a,0x9719,0x8738,0xf7df,0xe7fe,0xd79d,0xc7bc,
+  0x48c4,0x58e5,0x6886,0x78a7,0x0840,0x1861,0x2802,0x3823,
+  0xc9cc,0xd9ed,0xe98e,0xf9af,0x8948,0x9969,0xa90a,0xb92b,
+  0x5af5,0x4ad4,0x7ab7,0x6a96,0x1a71,0x0a50,0x3a33,0x2a12,
+  0xdbfd,0xcbdc,0xfbbf,0xeb9e,0x9b79,0x8b58,0xbb3b,0xab1a,
+  0x6ca6,0x7c87,0x4ce4,0x5cc5,0x2c22,0x3c03,0x0c60,0x1c41,
+  0xedae,0xfd8f,0xcdec,0xddcd,0xad2a,0xbd0b,0x8d68,0x9d49,
+  0x7e97,0x6eb6,0x5ed5,0x4ef4,0x3e13,0x2e32,0x1e51,0x0e70,
+  0xff9f,0xefbe,0xdfdd,0xcffc,0xbf1b,0xaf3a,0x9f59,0x8f78,
+  0x9188,0x81a9,0xb1ca,0xa1eb,0xd10c,0xc12d,0xf14e,0xe16f,
+  0x1080,0x00a1,0x30c2,0x20e3,0x5004,0x4025,0x7046,0x6067,
+  0x83b9,0x9398,0xa3fb,0xb3da,0xc33d,0xd31c,0xe37f,0xf35e,
+  0x02b1,0x1290,0x22f3,0x32d2,0x4235,0x5214,0x6277,0x7256,
+  0xb5ea,0xa5cb,0x95a8,0x8589,0xf56e,0xe54f,0xd52c,0xc50d,
+  0x34e2,0x24c3,0x14a0,0x0481,0x7466,0x6447,0x5424,0x4405,
+  0xa7db,0xb7fa,0x8799,0x97b8,0xe75f,0xf77e,0xc71d,0xd73c,
+  0x26d3,0x36f2,0x0691,0x16b0,0x6657,0x7676,0x4615,0x5634,
+  0xd94c,0xc96d,0xf90e,0xe92f,0x99c8,0x89e9,0xb98a,0xa9ab,
+  0x5844,0x4865,0x7806,0x6827,0x18c0,0x08e1,0x3882,0x28a3,
+  0xcb7d,0xdb5c,0xeb3f,0xfb1e,0x8bf9,0x9bd8,0xabbb,0xbb9a,
+  0x4a75,0x5a54,0x6a37,0x7a16,0x0af1,0x1ad0,0x2ab3,0x3a92,
+  0xfd2e,0xed0f,0xdd6c,0xcd4d,0xbdaa,0xad8b,0x9de8,0x8dc9,
+  0x7c26,0x6c07,0x5c64,0x4c45,0x3ca2,0x2c83,0x1ce0,0x0cc1,
+  0xef1f,0xff3e,0xcf5d,0xdf7c,0xaf9b,0xbfba,0x8fd9,0x9ff8,
+  0x6e17,0x7e36,0x4e55,0x5e74,0x2e93,0x3eb2,0x0ed1,0x1ef0
+};
+
+
+int
+respClusterSlot(const char *key,size_t keyLen)
+{
+  const char *open=memchr(key,'{',keyLen);
+  const char *close;
+  uint16_t crc=0;
+
+  if(open && (close=memchr(open+1,'}',key+keyLen-open-1))!=NULL && close>open+1)
+  {
+    key=open+1;
+    keyLen=close-key;
+  }
+  while(keyLen--)
+    crc=(uint16_t)(crc<<8)^crc16Table[((crc>>8)^(byte)*key++)&0xff];
+  return(crc&(RESPCLUSTERSLOTS-1));
+}
+
+static size_t
+argLength(const char **argv,const size_t *argvlen,int i)
+{
+  return(argvlen?argvlen[i]:strlen(argv[i]));
+}
+
+static int
+compareOrder(const void *a,const void *b)
+{
+  uint64_t oa=*(const uint64_t *)a;
+  uint64_t ob=*(const uint64_t *)b;
+
+  return(oa<ob?-1:oa>ob);
+}
+
+
+RESPCLUSTER *
+respClusterClose(RESPCLUSTER *rcl)
+{
+  int i;
+
+  if(rcl)
+  {
+    if(rcl->nodes)
+    {
+      for(i=0;i<rcl->nNodes;i++)
+      {
+        closeRespClient(rcl->nodes[i].rcp);
+        ramisFree(rcl->nodes[i].host);
+      }
+      ramisFree(rcl->nodes);
+    }
+    if(rcl->slots)
+      ramisFree(rcl->slots);
+    if(rcl->reply)
+      freeRespProto(rcl->reply);
+    if(rcl->keySlot)
+      ramisFree(rcl->keySlot);
+    if(rcl->keyAsk)
+      ramisFree(rcl->keyAsk);
+    if(rcl->keyDone)
+      ramisFree(rcl->keyDone);
+    if(rcl->keyValue)
+      ramisFree(rcl->keyValue);
+    if(rcl->order)
+      ramisFree(rcl->order);
+    if(rcl->parts)
+      ramisFree(rcl->parts);
+    if(rcl->argv)
+      ramisFree(rcl->argv);
+    if(rcl->argvlen)
+      ramisFree(rcl->argvlen);
+    if(rcl->arena)
+      ramisFree(rcl->arena);
+    ramisFree(rcl);
+  }
+  return(NULL);
+}
+
+// the index of the node at host:port, which is added if it's new. -1 on failure
+static int
+findNode(RESPCLUSTER *rcl,const char *host,size_t hostLen,int port)
+{
+  RESPCLUSTERNODE *node;
+  int i;
+
+  for(i=0;i<rcl->nNodes;i++)
+    if(rcl->nodes[i].port==port && strlen(rcl->nodes[i].host)==hostLen && !memcmp(rcl->nodes[i].host,host,hostLen))
+      return(i);
+
+  if(rcl->nNodes==RESPCLUSTERMAXNODES)
+    return(-1);
+  if(rcl->nNodes==rcl->maxNodes)
+  {
+    int newMax=rcl->maxNodes?rcl->maxNodes*2:8;
+    RESPCLUSTERNODE *newNodes=ramisRealloc(rcl->nodes,newMax*sizeof(RESPCLUSTERNODE));
+
+    if(!newNodes)
+      return(-1);
+    rcl->nodes=newNodes;
+    rcl->maxNodes=newMax;
+  }
+  node=&rcl->nodes[rcl->nNodes];
+  if(!(node->host=ramisMalloc(hostLen+1)))
+    return(-1);
+  memcpy(node->host,host,hostLen);
+  node->host[hostLen]='\0';
+  node->port=port;
+  node->rcp=NULL;
+  return(rcl->nNodes++);
+}
+
+// the node's connection, made if it hasn't been yet
+static RESPCLIENT *
+nodeClient(RESPCLUSTER *rcl,int node)
+{
+  RESPCLUSTERNODE *np=&rcl->nodes[node];
+
+  if(!np->rcp && !(np->rcp=connectRespServer(np->host,np->port)))
+    rcl->stale=1;
+  return(np->rcp);
+}
+
+// a node for commands without keys, one that's connected already if there is one
+static int
+anyNode(RESPCLUSTER *rcl)
+{
+  int i;
+
+  for(i=0;i<rcl->nNodes;i++)
+    if(rcl->nodes[i].rcp)
+      return(i);
+  return(rcl->slots[0]>-1?rcl->slots[0]:0);
+}
+
+static int
+itemIs(RESPITEM *item,const char *s)
+{
+  size_t len=strlen(s);
+
+  return((item->respType==RESPISBULKSTR || item->respType==RESPISSTR) && item->length==len && !strncasecmp((char *)item->loc,s,len));
+}
+
+static void
+assignSlots(int16_t *slots,int64_t start,int64_t end,int node)
+{
+  for(;start<=end;start++)
+    if(start>=0 && start<RESPCLUSTERSLOTS)
+      slots[start]=(int16_t)node;
+}
+
+// the node a slot map entry names, an empty or "?" host is the node that sent the map
+static int
+mapNode(RESPCLUSTER *rcl,RESPITEM *host,int port,int fromNode)
+{
+  if(host && host->length && !itemIs(host,"?"))
+    return(findNode(rcl,(char *)host->loc,host->length,port));
+  return(findNode(rcl,rcl->nodes[fromNode].host,strlen(rcl->nodes[fromNode].host),port));
+}
+
+// reads a CLUSTER SLOTS reply: [[start,end,[host,port,id],replicas...],...]
+static int
+loadSlots(RESPCLUSTER *rcl,RESPROTO *rpp,int fromNode,int16_t *slots)
+{
+  RESPITEM *items=rpp->items;
+  uint64_t  e;
+  int       i=1,span,node;
+
+  if(!rpp->nItems || items[0].respType!=RESPISARRAY)
+    return(RAMISFAIL);
+  for(e=0;e<items[0].nItems;e++,i+=span)
+  {
+    if(!(span=respReplySpan(items,rpp->nItems,i)))
+      return(RAMISFAIL);
+    if(span<6 || items[i].respType!=RESPISARRAY || items[i+3].respType!=RESPISARRAY ||
+       items[i+1].respType!=RESPISINT || items[i+2].respType!=RESPISINT || items[i+5].respType!=RESPISINT)
+      return(RAMISFAIL);
+    if((node=mapNode(rcl,&items[i+4],(int)items[i+5].rinteger,fromNode))<0)
+      return(RAMISFAIL);
+    assignSlots(slots,items[i+1].rinteger,items[i+2].rinteger,node);
+  }
+  return(RAMISOK);
+}
+
+// the master in the "nodes" list of a CLUSTER SHARDS shard. Each node is a list of names and values
+static int
+shardMaster(RESPCLUSTER *rcl,RESPROTO *rpp,int list,int fromNode)
+{
+  RESPITEM *items=rpp->items;
+  RESPITEM *host;
+  uint64_t  n,f;
+  int       k=list+1,l,port,isMaster,span;
+
+  for(n=0;n<items[list].nItems;n++,k+=span)
+  {
+    if(!(span=respReplySpan(items,rpp->nItems,k)) || items[k].respType!=RESPISARRAY)
+      return(-1);
+    host=NULL;port=-1;isMaster=0;
+    for(f=0,l=k+1;f<items[k].nItems/2 && l+1<k+span;f++,l+=1+respReplySpan(items,rpp->nItems,l+1))
+    {
+      if(itemIs(&items[l],"endpoint") || (itemIs(&items[l],"ip") && !host))
+        host=&items[l+1];
+      else
+      if(itemIs(&items[l],"port") && items[l+1].respType==RESPISINT)
+        port=(int)items[l+1].rinteger;
+      else
+      if(itemIs(&items[l],"role"))
+        isMaster=itemIs(&items[l+1],"master") || itemIs(&items[l+1],"primary");
+    }
+    if(isMaster && port>0)
+      return(mapNode(rcl,host,port,fromNode));
+  }
+  return(-1);
+}
+
+// reads a CLUSTER SHARDS reply. Each shard is a list of names and values, "slots" is [start,end,...]
+static int
+loadShards(RESPCLUSTER *rcl,RESPROTO *rpp,int fromNode,int16_t *slots)
+{
+  RESPITEM *items=rpp->items;
+  uint64_t  s,f,r;
+  int       i=1,span,j,ranges,nRanges,master;
+
+  if(!rpp->nItems || items[0].respType!=RESPISARRAY)
+    return(RAMISFAIL);
+  for(s=0;s<items[0].nItems;s++,i+=span)
+  {
+    if(!(span=respReplySpan(items,rpp->nItems,i)) || items[i].respType!=RESPISARRAY)
+      return(RAMISFAIL);
+    ranges=-1;nRanges=0;master=-1;
+    for(f=0,j=i+1;f<items[i].nItems/2 && j+1<i+span;f++,j+=1+respReplySpan(items,rpp->nItems,j+1))
+    {
+      if(itemIs(&items[j],"slots") && items[j+1].respType==RESPISARRAY)
+      {
+        ranges=j+2;
+        nRanges=(int)items[j+1].nItems/2;
+      }
+      else
+      if(itemIs(&items[j],"nodes") && items[j+1].respType==RESPISARRAY)
+        master=shardMaster(rcl,rpp,j+1,fromNode);
+    }
+    if(master<0) // a shard without a master serves nothing
+      continue;
+    for(r=0;r<(uint64_t)nRanges;r++)
+      assignSlots(slots,items[ranges+2*r].rinteger,items[ranges+2*r+1].rinteger,master);
+  }
+  return(RAMISOK);
+}
+
+int
+respClusterRefresh(RESPCLUSTER *rcl)
+{
+  int16_t *slots=ramisMalloc(RESPCLUSTERSLOTS*sizeof(int16_t));
+  RESPCLIENT *rcp;
+  RESPROTO *rpp;
+  int pass,i,loaded=0;
+
+  if(!slots)
+  {
+    rcl->reply->errorMsg="Memory allocation error in respClusterRefresh()";
+    return(RAMISFAIL);
+  }
+  // nodes we're connected to first, then the rest
+  for(pass=0;pass<2 && !loaded;pass++)
+    for(i=0;i<rcl->nNodes && !loaded;i++)
+    {
+      if((pass==0)!=(rcl->nodes[i].rcp!=NULL) || !(rcp=nodeClient(rcl,i)))
+        continue;
+      memset(slots,0xff,RESPCLUSTERSLOTS*sizeof(int16_t));
+      if(!(rpp=sendRespCommand(rcp,"CLUSTER SLOTS")))
+        continue;
+      if(rpp->items[0].respType==RESPISARRAY)
+        loaded=loadSlots(rcl,rpp,i,slots);
+      else
+      if((rpp=sendRespCommand(rcp,"CLUSTER SHARDS"))) // for servers that have dropped SLOTS
+        loaded=loadShards(rcl,rpp,i,slots);
+    }
+  if(loaded)
+  {
+    memcpy(rcl->slots,slots,RESPCLUSTERSLOTS*sizeof(int16_t));
+    rcl->stale=0;
+  }
+  else
+    rcl->reply->errorMsg="Could not load the slot map from any cluster node";
+  ramisFree(slots);
+  return(loaded);
+}
+
+RESPCLUSTER *
+respClusterOpen(int nSeeds,char **hostnames,int *ports)
+{
+  RESPCLUSTER *rcl;
+  int i;
+
+  if(nSeeds<1)
+    return(NULL);
+  rcl=ramisCalloc(1,sizeof(RESPCLUSTER));
+  if(!rcl)
+    return(NULL);
+  rcl->slots=ramisMalloc(RESPCLUSTERSLOTS*sizeof(int16_t));
+  rcl->reply=newResProto(0);
+  if(!rcl->slots || !rcl->reply)
+    return(respClusterClose(rcl));
+  memset(rcl->slots,0xff,RESPCLUSTERSLOTS*sizeof(int16_t));
+  for(i=0;i<nSeeds;i++)
+    if(findNode(rcl,hostnames[i],strlen(hostnames[i]),ports[i])<0)
+      return(respClusterClose(rcl));
+  if(!respClusterRefresh(rcl))
+    return(respClusterClose(rcl));
+  return(rcl);
+}
+
+RESPCLIENT *
+respClusterClient(RESPCLUSTER *rcl,const char *key)
+{
+  int node=rcl->slots[respClusterSlot(key,strlen(key))];
+
+  return(node<0?NULL:nodeClient(rcl,node));
+}
+
+
+// sees if a reply is a MOVED, ASK or TRYAGAIN error. For MOVED and ASK *slotp and *nodep are set
+// to the slot and the node that has it now, which is added if it's new
+static int
+redirectOf(RESPCLUSTER *rcl,RESPITEM *item,int fromNode,int *slotp,int *nodep)
+{
+  const char *s=(const char *)item->loc,*end,*p,*colon=NULL;
+  char *numEnd;
+  int kind;
+
+  if(item->respType!=RESPISERRORMSG)
+    return(0);
+  end=s+item->length;
+  if(item->length>6 && !strncmp(s,"MOVED ",6))
+  {
+    kind=CLUSTERMOVED;
+    p=s+6;
+  }
+  else
+  if(item->length>4 && !strncmp(s,"ASK ",4))
+  {
+    kind=CLUSTERASK;
+    p=s+4;
+  }
+  else
+    return(item->length>=8 && !strncmp(s,"TRYAGAIN",8)?CLUSTERTRYAGAIN:0);
+
+  *slotp=(int)strtol(p,&numEnd,10);
+  if(numEnd==p || *numEnd!=' ' || *slotp<0 || *slotp>=RESPCLUSTERSLOTS)
+    return(0);
+  for(p=numEnd+1,s=p;s<end;s++) // the port is after the last ':', IPv6 addresses have others
+    if(*s==':')
+      colon=s;
+  if(!colon)
+    return(0);
+  if(colon==p) // no host means the node that replied
+    *nodep=findNode(rcl,rcl->nodes[fromNode].host,strlen(rcl->nodes[fromNode].host),atoi(colon+1));
+  else
+    *nodep=findNode(rcl,p,colon-p,atoi(colon+1));
+  return(*nodep<0?0:kind);
+}
+
+// sends a command that has at most one slot to the node serving it, following redirections
+static RESPROTO *
+clusterCommand(RESPCLUSTER *rcl,int slot,int argc,const char **argv,const size_t *argvlen)
+{
+  RESPCLIENT *rcp;
+  RESPROTO   *rpp;
+  int node,ask=-1,tries,kind,movedSlot,target;
+
+  for(tries=0;;tries++)
+  {
+    node=ask>-1?ask:slot<0?anyNode(rcl):rcl->slots[slot];
+    if(node<0)
+    {
+      rcl->reply->errorMsg="No cluster node is known to serve the key's slot";
+      return(NULL);
+    }
+    if(!(rcp=nodeClient(rcl,node)))
+    {
+      rcl->reply->errorMsg="Could not connect to a cluster node";
+      return(NULL);
+    }
+    rpp=NULL;
+    if((ask<0 || sendRespCommand(rcp,"ASKING")) && postRespCommandArgv(rcp,argc,argv,argvlen))
+      rpp=getRespReply(rcp);
+    if(!rpp)
+    {
+      rcl->reply->errorMsg=rcp->rppFrom->errorMsg;
+      rcl->stale=1;
+      return(NULL);
+    }
+
+    kind=redirectOf(rcl,&rpp->items[0],node,&movedSlot,&target);
+    if(!kind || tries>=RESPCLUSTERREDIRECTS) // after too many the last error is the reply
+      return(rpp);
+    if(kind==CLUSTERMOVED)
+    {
+      rcl->slots[movedSlot]=(int16_t)target;
+      if(slot>-1)
+        rcl->stale=1;
+      else // a command whose key wasn't found was guessed at, not sent by a wrong map
+        slot=movedSlot;
+      ask=-1;
+    }
+    else
+    if(kind==CLUSTERASK)
+      ask=target;
+    else
+      usleep(RESPCLUSTERRETRYMS*1000);
+  }
+}
+
+
+// makes room for a split command of argc arguments and nKeys keys
+static int
+growClusterScratch(RESPCLUSTER *rcl,int argc,int nKeys)
+{
+  if(argc>rcl->maxArgv)
+  {
+    const char **newArgv=ramisRealloc(rcl->argv,argc*sizeof(char *));
+    size_t *newArgvlen;
+
+    if(!newArgv)
+      return(RAMISFAIL);
+    rcl->argv=newArgv;
+    if(!(newArgvlen=ramisRealloc(rcl->argvlen,argc*sizeof(size_t))))
+      return(RAMISFAIL);
+    rcl->argvlen=newArgvlen;
+    rcl->maxArgv=argc;
+  }
+  if(nKeys>rcl->maxKeys)
+  {
+    int *newInts;
+    size_t *newValues;
+    uint64_t *newOrder;
+    RESPCLUSTERPART *newParts;
+
+    if(!(newInts=ramisRealloc(rcl->keySlot,nKeys*sizeof(int))))
+      return(RAMISFAIL);
+    rcl->keySlot=newInts;
+    if(!(newInts=ramisRealloc(rcl->keyAsk,nKeys*sizeof(int))))
+      return(RAMISFAIL);
+    rcl->keyAsk=newInts;
+    if(!(newInts=ramisRealloc(rcl->keyDone,nKeys*sizeof(int))))
+      return(RAMISFAIL);
+    rcl->keyDone=newInts;
+    if(!(newValues=ramisRealloc(rcl->keyValue,nKeys*sizeof(size_t))))
+      return(RAMISFAIL);
+    rcl->keyValue=newValues;
+    if(!(newOrder=ramisRealloc(rcl->order,nKeys*sizeof(uint64_t))))
+      return(RAMISFAIL);
+    rcl->order=newOrder;
+    if(!(newParts=ramisRealloc(rcl->parts,nKeys*sizeof(RESPCLUSTERPART))))
+      return(RAMISFAIL);
+    rcl->parts=newParts;
+    rcl->maxKeys=rcl->maxParts=nKeys;
+  }
+  if(nKeys+1>rcl->reply->maxItems)
+  {
+    RESPITEM *newItems=ramisRealloc(rcl->reply->items,(nKeys+1)*sizeof(RESPITEM));
+
+    if(!newItems)
+      return(RAMISFAIL);
+    rcl->reply->items=newItems;
+    rcl->reply->maxItems=nKeys+1;
+  }
+  return(RAMISOK);
+}
+
+// copies len bytes and a '\0' into the arena, returns where or SIZE_MAX on failure
+static size_t
+arenaCopy(RESPCLUSTER *rcl,const byte *p,size_t len)
+{
+  size_t at=rcl->arenaUsed;
+
+  if(at+len+1>rcl->arenaSize)
+  {
+    size_t newSize=rcl->arenaSize?rcl->arenaSize:RESPCLIENTBUFSZ;
+    byte  *newArena;
+
+    while(newSize<at+len+1)
+      newSize*=2;
+    if(!(newArena=ramisRealloc(rcl->arena,newSize)))
+      return(SIZE_MAX);
+    rcl->arena=newArena;
+    rcl->arenaSize=newSize;
+  }
+  memcpy(rcl->arena+at,p,len);
+  rcl->arena[at+len]='\0';
+  rcl->arenaUsed+=len+1;
+  return(at);
+}
+
+// the key a position in order[] stands for
+#define orderKey(rcl,j) ((int)((rcl)->order[j]&0xffffffff))
+
+// groups the keys that aren't done into one part per slot, sorted so each node's parts are
+// together. Returns the number of parts or -1 if a slot has no node
+static int
+makeParts(RESPCLUSTER *rcl,int nKeys)
+{
+  int i,n=0,nParts=0,node;
+
+  for(i=0;i<nKeys;i++)
+  {
+    if(rcl->keyDone[i])
+      continue;
+    node=rcl->keyAsk[i]>-1?rcl->keyAsk[i]:rcl->slots[rcl->keySlot[i]];
+    if(node<0)
+      return(-1);
+    rcl->order[n++]=((uint64_t)node<<47)|((uint64_t)(rcl->keyAsk[i]>-1)<<46)|((uint64_t)rcl->keySlot[i]<<32)|(uint64_t)i;
+  }
+  qsort(rcl->order,n,sizeof(uint64_t),compareOrder);
+  for(i=0;i<n;i++)
+  {
+    if(!i || rcl->order[i]>>32!=rcl->order[i-1]>>32)
+    {
+      rcl->parts[nParts].node=(int)(rcl->order[i]>>47);
+      rcl->parts[nParts].asking=(int)(rcl->order[i]>>46)&1;
+      rcl->parts[nParts].first=i;
+      rcl->parts[nParts].nKeys=0;
+      rcl->parts[nParts++].posted=0;
+    }
+    rcl->parts[nParts-1].nKeys++;
+  }
+  return(nParts);
+}
+
+static int
+postPart(RESPCLUSTER *rcl,RESPCLUSTERPART *part,const CLUSTERSPLIT *split,const char **argv,const size_t *argvlen)
+{
+  RESPCLIENT *rcp=nodeClient(rcl,part->node);
+  const char *asking="ASKING";
+  int n=1,k,j,key;
+
+  if(!rcp)
+    return(RAMISFAIL);
+  rcl->argv[0]=argv[0];
+  rcl->argvlen[0]=argLength(argv,argvlen,0);
+  for(k=0;k<part->nKeys;k++)
+  {
+    key=orderKey(rcl,part->first+k);
+    for(j=1+key*split->step;j<1+(key+1)*split->step;j++)
+    {
+      rcl->argv[n]=argv[j];
+      rcl->argvlen[n++]=argLength(argv,argvlen,j);
+    }
+  }
+  if(part->asking && !postRespCommandArgv(rcp,1,&asking,NULL))
+    return(RAMISFAIL);
+  if(!postRespCommandArgv(rcp,n,rcl->argv,rcl->argvlen))
+    return(RAMISFAIL);
+  part->posted=1;
+  return(RAMISOK);
+}
+
+// takes one part's reply. Redirected keys are left to be sent again, any other reply finishes them.
+// An error reply is copied and *errorAt set to where
+static int
+takePartReply(RESPCLUSTER *rcl,RESPCLUSTERPART *part,const CLUSTERSPLIT *split,RESPITEM *item,size_t *errorAt,int *tryAgain)
+{
+  RESPITEM *reply=rcl->reply->items;
+  int k,key,kind,movedSlot,target;
+
+  if((kind=redirectOf(rcl,item,part->node,&movedSlot,&target)))
+  {
+    for(k=0;k<part->nKeys;k++)
+      rcl->keyAsk[orderKey(rcl,part->first+k)]=kind==CLUSTERASK?target:-1;
+    if(kind==CLUSTERMOVED)
+    {
+      rcl->slots[movedSlot]=(int16_t)target;
+      rcl->stale=1;
+    }
+    *tryAgain|=kind==CLUSTERTRYAGAIN;
+    return(RAMISOK);
+  }
+
+  if(item->respType==RESPISERRORMSG)
+  {
+    if(*errorAt==SIZE_MAX)
+    {
+      if((*errorAt=arenaCopy(rcl,item->loc,item->length))==SIZE_MAX)
+        return(RAMISFAIL);
+      reply[0]=*item;
+    }
+  }
+  else
+  if(split->merge==CLUSTERMERGEARRAY)
+  {
+    if(item->respType!=RESPISARRAY || item->nItems!=(uint64_t)part->nKeys)
+    {
+      rcl->reply->errorMsg="A node returned the wrong number of values in respClusterCommandArgv()";
+      return(RAMISFAIL);
+    }
+    for(k=0;k<part->nKeys;k++)
+    {
+      key=orderKey(rcl,part->first+k);
+      reply[key+1]=item[k+1];
+      rcl->keyValue[key]=SIZE_MAX;
+      if((item[k+1].respType==RESPISBULKSTR || item[k+1].respType==RESPISSTR) &&
+         (rcl->keyValue[key]=arenaCopy(rcl,item[k+1].loc,item[k+1].length))==SIZE_MAX)
+        return(RAMISFAIL);
+    }
+  }
+  else
+  if(split->merge==CLUSTERMERGESUM)
+    reply[0].rinteger+=item->rinteger;
+
+  for(k=0;k<part->nKeys;k++)
+    rcl->keyDone[orderKey(rcl,part->first+k)]=1;
+  return(RAMISOK);
+}
+
+// posts each node its parts, then reads every node's replies together
+static int
+sendParts(RESPCLUSTER *rcl,int nParts,const CLUSTERSPLIT *split,const char **argv,const size_t *argvlen,size_t *errorAt,int *tryAgain)
+{
+  RESPCLIENT *rcp;
+  RESPROTO *rpp;
+  char *errorMsg=NULL;
+  int   p,q,i,nReplies,at,span;
+
+  for(p=0;p<nParts;p++)
+    if(!postPart(rcl,&rcl->parts[p],split,argv,argvlen))
+    {
+      errorMsg="Could not send to a cluster node";
+      rcl->stale=1;
+    }
+
+  // every posted reply is read, even after a failure, to keep the connections in sync
+  for(p=0;p<nParts;p=q)
+  {
+    for(nReplies=0,q=p;q<nParts && rcl->parts[q].node==rcl->parts[p].node;q++)
+      if(rcl->parts[q].posted)
+        nReplies+=1+rcl->parts[q].asking;
+    if(!nReplies)
+      continue;
+    rcp=rcl->nodes[rcl->parts[p].node].rcp;
+    if(!(rpp=getRespReplies(rcp,nReplies)))
+    {
+      errorMsg=rcp->rppFrom->errorMsg;
+      rcl->stale=1;
+      continue;
+    }
+    for(at=0,i=p;i<q;i++)
+    {
+      if(!rcl->parts[i].posted)
+        continue;
+      if(rcl->parts[i].asking) // ASKING's +OK
+        at+=respReplySpan(rpp->items,rpp->nItems,at);
+      if(!(span=respReplySpan(rpp->items,rpp->nItems,at)))
+        break;
+      if(!errorMsg && !takePartReply(rcl,&rcl->parts[i],split,&rpp->items[at],errorAt,tryAgain))
+        errorMsg=rcl->reply->errorMsg?rcl->reply->errorMsg:"Memory allocation error in respClusterCommandArgv()";
+      at+=span;
+    }
+  }
+  rcl->reply->errorMsg=errorMsg;
+  return(errorMsg?RAMISFAIL:RAMISOK);
+}
+
+// splits the command by slot and sends redirected parts again until every key is done
+static RESPROTO *
+splitClusterCommand(RESPCLUSTER *rcl,const CLUSTERSPLIT *split,int argc,const char **argv,const size_t *argvlen)
+{
+  RESPITEM *reply;
+  size_t errorAt=SIZE_MAX;
+  int    nKeys=(argc-1)/split->step;
+  int    i,round,nParts,tryAgain;
+
+  if((argc-1)%split->step || !nKeys)
+  {
+    rcl->reply->errorMsg="Wrong number of arguments in respClusterCommandArgv()";
+    return(NULL);
+  }
+  if(!growClusterScratch(rcl,argc,nKeys))
+  {
+    rcl->reply->errorMsg="Memory allocation error in respClusterCommandArgv()";
+    return(NULL);
+  }
+  reply=rcl->reply->items;
+  reply[0].respType=split->merge==CLUSTERMERGESUM?RESPISINT:split->merge==CLUSTERMERGEOK?RESPISSTR:RESPISARRAY;
+  reply[0].rinteger=0;
+  rcl->arenaUsed=0;
+  for(i=0;i<nKeys;i++)
+  {
+    rcl->keySlot[i]=respClusterSlot(argv[1+i*split->step],argLength(argv,argvlen,1+i*split->step));
+    rcl->keyAsk[i]=-1;
+    rcl->keyDone[i]=0;
+  }
+
+  for(round=0;round<=RESPCLUSTERREDIRECTS && errorAt==SIZE_MAX;round++)
+  {
+    if(!(nParts=makeParts(rcl,nKeys)))
+      break;
+    if(nParts<0)
+    {
+      rcl->reply->errorMsg="No cluster node is known to serve a key's slot";
+      return(NULL);
+    }
+    tryAgain=0;
+    if(!sendParts(rcl,nParts,split,argv,argvlen,&errorAt,&tryAgain))
+      return(NULL);
+    if(tryAgain)
+      usleep(RESPCLUSTERRETRYMS*1000);
+  }
+
+  rcl->reply->nItems=1;
+  if(errorAt!=SIZE_MAX) // an error from any node is the answer
+  {
+    reply[0].loc=rcl->arena+errorAt;
+    return(rcl->reply);
+  }
+  for(i=0;i<nKeys;i++)
+    if(!rcl->keyDone[i])
+    {
+      rcl->reply->errorMsg="Too many cluster redirections in respClusterCommandArgv()";
+      return(NULL);
+    }
+
+  switch(split->merge)
+  {
+    case CLUSTERMERGEARRAY:
+    {
+      reply[0].nItems=nKeys;
+      reply[0].loc=NULL;
+      for(i=0;i<nKeys;i++)
+        if(rcl->keyValue[i]!=SIZE_MAX)
+          reply[i+1].loc=rcl->arena+rcl->keyValue[i];
+      rcl->reply->nItems=nKeys+1;
+    } break;
+    case CLUSTERMERGEOK:
+    {
+      reply[0].loc=(byte *)"OK";
+      reply[0].length=2;
+    } break;
+    case CLUSTERMERGESUM:
+      reply[0].loc=NULL;
+      break;
+  }
+  return(rcl->reply);
+}
+
+RESPROTO *
+respClusterCommandArgv(RESPCLUSTER *rcl,int argc,const char **argv,const size_t *argvlen)
+{
+  const CLUSTERSPLIT *split;
+  RAMISCMD *cmd;
+  size_t    len;
+  int       keyIndex;
+
+  if(argc<1)
+  {
+    rcl->reply->errorMsg="No command given to respClusterCommandArgv()";
+    return(NULL);
+  }
+  if(rcl->stale)
+    respClusterRefresh(rcl); // keeps the map it has if no node answers
+  rcl->reply->errorMsg=NULL;
+
+  // keys in different slots can't be in one command even when the same node serves them
+  len=argLength(argv,argvlen,0);
+  for(split=splitCommands;split->command;split++)
+    if(strlen(split->command)==len && !strncasecmp(argv[0],split->command,len))
+      return(splitClusterCommand(rcl,split,argc,argv,argvlen));
+
+  // the command table says where the key is, or numkeys or STREAMS when it moves. Commands
+  // without keys go to any node
+  cmd=ramisFindCommand(argv[0],len);
+  keyIndex=cmd?respCommandFirstKey(cmd,argc,argv,argvlen):1;
+  if(keyIndex>0 && keyIndex<argc)
+    return(clusterCommand(rcl,respClusterSlot(argv[keyIndex],argLength(argv,argvlen,keyIndex)),argc,argv,argvlen));
+  return(clusterCommand(rcl,-1,argc,argv,argvlen));
+}
@@ -0,0 +1,89 @@
+//
+//  resp_cluster.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A Redis Cluster client. Keys are hashed to one of 16384 slots with CRC16 and the slot map
+//  from CLUSTER SLOTS (or CLUSTER SHARDS) says which node serves each slot, so commands go
+//  straight to the right node. MOVED replies update the map and ASK replies are followed
+//  with ASKING while a slot is being migrated. MGET, MSET and DEL style commands are split
+//  by slot and sent to all the nodes involved before any reply is read.
+//
+
+#ifndef resp_cluster_h
+#define resp_cluster_h
+#include "respClient.h"
+
+#define RESPCLUSTERSLOTS      16384
+#define RESPCLUSTERREDIRECTS     5  // MOVED, ASK and TRYAGAIN replies followed before giving up
+#define RESPCLUSTERRETRYMS      50  // wait after a TRYAGAIN
+#define RESPCLUSTERMAXNODES   1000
+
+#define RESPCLUSTERNODE struct respClusterNodeStruct
+RESPCLUSTERNODE
+{
+  char       *host;
+  int         port;
+  RESPCLIENT *rcp;        // connected the first time it's needed
+};
+
+// one slot's share of a split command, sent to one node
+#define RESPCLUSTERPART struct respClusterPartStruct
+RESPCLUSTERPART
+{
+  int node;
+  int asking;             // ASKING is sent before it
+  int first;              // its keys are order[first..first+nKeys-1]
+  int nKeys;
+  int posted;             // it was sent and its reply has to be read
+};
+
+#define RESPCLUSTER struct respClusterStruct
+RESPCLUSTER
+{
+  RESPCLUSTERNODE *nodes;
+  int              nNodes;
+  int              maxNodes;
+  int16_t         *slots;      // node serving each slot, -1 if none is known
+  int              stale;      // a MOVED or lost connection was seen, refresh before the next command
+  RESPROTO        *reply;      // split command replies put back together, errorMsg is set on failures
+
+  // scratch for split commands
+  int             *keySlot;
+  int             *keyAsk;     // node an ASK sent the key to, -1 if none
+  int             *keyDone;
+  size_t          *keyValue;   // where the key's value was copied in the arena, SIZE_MAX if it wasn't
+  uint64_t        *order;      // pending keys sorted by node, ASKING, slot
+  int              maxKeys;
+  RESPCLUSTERPART *parts;
+  int              maxParts;
+  const char     **argv;
+  size_t          *argvlen;
+  int              maxArgv;
+  byte            *arena;      // copies of values from the nodes' replies
+  size_t           arenaSize;
+  size_t           arenaUsed;
+};
+
+// connects to the first of the seed nodes that answers and loads the slot map from it.
+// hostnames need not stay valid
+RESPCLUSTER * respClusterOpen(int nSeeds,char **hostnames,int *ports);
+
+RESPCLUSTER * respClusterClose(RESPCLUSTER *rcl);
+
+// the hash slot of a key. Only the part between the first { and the } after it is hashed if that's
+// not empty, so user:{42}:name and user:{42}:email are in the same slot
+int respClusterSlot(const char *key,size_t keyLen);
+
+// reloads the slot map from any node that answers
+int respClusterRefresh(RESPCLUSTER *rcl);
+
+// the connection to the node that serves key, for use with sendRespCommand(). NULL if it can't connect
+RESPCLIENT * respClusterClient(RESPCLUSTER *rcl,const char *key);
+
+// sends a command to the node serving its first key, following redirections. MGET, MSET, DEL, UNLINK,
+// EXISTS and TOUCH are split by slot. Returns NULL with rcl->reply->errorMsg set on failure
+RESPROTO * respClusterCommandArgv(RESPCLUSTER *rcl,int argc,const char **argv,const size_t *argvlen);
+
+#endif /* resp_cluster_h */
@@ -0,0 +1,258 @@
+//
+//  resp_coalesce.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The lock is held only to look up, add and remove flights, never while talking to the
+//  server. Each flight has its own condition so finishing one wakes only its waiters. The
+//  thread that sends keeps its encoded command in its client's toBuf until the flight is
+//  removed, so waiters compare against it rather than a copy. A waiter's error message is
+//  copied to a buffer of its thread's own, as the flight is gone once the last waiter leaves.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_coalesce.h"
+
+static _Thread_local char waiterError[RESPCOALESCEERRSZ];
+
+RESPCOALESCER *
+freeRespCoalescer(RESPCOALESCER *rco)
+{
+  if(rco)
+  {
+    pthread_mutex_destroy(&rco->lock);
+    ramisFree(rco);
+  }
+  return(NULL);
+}
+
+RESPCOALESCER *
+newRespCoalescer(void)
+{
+  RESPCOALESCER *rco=ramisCalloc(1,sizeof(RESPCOALESCER));
+
+  if(!rco)
+    return(NULL);
+  if(pthread_mutex_init(&rco->lock,NULL))
+  {
+    ramisFree(rco);
+    return(NULL);
+  }
+  return(rco);
+}
+
+int
+respCoalesceClient(RESPCLIENT *rcp,int db)
+{
+  RESPROTO *rpp;
+
+  if(rcp->pendUsed)
+  {
+    rcp->rppFrom->errorMsg="A client with queued commands can't be readied in respCoalesceClient()";
+    return(RAMISFAIL);
+  }
+  if(!(rpp=sendRespCommand(rcp,"SELECT %d",db)))
+    return(RAMISFAIL);
+  if(!rpp->nItems || rpp->items[0].respType!=RESPISSTR || rpp->items[0].length!=2 ||
+     memcmp(rpp->items[0].loc,"OK",2)) // +QUEUED in a transaction, or an error
+  {
+    rpp->errorMsg="SELECT failed or was queued in a transaction in respCoalesceClient()";
+    return(RAMISFAIL);
+  }
+  rcp->db=db;
+  rcp->inMulti=0;
+  rcp->trackSession=1;
+  return(RAMISOK);
+}
+
+// FNV-1a of the command, the port and the database
+static uint64_t
+commandHash(const byte *p,size_t len,int port,int db)
+{
+  uint64_t h=14695981039346656037ULL;
+
+  while(len--)
+  {
+    h^=*p++;
+    h*=1099511628211ULL;
+  }
+  h^=(uint64_t)port<<32|(uint32_t)db;
+  h*=1099511628211ULL;
+  return(h);
+}
+
+// read only commands whose reply is the same for everyone sending them at the same time
+static int
+shareable(const byte *cmd,size_t n)
+{
+  const byte *p=cmd,*end=cmd+n;
+  RAMISCMD *ramisCmd;
+  size_t len=0;
+
+  if(n<4 || *p!='*' || !(p=memchr(p,'\n',n)) || ++p>=end || *p!='$')
+    return(0);
+  for(++p;p<end && *p>='0' && *p<='9';p++)
+    len=len*10+(*p-'0');
+  p+=2;
+  if(p+len>end || !(ramisCmd=ramisFindCommand((const char *)p,(unsigned int)len)))
+    return(0);
+  return((ramisCmd->flags&RAMISCMDREADONLY) && !(ramisCmd->flags&(RAMISCMDRANDOM|RAMISCMDBLOCKING)));
+}
+
+static RESPREPLY *
+sendAndDetach(RESPCLIENT *rcp,byte *cmd,size_t n)
+{
+  if(!transmitRespCommand(rcp,cmd,n))
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(NULL);
+  }
+  if(!getRespReply(rcp))
+    return(NULL);
+  return(respDetachReply(rcp));
+}
+
+// waits on the flight if there's one for the same command, otherwise sends it
+static RESPREPLY *
+coalesce(RESPCOALESCER *rco,RESPCLIENT *rcp,byte *cmd,size_t n)
+{
+  RESPFLIGHT *flight,**link;
+  RESPREPLY  *rrp;
+  uint64_t    hash;
+  int         last;
+
+  if(!rcp->trackSession)
+  {
+    rcp->rppFrom->errorMsg="The client wasn't readied with respCoalesceClient()";
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(NULL);
+  }
+  // appended commands would go first and the reply be theirs, in a transaction it'd be +QUEUED
+  if(rcp->pendUsed || rcp->inMulti || !shareable(cmd,n))
+  {
+    pthread_mutex_lock(&rco->lock);
+    rco->nOther++;
+    pthread_mutex_unlock(&rco->lock);
+    return(sendAndDetach(rcp,cmd,n));
+  }
+
+  hash=commandHash(cmd,n,rcp->port,rcp->db);
+  pthread_mutex_lock(&rco->lock);
+  for(flight=rco->flights[hash%RESPCOALESCESLOTS];flight;flight=flight->next)
+    if(flight->hash==hash && flight->cmdLen==n && flight->port==rcp->port && flight->db==rcp->db &&
+       !strcmp(flight->hostname,rcp->hostname) && !memcmp(flight->cmd,cmd,n))
+      break;
+
+  if(flight) // someone is already asking
+  {
+    rco->nShared++;
+    flight->nWaiting++;
+    while(!flight->done)
+      pthread_cond_wait(&flight->doneCond,&rco->lock);
+    rrp=flight->reply;
+    if(!rrp)
+    {
+      strcpy(waiterError,flight->errorMsg);
+      rcp->rppFrom->errorMsg=waiterError;
+    }
+    last=!--flight->nWaiting;
+    pthread_mutex_unlock(&rco->lock);
+    if(last)
+    {
+      pthread_cond_destroy(&flight->doneCond);
+      ramisFree(flight);
+    }
+    if(rcp->trace) // its wait was for another thread's reply
+      respTraceDone(rcp->trace,!rrp);
+    return(rrp);
+  }
+
+  if(!(flight=ramisCalloc(1,sizeof(RESPFLIGHT))) || pthread_cond_init(&flight->doneCond,NULL))
+  {
+    pthread_mutex_unlock(&rco->lock);
+    if(flight)
+      ramisFree(flight);
+    return(sendAndDetach(rcp,cmd,n)); // it just won't be shared
+  }
+  rco->nSent++;
+  flight->hash=hash;
+  flight->cmd=cmd;
+  flight->cmdLen=n;
+  flight->hostname=rcp->hostname;
+  flight->port=rcp->port;
+  flight->db=rcp->db;
+  flight->next=rco->flights[hash%RESPCOALESCESLOTS];
+  rco->flights[hash%RESPCOALESCESLOTS]=flight;
+  pthread_mutex_unlock(&rco->lock);
+
+  rrp=sendAndDetach(rcp,cmd,n);
+
+  pthread_mutex_lock(&rco->lock);
+  for(link=&rco->flights[hash%RESPCOALESCESLOTS];*link!=flight;link=&(*link)->next);
+  *link=flight->next;
+  flight->done=1;
+  flight->reply=rrp;
+  if(!rrp)
+    snprintf(flight->errorMsg,sizeof(flight->errorMsg),"%s",
+             rcp->rppFrom->errorMsg?rcp->rppFrom->errorMsg:"The coalesced command failed");
+  if(rrp)
+    atomic_fetch_add_explicit(&rrp->refCount,flight->nWaiting,memory_order_relaxed);
+  last=!flight->nWaiting;
+  if(!last)
+    pthread_cond_broadcast(&flight->doneCond);
+  pthread_mutex_unlock(&rco->lock);
+  if(last)
+  {
+    pthread_cond_destroy(&flight->doneCond);
+    ramisFree(flight);
+  }
+  return(rrp);
+}
+
+// encodes a command like sendRespCommand() and sends it, or waits on the same one another thread sent
+RESPREPLY *
+respCoalescedCommand(RESPCOALESCER *rco,RESPCLIENT *rcp,char *fmt,...)
+{
+  va_list  arg;
+  ssize_t  n;
+  uint64_t t0=0;
+
+  rcp->rppFrom->errorMsg=NULL;
+  if(rcp->trace)
+    t0=respTraceNow();
+  va_start(arg,fmt);
+  n=appendRespCommandV(rcp,&rcp->toBuf,&rcp->toBufSz,0,fmt,&arg);
+  va_end(arg);
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACEENCODE,t0);
+  if(n<0)
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    return(NULL);
+  }
+  return(coalesce(rco,rcp,rcp->toBuf,n));
+}
+
+RESPREPLY *
+respCoalescedCommandArgv(RESPCOALESCER *rco,RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen)
+{
+  ssize_t n;
+
+  rcp->rppFrom->errorMsg=NULL;
+  if((n=respEncodeArgv(&rcp->toBuf,&rcp->toBufSz,0,argc,argv,argvlen))<0)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respCoalescedCommandArgv()";
+    return(NULL);
+  }
+  return(coalesce(rco,rcp,rcp->toBuf,n));
+}
@@ -0,0 +1,67 @@
+//
+//  resp_coalesce.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Single flight for read only commands. Threads that each have their own client share a
+//  coalescer, and when one of them sends a command that another is already waiting on, it
+//  waits for that reply instead of sending its own. The first thread's reply is detached and
+//  shared by everyone who waited on it, so a key that hundreds of threads GET as it expires
+//  costs the server one GET. Commands are matched by their encoded bytes.
+//
+
+#ifndef resp_coalesce_h
+#define resp_coalesce_h
+#include <stdint.h>
+#include <pthread.h>
+#include "respClient.h"
+
+#define RESPCOALESCESLOTS  256 // hash chains of requests in flight
+#define RESPCOALESCEERRSZ  128 // room for a failed flight's error message
+
+#define RESPFLIGHT struct respFlightStruct
+RESPFLIGHT
+{
+  uint64_t        hash;
+  const byte     *cmd;       // the encoded command, in the sending thread's client
+  size_t          cmdLen;
+  const char     *hostname;  // and where it went, the same bytes to another server or database differ
+  int             port;
+  int             db;
+  int             nWaiting;  // threads waiting on the reply, the last one out frees this
+  int             done;
+  RESPREPLY      *reply;     // with a reference for each waiting thread, NULL if it failed
+  char            errorMsg[RESPCOALESCEERRSZ]; // why it failed, copied as it may be strerror()'s
+  pthread_cond_t  doneCond;
+  RESPFLIGHT     *next;      // hash chain
+};
+
+#define RESPCOALESCER struct respCoalescerStruct
+RESPCOALESCER
+{
+  pthread_mutex_t lock;
+  RESPFLIGHT     *flights[RESPCOALESCESLOTS];
+  uint64_t        nSent;     // read only commands that went to the server
+  uint64_t        nShared;   // and the ones that waited on one of those instead
+  uint64_t        nOther;    // commands that can't be shared, sent as they are
+};
+
+RESPCOALESCER * newRespCoalescer(void);
+
+// there can't be threads still using it
+RESPCOALESCER * freeRespCoalescer(RESPCOALESCER *rco);
+
+// readies a client for coalescing. It's SELECTed to db, and from then on the database it's in and
+// whether it's in a transaction are followed. Fails if it has commands queued or is in a transaction
+int respCoalesceClient(RESPCLIENT *rcp,int db);
+
+// sends a command like sendRespCommand() on the calling thread's client, unless the same read only
+// command is already in flight on another to the same server and database. Either way the reply is
+// detached, free it with freeRespReply(). The client must have been readied with respCoalesceClient()
+RESPREPLY * respCoalescedCommand(RESPCOALESCER *rco,RESPCLIENT *rcp,char *fmt,...);
+
+// the same for an argument vector like sendRespCommandArgv()
+RESPREPLY * respCoalescedCommandArgv(RESPCOALESCER *rco,RESPCLIENT *rcp,int argc,const char **argv,const size_t *argvlen);
+
+#endif /* resp_coalesce_h */
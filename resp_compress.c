@@ -0,0 +1,362 @@
+//
+//  resp_compress.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The block format is LZ4's: a token byte holding a 4 bit literal length and a 4 bit
+//  match length (minus LZMINMATCH), 255 continuation bytes for lengths of 15 or more,
+//  the literals, then a 2 byte little endian match offset. The last sequence is literals only.
+//  The compressor is greedy with a single probe hash table, which is plenty for JSON.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "resp_compress.h"
+
+#define LZMINMATCH      4
+#define LZLASTLITERALS  5      // matches stop this far from the end
+#define LZMAXOFFSET     65535
+#define LZSKIPSHIFT     6      // how quickly to skip ahead through data that isn't matching
+
+
+/* ********************************** codec ********************************* */
+
+static inline uint32_t
+lzRead32(const byte *p)
+{
+  uint32_t v;
+  memcpy(&v,p,sizeof(v));
+  return(v);
+}
+
+static inline uint32_t
+lzHash(uint32_t v)
+{
+  return((v*2654435761U)>>(32-RESPLZHASHBITS));
+}
+
+// writes the part of a length that didn't fit in the token's nibble
+static byte *
+lzPutLength(byte *op,size_t len)
+{
+  while(len>=255)
+  {
+    *op++=255;
+    len-=255;
+  }
+  *op++=(byte)len;
+  return(op);
+}
+
+// adds len to *lenp from the continuation bytes at *ipp
+static int
+lzGetLength(const byte **ipp,const byte *iend,size_t *lenp)
+{
+  const byte *ip=*ipp;
+  byte b;
+
+  do
+  {
+    if(ip>=iend)
+      return(RAMISFAIL);
+    b=*ip++;
+    *lenp+=b;
+  } while(b==255);
+  *ipp=ip;
+  return(RAMISOK);
+}
+
+// writes one sequence, a matchLen of 0 is the trailing literals only sequence
+static byte *
+lzPutSequence(byte *op,const byte *lit,size_t litLen,size_t offset,size_t matchLen)
+{
+  byte  *token=op++;
+  size_t ml=matchLen?matchLen-LZMINMATCH:0;
+
+  *token=(byte)((litLen>=15?15:litLen)<<4 | (ml>=15?15:ml));
+  if(litLen>=15)
+    op=lzPutLength(op,litLen-15);
+  memcpy(op,lit,litLen);
+  op+=litLen;
+  if(matchLen)
+  {
+    *op++=(byte)offset;
+    *op++=(byte)(offset>>8);
+    if(ml>=15)
+      op=lzPutLength(op,ml-15);
+  }
+  return(op);
+}
+
+size_t
+respLzBound(size_t n)
+{
+  return(n+n/255+16);
+}
+
+// n must fit in 32 bits because the match finder stores positions that way
+size_t
+respLzCompress(const byte *src,size_t n,byte *dst)
+{
+  uint32_t    table[1<<RESPLZHASHBITS];
+  const byte *ip=src;
+  const byte *anchor=src;
+  const byte *end=src+n;
+  byte       *op=dst;
+
+  if(n>LZLASTLITERALS+LZMINMATCH)
+  {
+    const byte *matchLimit=end-LZLASTLITERALS;
+
+    memset(table,0,sizeof(table));
+    while(ip+LZMINMATCH<=matchLimit)
+    {
+      uint32_t    seq=lzRead32(ip);
+      uint32_t    h=lzHash(seq);
+      const byte *ref=src+table[h];
+
+      table[h]=(uint32_t)(ip-src);
+      if(ref<ip && ip-ref<=LZMAXOFFSET && lzRead32(ref)==seq)
+      {
+        size_t len=LZMINMATCH;
+
+        while(ip+len<matchLimit && ref[len]==ip[len])
+          ++len;
+        op=lzPutSequence(op,anchor,ip-anchor,ip-ref,len);
+        ip+=len;
+        anchor=ip;
+      }
+      else
+        ip+=1+((ip-anchor)>>LZSKIPSHIFT);
+    }
+  }
+  op=lzPutSequence(op,anchor,end-anchor,0,0);
+  return(op-dst);
+}
+
+ssize_t
+respLzDecompress(const byte *src,size_t n,byte *dst,size_t dstCap)
+{
+  const byte *ip=src;
+  const byte *iend=src+n;
+  byte       *op=dst;
+  byte       *oend=dst+dstCap;
+
+  while(ip<iend)
+  {
+    byte   token=*ip++;
+    size_t litLen=token>>4;
+    size_t matchLen=token&15;
+    size_t offset;
+    byte  *ref;
+
+    if(litLen==15 && !lzGetLength(&ip,iend,&litLen))
+      return(-1);
+    if((size_t)(iend-ip)<litLen || (size_t)(oend-op)<litLen)
+      return(-1);
+    memcpy(op,ip,litLen);
+    op+=litLen;
+    ip+=litLen;
+    if(ip==iend) // the last sequence has no match
+      break;
+
+    if(iend-ip<2)
+      return(-1);
+    offset=ip[0]|(size_t)ip[1]<<8;
+    ip+=2;
+    if(!offset || offset>(size_t)(op-dst))
+      return(-1);
+    if(matchLen==15 && !lzGetLength(&ip,iend,&matchLen))
+      return(-1);
+    matchLen+=LZMINMATCH;
+    if((size_t)(oend-op)<matchLen)
+      return(-1);
+
+    ref=op-offset;
+    if(offset>=matchLen)
+    {
+      memcpy(op,ref,matchLen);
+      op+=matchLen;
+    }
+    else // overlapping copies repeat the last offset bytes
+      while(matchLen--)
+        *op++=*ref++;
+  }
+  return(op-dst);
+}
+
+
+/* ********************************** client ******************************** */
+
+RESPCODEC *
+freeRespCodec(RESPCODEC *codec)
+{
+  if(codec)
+  {
+    if(codec->packArena)
+      ramisFree(codec->packArena);
+    if(codec->packed)
+      ramisFree(codec->packed);
+    if(codec->unpackArena)
+      ramisFree(codec->unpackArena);
+    ramisFree(codec);
+  }
+  return(NULL);
+}
+
+RESPCODEC *
+newRespCodec(size_t threshold)
+{
+  RESPCODEC *codec=ramisCalloc(1,sizeof(RESPCODEC));
+
+  if(codec)
+    codec->threshold=threshold;
+  return(codec);
+}
+
+void
+respCodecResetPack(RESPCODEC *codec)
+{
+  codec->nPacked=0;
+  codec->nextPacked=0;
+  codec->packArenaUsed=0;
+}
+
+int
+respCodecPack(RESPCODEC *codec,const byte *value,size_t len,size_t *wireLen)
+{
+  RESPCODECPACKED *pk;
+  byte   *out;
+  size_t  need,packedLen;
+
+  if(codec->nPacked==codec->maxPacked)
+  {
+    int newMax=codec->maxPacked?codec->maxPacked*2:8;
+    RESPCODECPACKED *newPacked=ramisRealloc(codec->packed,newMax*sizeof(RESPCODECPACKED));
+    if(!newPacked)
+      return(RAMISFAIL);
+    codec->packed=newPacked;
+    codec->maxPacked=newMax;
+  }
+  pk=&codec->packed[codec->nPacked++];
+  pk->length=0;
+  *wireLen=len;
+
+  if(len<codec->threshold || len>UINT32_MAX)
+    return(RAMISOK);
+
+  need=codec->packArenaUsed+RESPCODECHEADERLEN+respLzBound(len);
+  if(need>codec->packArenaSize)
+  {
+    byte *newArena=ramisRealloc(codec->packArena,need);
+    if(!newArena)
+      return(RAMISFAIL);
+    codec->packArena=newArena;
+    codec->packArenaSize=need;
+  }
+
+  out=codec->packArena+codec->packArenaUsed;
+  memcpy(out,RESPCODECMAGIC,RESPCODECMAGICLEN);
+  out[4]=(byte)len;
+  out[5]=(byte)(len>>8);
+  out[6]=(byte)(len>>16);
+  out[7]=(byte)(len>>24);
+  packedLen=RESPCODECHEADERLEN+respLzCompress(value,len,out+RESPCODECHEADERLEN);
+
+  if(packedLen>=len) // incompressible, send it as is
+  {
+    ++codec->nNotWorthIt;
+    return(RAMISOK);
+  }
+
+  pk->offset=codec->packArenaUsed;
+  pk->length=packedLen;
+  codec->packArenaUsed+=packedLen;
+  ++codec->nCompressed;
+  codec->bytesBeforeCompress+=len;
+  codec->bytesAfterCompress+=packedLen;
+  *wireLen=packedLen;
+  return(RAMISOK);
+}
+
+byte *
+respCodecNextPacked(RESPCODEC *codec,size_t *len)
+{
+  RESPCODECPACKED *pk=&codec->packed[codec->nextPacked++];
+
+  if(!pk->length)
+    return(NULL);
+  *len=pk->length;
+  return(codec->packArena+pk->offset);
+}
+
+
+// returns the uncompressed length if the item is a compressed value, 0 if it isn't. The length
+// comes off the network, one the compressed bytes couldn't have come from means it's a plain
+// value that happens to start with the magic
+static size_t
+packedLength(RESPITEM *item)
+{
+  byte  *p=item->loc;
+  size_t len;
+
+  if(item->respType!=RESPISBULKSTR || item->length<=RESPCODECHEADERLEN || memcmp(p,RESPCODECMAGIC,RESPCODECMAGICLEN))
+    return(0);
+  len=(size_t)p[4]|(size_t)p[5]<<8|(size_t)p[6]<<16|(size_t)p[7]<<24;
+  if(len>RESPMAXBULK || len<=item->length-RESPCODECHEADERLEN ||
+     len>(item->length-RESPCODECHEADERLEN)*RESPCODECMAXRATIO)
+    return(0);
+  return(len);
+}
+
+int
+respCodecUnpackReply(RESPCODEC *codec,RESPROTO *rpp)
+{
+  size_t need=0,used=0,len;
+  int    i;
+
+  for(i=0;i<rpp->nItems;i++)
+    if((len=packedLength(&rpp->items[i]))!=0)
+      need+=len+1;
+  if(!need)
+    return(RAMISOK);
+
+  // sized up front so the items already pointed into it don't move
+  if(need>codec->unpackArenaSize)
+  {
+    byte *newArena=ramisRealloc(codec->unpackArena,need);
+    if(!newArena)
+    {
+      rpp->errorMsg="Memory allocation error in respCodecUnpackReply";
+      return(RAMISFAIL);
+    }
+    codec->unpackArena=newArena;
+    codec->unpackArenaSize=need;
+  }
+
+  for(i=0;i<rpp->nItems;i++)
+  {
+    RESPITEM *item=&rpp->items[i];
+    byte     *out=codec->unpackArena+used;
+
+    if(!(len=packedLength(item)))
+      continue;
+    if(respLzDecompress(item->loc+RESPCODECHEADERLEN,item->length-RESPCODECHEADERLEN,out,len)!=(ssize_t)len)
+    {
+      rpp->errorMsg="A compressed value in the reply is corrupt";
+      return(RAMISFAIL);
+    }
+    out[len]='\0';
+    ++codec->nDecompressed;
+    codec->bytesBeforeDecompress+=item->length;
+    codec->bytesAfterDecompress+=len;
+    item->loc=out;
+    item->length=len;
+    used+=len+1;
+  }
+  return(RAMISOK);
+}
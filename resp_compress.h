@@ -0,0 +1,84 @@
+//
+//  resp_compress.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  An opt-in value codec. %b arguments at or above a size threshold are compressed
+//  with a small LZ77 codec (LZ4 style block format) and prefixed with a header.
+//  Bulk string replies that start with the header are decompressed before the
+//  caller sees them.
+//
+
+#ifndef resp_compress_h
+#define resp_compress_h
+#include <stdint.h>
+#include <sys/types.h>
+#include "resp_protocol.h"
+
+#define RESPCODECMAGIC      "\xffRZ1"  // starts every compressed value
+#define RESPCODECMAGICLEN   4
+#define RESPCODECHEADERLEN  8          // magic + 32 bit little endian uncompressed length
+#define RESPCODECDEFTHRESHOLD 1024     // a reasonable threshold if you don't have one in mind
+#define RESPLZHASHBITS      12         // 4096 entry match finder
+#define RESPCODECMAXRATIO   256        // LZ4 style blocks can't expand more than about 255 times
+
+#define RESPCODECPACKED struct respCodecPackedStruct
+RESPCODECPACKED
+{
+  size_t offset;   // where the compressed version is in the pack arena
+  size_t length;   // 0 if it wasn't worth compressing
+};
+
+#define RESPCODEC struct respCodecStruct
+RESPCODEC
+{
+  size_t   threshold;          // compress %b values at least this big
+
+  byte    *packArena;          // compressed versions of the current command's values
+  size_t   packArenaSize;
+  size_t   packArenaUsed;
+  RESPCODECPACKED *packed;     // one per eligible %b in the current command in order
+  int      nPacked;
+  int      maxPacked;
+  int      nextPacked;         // encode pass cursor into packed
+
+  byte    *unpackArena;        // decompressed values of the current reply
+  size_t   unpackArenaSize;
+
+  uint64_t nCompressed;        // values sent compressed
+  uint64_t nNotWorthIt;        // values over the threshold that didn't shrink enough
+  uint64_t bytesBeforeCompress;
+  uint64_t bytesAfterCompress;
+  uint64_t nDecompressed;      // reply values that were decompressed
+  uint64_t bytesBeforeDecompress;
+  uint64_t bytesAfterDecompress;
+};
+
+// the most respLzCompress() can produce from n bytes
+size_t respLzBound(size_t n);
+
+// compresses n bytes of src to dst which must hold respLzBound(n), returns the compressed size
+size_t respLzCompress(const byte *src,size_t n,byte *dst);
+
+// decompresses n bytes of src into dst, returns the decompressed size or -1 if src is corrupt
+// or would not fit in dstCap bytes
+ssize_t respLzDecompress(const byte *src,size_t n,byte *dst,size_t dstCap);
+
+RESPCODEC * newRespCodec(size_t threshold);
+RESPCODEC * freeRespCodec(RESPCODEC *codec);
+
+// forget the previous command's packed values, called before encoding a command
+void respCodecResetPack(RESPCODEC *codec);
+
+// compresses a value for the current command if it's worth it, *wireLen gets the number of
+// bytes the value will occupy on the wire. Returns RAMISFAIL on allocation error
+int respCodecPack(RESPCODEC *codec,const byte *value,size_t len,size_t *wireLen);
+
+// returns the next value packed by respCodecPack() in order, or NULL if it went uncompressed
+byte * respCodecNextPacked(RESPCODEC *codec,size_t *len);
+
+// decompresses every bulk string in the reply that carries the header
+int respCodecUnpackReply(RESPCODEC *codec,RESPROTO *rpp);
+
+#endif /* resp_compress_h */
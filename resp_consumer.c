@@ -0,0 +1,633 @@
+//
+//  resp_consumer.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Each XREADGROUP reply is detached from the reader's client, so its items and buffer become
+//  the batch's and the entries point straight into them. Entries are pushed round robin onto
+//  the workers' lock free queues and the last worker done with a batch frees the reply back
+//  to the client's pool. Workers collect the ids they acknowledge and hand them over under
+//  one lock when their queue runs dry. The ack thread waits up to RESPCONSUMERACKMS for a
+//  batch to fill, then writes all of it as XACKs of up to RESPCONSUMERACKMAX ids in one send.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_consumer.h"
+
+// ids acknowledged by one thread and not yet given to the ack thread, "$len\r\nid\r\n" each
+#define ACKLIST struct ackListStruct
+ACKLIST
+{
+  byte   *buf;
+  size_t  size;
+  size_t  used;
+  int     n;
+};
+
+
+/* ********************************* queues ********************************* */
+
+// called by the reader only
+static int
+entryQueuePush(RESPENTRYQUEUE *q,RESPENTRY *entry)
+{
+  size_t tail=atomic_load_explicit(&q->tail,memory_order_relaxed);
+  size_t head=atomic_load_explicit(&q->head,memory_order_acquire);
+
+  if(tail-head==RESPCONSUMERQUEUESZ) // full
+    return(0);
+  q->slots[tail&(RESPCONSUMERQUEUESZ-1)]=entry;
+  atomic_store_explicit(&q->tail,tail+1,memory_order_release);
+  return(1);
+}
+
+// called by the queue's worker only
+static RESPENTRY *
+entryQueuePop(RESPENTRYQUEUE *q)
+{
+  RESPENTRY *entry;
+  size_t head=atomic_load_explicit(&q->head,memory_order_relaxed);
+  size_t tail=atomic_load_explicit(&q->tail,memory_order_acquire);
+
+  if(head==tail) // empty
+    return(NULL);
+  entry=q->slots[head&(RESPCONSUMERQUEUESZ-1)];
+  atomic_store_explicit(&q->head,head+1,memory_order_release);
+  return(entry);
+}
+
+
+/* ********************************* entries ******************************** */
+
+static void
+releaseEntryBatch(RESPENTRYBATCH *batch)
+{
+  if(atomic_fetch_sub_explicit(&batch->refCount,1,memory_order_acq_rel)!=1)
+    return;
+  freeRespReply(batch->reply);
+  ramisFree(batch);
+}
+
+void
+respEntryRetain(RESPENTRY *entry)
+{
+  atomic_fetch_add_explicit(&entry->batch->refCount,1,memory_order_relaxed);
+}
+
+void
+respEntryRelease(RESPENTRY *entry)
+{
+  releaseEntryBatch(entry->batch);
+}
+
+RESPITEM *
+respEntryField(RESPENTRY *entry,const char *name)
+{
+  size_t len=strlen(name);
+  int i;
+
+  for(i=0;i<entry->nFields;i++)
+    if(entry->fields[2*i].length==len && !memcmp(entry->fields[2*i].loc,name,len))
+      return(&entry->fields[2*i+1]);
+  return(NULL);
+}
+
+
+/* ***************************** acknowledgements *************************** */
+
+static int
+addAck(ACKLIST *acks,const byte *id,size_t idLen)
+{
+  size_t need=acks->used+idLen+RESPMAXDIGITS+4;
+
+  if(need>acks->size)
+  {
+    byte *newBuf=ramisRealloc(acks->buf,need*2);
+
+    if(!newBuf)
+      return(RAMISFAIL);
+    acks->buf=newBuf;
+    acks->size=need*2;
+  }
+  acks->used+=sprintf((char *)acks->buf+acks->used,"$%zu\r\n",idLen);
+  memcpy(acks->buf+acks->used,id,idLen);
+  memcpy(acks->buf+acks->used+idLen,"\r\n",2);
+  acks->used+=idLen+2;
+  acks->n++;
+  return(RAMISOK);
+}
+
+// gives the ids to the ack thread. Without memory for them they stay pending and get claimed again
+static void
+flushAcks(RESPCONSUMER *rcs,ACKLIST *acks)
+{
+  int wasEmpty;
+
+  if(!acks->n)
+    return;
+  pthread_mutex_lock(&rcs->ackLock);
+  if(rcs->ackUsed+acks->used>rcs->ackSize)
+  {
+    byte *newBuf=ramisRealloc(rcs->ackBuf,(rcs->ackUsed+acks->used)*2);
+
+    if(!newBuf)
+    {
+      pthread_mutex_unlock(&rcs->ackLock);
+      acks->used=0;
+      acks->n=0;
+      return;
+    }
+    rcs->ackBuf=newBuf;
+    rcs->ackSize=(rcs->ackUsed+acks->used)*2;
+  }
+  memcpy(rcs->ackBuf+rcs->ackUsed,acks->buf,acks->used);
+  rcs->ackUsed+=acks->used;
+  wasEmpty=!rcs->nAcks;
+  rcs->nAcks+=acks->n;
+  if(wasEmpty || rcs->nAcks>=RESPCONSUMERACKBATCH)
+    pthread_cond_signal(&rcs->ackCond);
+  pthread_mutex_unlock(&rcs->ackLock);
+  acks->used=0;
+  acks->n=0;
+}
+
+// writes the n ids in ids as pipelined XACKs and reads their replies
+static void
+sendAcks(RESPCONSUMER *rcs,ACKLIST *out,const byte *ids,size_t idsLen,int n)
+{
+  const byte *p=ids,*end=ids+idsLen,*chunk;
+  size_t streamLen=strlen(rcs->stream),groupLen=strlen(rcs->group),len;
+  RESPROTO *rpp;
+  int nCmds=0,inChunk,i;
+
+  out->used=0;
+  while(p<end)
+  {
+    inChunk=n-nCmds*RESPCONSUMERACKMAX<RESPCONSUMERACKMAX?n-nCmds*RESPCONSUMERACKMAX:RESPCONSUMERACKMAX;
+    for(chunk=p,i=0;i<inChunk;i++)
+    {
+      len=strtoul((const char *)p+1,NULL,10);
+      p=(const byte *)memchr(p,'\n',end-p)+1+len+2;
+    }
+    len=p-chunk;
+    if(out->used+len+streamLen+groupLen+3*RESPMAXDIGITS+32>out->size)
+    {
+      size_t newSize=(out->used+len+streamLen+groupLen+3*RESPMAXDIGITS+32)*2;
+      byte *newBuf=ramisRealloc(out->buf,newSize);
+
+      if(!newBuf)
+        return;
+      out->buf=newBuf;
+      out->size=newSize;
+    }
+    out->used+=sprintf((char *)out->buf+out->used,"*%d\r\n$4\r\nXACK\r\n$%zu\r\n%s\r\n$%zu\r\n%s\r\n",
+                       inChunk+3,streamLen,rcs->stream,groupLen,rcs->group);
+    memcpy(out->buf+out->used,chunk,len);
+    out->used+=len;
+    nCmds++;
+  }
+
+  if(!transmitRespCommand(rcs->ackRcp,out->buf,out->used) || !(rpp=getRespReplies(rcs->ackRcp,nCmds)))
+  { // they stay pending and are claimed again
+    rcs->errorMsg="XACK failed, the entries will be claimed again";
+    reconnectRespServer(rcs->ackRcp);
+    return;
+  }
+  for(i=0;i<rpp->nItems;i++)
+    if(rpp->items[i].respType==RESPISINT)
+      rcs->nAcked+=rpp->items[i].rinteger;
+}
+
+static void *
+consumerAcker(void *arg)
+{
+  RESPCONSUMER   *rcs=arg;
+  ACKLIST         out={0};
+  byte           *ids=NULL,*spare;
+  size_t          idsSize=0,idsUsed,spareSize;
+  int             n;
+  struct timespec until;
+
+  pthread_mutex_lock(&rcs->ackLock);
+  for(;;)
+  {
+    while(!rcs->nAcks && !atomic_load(&rcs->ackStop))
+      pthread_cond_wait(&rcs->ackCond,&rcs->ackLock);
+    if(!rcs->nAcks)
+      break;
+    if(rcs->nAcks<RESPCONSUMERACKBATCH && !atomic_load(&rcs->ackStop)) // give the batch a moment to fill
+    {
+      clock_gettime(CLOCK_REALTIME,&until);
+      until.tv_nsec+=RESPCONSUMERACKMS*1000000L;
+      if(until.tv_nsec>=1000000000L)
+      {
+        until.tv_sec++;
+        until.tv_nsec-=1000000000L;
+      }
+      while(rcs->nAcks<RESPCONSUMERACKBATCH && !atomic_load(&rcs->ackStop) &&
+            pthread_cond_timedwait(&rcs->ackCond,&rcs->ackLock,&until)!=ETIMEDOUT)
+        ;
+    }
+
+    // swap buffers so the workers can go on adding while these are sent
+    spare=ids;
+    spareSize=idsSize;
+    ids=rcs->ackBuf;
+    idsSize=rcs->ackSize;
+    idsUsed=rcs->ackUsed;
+    rcs->ackBuf=spare;
+    rcs->ackSize=spareSize;
+    n=rcs->nAcks;
+    rcs->ackUsed=0;
+    rcs->nAcks=0;
+    pthread_mutex_unlock(&rcs->ackLock);
+    sendAcks(rcs,&out,ids,idsUsed,n);
+    pthread_mutex_lock(&rcs->ackLock);
+  }
+  pthread_mutex_unlock(&rcs->ackLock);
+  if(ids)
+    ramisFree(ids);
+  if(out.buf)
+    ramisFree(out.buf);
+  return(NULL);
+}
+
+
+/* ********************************** reading ******************************* */
+
+// RAMISFAIL if the consumer is stopped while waiting on a full queue
+static int
+pushEntry(RESPCONSUMER *rcs,int w,RESPENTRY *entry)
+{
+  while(!entryQueuePush(&rcs->queues[w],entry))
+  { // the worker is behind, wake it and let it catch up
+    sem_post(&rcs->queues[w].ready);
+    if(atomic_load(&rcs->stop))
+      return(RAMISFAIL);
+    sched_yield();
+  }
+  return(RAMISOK);
+}
+
+// the entries array at items[first] becomes a batch for the workers. The reply is detached
+// from the reader's client, deleted entries (nil fields) are just acknowledged
+static int
+dispatchEntries(RESPCONSUMER *rcs,int first,int claimed,ACKLIST *acks)
+{
+  RESPREPLY      *rrp;
+  RESPITEM       *items;
+  RESPENTRYBATCH *batch;
+  RESPENTRY      *entry;
+  int   i,e,span,nItems,w;
+  int   touched[RESPCONSUMERMAXWORKERS];
+
+  if(!(rrp=respDetachReply(rcs->rcp)))
+  {
+    rcs->errorMsg=rcs->rcp->rppFrom->errorMsg;
+    return(RAMISFAIL);
+  }
+  items=rrp->items;
+  nItems=rrp->nItems;
+  batch=ramisMalloc(sizeof(RESPENTRYBATCH)+items[first].nItems*sizeof(RESPENTRY));
+  if(!batch)
+  {
+    freeRespReply(rrp);
+    rcs->errorMsg="Memory allocation error in the consumer reader";
+    return(RAMISFAIL);
+  }
+  atomic_store_explicit(&batch->refCount,1,memory_order_relaxed); // the reader's
+  batch->reply=rrp;
+  batch->entries=(RESPENTRY *)(batch+1);
+  batch->nEntries=0;
+
+  // each entry is *2 $id *2k fields... or *2 $id nil
+  for(e=0,i=first+1;e<(int)items[first].nItems && i<nItems;e++,i+=span)
+  {
+    if(!(span=respReplySpan(items,nItems,i)))
+      break;
+    if(items[i].respType!=RESPISARRAY || items[i].nItems!=2 || items[i+1].respType!=RESPISBULKSTR)
+      continue;
+    if(items[i+2].respType!=RESPISARRAY)
+    {
+      addAck(acks,items[i+1].loc,items[i+1].length);
+      continue;
+    }
+    entry=&batch->entries[batch->nEntries++];
+    entry->id=items[i+1].loc;
+    entry->idLen=items[i+1].length;
+    entry->fields=&items[i+3];
+    entry->nFields=(int)(items[i+2].nItems/2);
+    entry->claimed=claimed;
+    entry->batch=batch;
+  }
+
+  memset(touched,0,sizeof(int)*rcs->nWorkers);
+  for(e=0,entry=batch->entries;e<batch->nEntries;e++,entry++)
+  {
+    w=rcs->nextWorker;
+    rcs->nextWorker=(w+1)%rcs->nWorkers;
+    atomic_fetch_add_explicit(&batch->refCount,1,memory_order_relaxed);
+    if(!pushEntry(rcs,w,entry))
+    {
+      releaseEntryBatch(batch); // this entry's, it and the rest stay pending
+      break;
+    }
+    touched[w]=1;
+    ++rcs->nEntries;
+    rcs->nClaimed+=claimed;
+  }
+  for(w=0;w<rcs->nWorkers;w++) // one wakeup per worker per reply
+    if(touched[w])
+      sem_post(&rcs->queues[w].ready);
+  releaseEntryBatch(batch);
+  return(RAMISOK);
+}
+
+static int
+isError(RESPROTO *rpp,const char *prefix)
+{
+  size_t len=strlen(prefix);
+
+  return(rpp->nItems && rpp->items[0].respType==RESPISERRORMSG &&
+         rpp->items[0].length>=len && !memcmp(rpp->items[0].loc,prefix,len));
+}
+
+static int
+createGroup(RESPCONSUMER *rcs)
+{
+  RESPROTO *rpp=sendRespCommand(rcs->rcp,"XGROUP CREATE %s %s $ MKSTREAM",rcs->stream,rcs->group);
+
+  if(!rpp)
+    return(RAMISFAIL);
+  if(isError(rpp,"BUSYGROUP")) // it's already there
+    return(RAMISOK);
+  if(isError(rpp,""))
+  {
+    rcs->errorMsg="XGROUP CREATE failed";
+    return(RAMISFAIL);
+  }
+  return(RAMISOK);
+}
+
+// takes back entries that have been pending longer than claimIdleMs, from any consumer
+static void
+claimPending(RESPCONSUMER *rcs,ACKLIST *acks)
+{
+  RESPROTO *rpp;
+  RESPITEM *items;
+  size_t    len;
+
+  strcpy(rcs->claimStart,"0-0");
+  do
+  {
+    rpp=sendRespCommand(rcs->rcp,"XAUTOCLAIM %s %s %s %d %s COUNT %d",rcs->stream,rcs->group,rcs->consumer,
+                        atomic_load(&rcs->claimIdleMs),rcs->claimStart,atomic_load(&rcs->count));
+    if(!rpp)
+      return;
+    items=rpp->items;
+    // *2 or *3 (from Redis 7) of the next start, the entries and the ids that were deleted
+    if(rpp->nItems<3 || items[0].respType!=RESPISARRAY || items[0].nItems<2 ||
+       items[1].respType!=RESPISBULKSTR || items[2].respType!=RESPISARRAY)
+    {
+      if(isError(rpp,""))
+        rcs->errorMsg="XAUTOCLAIM failed";
+      return;
+    }
+    len=items[1].length<sizeof(rcs->claimStart)-1?items[1].length:sizeof(rcs->claimStart)-1;
+    memcpy(rcs->claimStart,items[1].loc,len);
+    rcs->claimStart[len]='\0';
+    if(items[2].nItems && !dispatchEntries(rcs,2,1,acks))
+      return;
+  } while(strcmp(rcs->claimStart,"0-0") && !atomic_load(&rcs->stop));
+}
+
+// the connection dropped, keep trying to get it back. The reader's client leaves this to us so
+// that close can't find it halfway through reconnecting or get a new connection after stopping
+static int
+reconnectConsumer(RESPCONSUMER *rcs)
+{
+  int ok;
+
+  for(;;)
+  {
+    pthread_mutex_lock(&rcs->socketLock);
+    ok=!atomic_load(&rcs->stop) && reconnectRespServer(rcs->rcp);
+    pthread_mutex_unlock(&rcs->socketLock);
+    if(ok)
+      return(RAMISOK);
+    if(atomic_load(&rcs->stop))
+      return(RAMISFAIL);
+    sleep(1);
+  }
+}
+
+static void *
+consumerReader(void *arg)
+{
+  RESPCONSUMER *rcs=arg;
+  RESPROTO     *rpp;
+  ACKLIST       acks={0};
+  uint64_t      nextClaim=0;
+
+  while(!atomic_load(&rcs->stop))
+  {
+    if(atomic_load(&rcs->claimIdleMs)>0 && respTraceNow()>=nextClaim)
+    {
+      claimPending(rcs,&acks);
+      nextClaim=respTraceNow()+RESPCONSUMERCLAIMSECS*1000000000ULL;
+    }
+
+    rpp=sendRespCommand(rcs->rcp,"XREADGROUP GROUP %s %s COUNT %d BLOCK %d STREAMS %s >",
+                        rcs->group,rcs->consumer,atomic_load(&rcs->count),RESPCONSUMERBLOCKMS,rcs->stream);
+    if(!rpp)
+    {
+      if(atomic_load(&rcs->stop))
+        break;
+      rcs->errorMsg=rcs->rcp->rppFrom->errorMsg;
+      if(!reconnectConsumer(rcs))
+        break;
+      continue;
+    }
+    if(isError(rpp,""))
+    {
+      rcs->errorMsg="XREADGROUP failed";
+      if(isError(rpp,"NOGROUP")) // the stream or group was deleted
+        createGroup(rcs);
+      sleep(1);
+      continue;
+    }
+    // *1 of *2 of the stream's name and its entries, nil when BLOCK timed out
+    if(rpp->nItems<4 || rpp->items[0].respType!=RESPISARRAY || rpp->items[3].respType!=RESPISARRAY)
+      continue;
+    ++rcs->nReads;
+    dispatchEntries(rcs,3,0,&acks);
+    flushAcks(rcs,&acks);
+  }
+  flushAcks(rcs,&acks);
+  if(acks.buf)
+    ramisFree(acks.buf);
+  return(NULL);
+}
+
+static void *
+consumerWorker(void *arg)
+{
+  RESPENTRYQUEUE *q=arg;
+  RESPCONSUMER   *rcs=q->rcs;
+  RESPENTRY      *entry;
+  ACKLIST         acks={0};
+
+  for(;;)
+  {
+    sem_wait(&q->ready);
+    while((entry=entryQueuePop(q)))
+    {
+      if(rcs->handler(rcs->handlerData,entry))
+        addAck(&acks,entry->id,entry->idLen);
+      else
+        atomic_fetch_add_explicit(&rcs->nFailed,1,memory_order_relaxed);
+      respEntryRelease(entry);
+      if(acks.n>=RESPCONSUMERACKBATCH)
+        flushAcks(rcs,&acks);
+    }
+    flushAcks(rcs,&acks);
+    if(atomic_load(&rcs->workerStop))
+      break;
+  }
+  if(acks.buf)
+    ramisFree(acks.buf);
+  return(NULL);
+}
+
+
+/* ********************************* open/close ***************************** */
+
+RESPCONSUMER *
+respConsumerClose(RESPCONSUMER *rcs)
+{
+  RESPENTRY *entry;
+  int i;
+
+  if(!rcs)
+    return(NULL);
+
+  pthread_mutex_lock(&rcs->socketLock);
+  atomic_store(&rcs->stop,1);
+  if(rcs->reader && rcs->rcp && rcs->rcp->socket>-1)
+    shutdown(rcs->rcp->socket,SHUT_RDWR); // kicks the reader out of XREADGROUP's BLOCK
+  pthread_mutex_unlock(&rcs->socketLock);
+  if(rcs->reader)
+    pthread_join(rcs->reader,NULL);
+
+  // the reader has queued all it will, the workers handle what's left and stop
+  atomic_store(&rcs->workerStop,1);
+  if(rcs->queues)
+  {
+    for(i=0;i<rcs->nWorkers;i++)
+    {
+      if(rcs->workers && rcs->workers[i])
+      {
+        sem_post(&rcs->queues[i].ready);
+        pthread_join(rcs->workers[i],NULL);
+      }
+      while((entry=entryQueuePop(&rcs->queues[i]))) // only if its worker never started, it stays pending
+        respEntryRelease(entry);
+      sem_destroy(&rcs->queues[i].ready);
+    }
+    ramisFree(rcs->queues);
+  }
+  if(rcs->workers)
+    ramisFree(rcs->workers);
+
+  // the workers have handed over all their acknowledgements, send them
+  pthread_mutex_lock(&rcs->ackLock);
+  atomic_store(&rcs->ackStop,1);
+  pthread_cond_signal(&rcs->ackCond);
+  pthread_mutex_unlock(&rcs->ackLock);
+  if(rcs->acker)
+    pthread_join(rcs->acker,NULL);
+
+  if(rcs->rcp)
+    closeRespClient(rcs->rcp);
+  if(rcs->ackRcp)
+    closeRespClient(rcs->ackRcp);
+  if(rcs->ackBuf)
+    ramisFree(rcs->ackBuf);
+  if(rcs->stream)
+    ramisFree(rcs->stream);
+  if(rcs->group)
+    ramisFree(rcs->group);
+  if(rcs->consumer)
+    ramisFree(rcs->consumer);
+  pthread_cond_destroy(&rcs->ackCond);
+  pthread_mutex_destroy(&rcs->ackLock);
+  pthread_mutex_destroy(&rcs->socketLock);
+  ramisFree(rcs);
+  return(NULL);
+}
+
+RESPCONSUMER *
+respConsumerOpen(char *hostname,int port,const char *stream,const char *group,const char *consumer,
+                 int nWorkers,respEntryHandler handler,void *handlerData)
+{
+  RESPCONSUMER *rcs;
+  int i;
+
+  if(nWorkers<1 || nWorkers>RESPCONSUMERMAXWORKERS || !handler)
+    return(NULL);
+
+  rcs=ramisCalloc(1,sizeof(RESPCONSUMER));
+  if(!rcs)
+    return(NULL);
+
+  pthread_mutex_init(&rcs->ackLock,NULL);
+  pthread_mutex_init(&rcs->socketLock,NULL);
+  pthread_cond_init(&rcs->ackCond,NULL);
+  rcs->nWorkers=nWorkers;
+  rcs->handler=handler;
+  rcs->handlerData=handlerData;
+  atomic_store(&rcs->count,RESPCONSUMERCOUNT);
+  atomic_store(&rcs->claimIdleMs,RESPCONSUMERCLAIMMS);
+  rcs->stream=strdup(stream);
+  rcs->group=strdup(group);
+  rcs->consumer=strdup(consumer);
+  rcs->rcp=connectRespServer(hostname,port);
+  rcs->ackRcp=connectRespServer(hostname,port);
+  rcs->queues=ramisCalloc(nWorkers,sizeof(RESPENTRYQUEUE));
+  rcs->workers=ramisCalloc(nWorkers,sizeof(pthread_t));
+  if(!rcs->stream || !rcs->group || !rcs->consumer || !rcs->rcp || !rcs->ackRcp || !rcs->queues || !rcs->workers ||
+     !createGroup(rcs))
+  {
+    if(rcs->queues) // none of the semaphores exist yet
+    {
+      ramisFree(rcs->queues);
+      rcs->queues=NULL;
+    }
+    return(respConsumerClose(rcs));
+  }
+  rcs->rcp->ownerReconnects=1; // only reconnectConsumer() reconnects the reader
+
+  for(i=0;i<nWorkers;i++)
+  {
+    rcs->queues[i].rcs=rcs;
+    sem_init(&rcs->queues[i].ready,0,0);
+  }
+  for(i=0;i<nWorkers;i++)
+    if(pthread_create(&rcs->workers[i],NULL,consumerWorker,&rcs->queues[i]))
+      return(respConsumerClose(rcs));
+  if(pthread_create(&rcs->acker,NULL,consumerAcker,rcs) || pthread_create(&rcs->reader,NULL,consumerReader,rcs))
+    return(respConsumerClose(rcs));
+
+  return(rcs);
+}
@@ -0,0 +1,122 @@
+//
+//  resp_consumer.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A Streams consumer group engine. A reader thread on its own connection issues blocking
+//  XREADGROUP with COUNT, decodes each reply into entries that point into it and hands them to
+//  worker threads. Entries whose handler succeeds are acknowledged in batches, many ids to an
+//  XACK and several XACKs to a write, by an ack thread on a second connection. Entries left
+//  pending by a consumer that died, or by a handler that failed, are taken back with XAUTOCLAIM.
+//
+
+#ifndef resp_consumer_h
+#define resp_consumer_h
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include "respClient.h"
+
+#define RESPCONSUMERCOUNT      512    // default entries asked for per XREADGROUP
+#define RESPCONSUMERBLOCKMS    1000   // XREADGROUP's BLOCK, under RESPCLIENTTIMEOUT
+#define RESPCONSUMERCLAIMMS    60000  // default idle time before a pending entry is claimed, 0 for never
+#define RESPCONSUMERCLAIMSECS  10     // how often to look for entries to claim
+#define RESPCONSUMERQUEUESZ    8192   // entries a worker queue can hold, must be a power of 2
+#define RESPCONSUMERACKBATCH   1024   // acknowledgements collected before the ack thread is woken
+#define RESPCONSUMERACKMAX     1024   // ids in one XACK
+#define RESPCONSUMERACKMS      5      // the longest an acknowledgement waits for a batch to fill
+#define RESPCONSUMERMAXWORKERS 64
+
+#define RESPENTRY         struct respEntryStruct
+#define RESPENTRYBATCH    struct respEntryBatchStruct
+#define RESPENTRYQUEUE    struct respEntryQueueStruct
+#define RESPCONSUMER      struct respConsumerStruct
+
+// one stream entry, everything points into the reply it came in
+RESPENTRY
+{
+  const byte     *id;           // "1589312345678-0", not '\0' terminated
+  size_t          idLen;
+  RESPITEM       *fields;       // field name, value, name, value...
+  int             nFields;      // pairs, so fields has 2*nFields items
+  int             claimed;      // it came from XAUTOCLAIM rather than XREADGROUP
+  RESPENTRYBATCH *batch;
+};
+
+RESPENTRYBATCH // the entries of one XREADGROUP or XAUTOCLAIM reply
+{
+  atomic_int      refCount;     // the reader holds one until it's queued everything, and each entry one
+  RESPREPLY      *reply;        // detached from the reader's client, what the entries point into
+  RESPENTRY      *entries;
+  int             nEntries;
+};
+
+RESPENTRYQUEUE // single producer (the reader) single consumer (a worker) ring
+{
+  _Atomic size_t  head;
+  _Atomic size_t  tail;
+  RESPENTRY      *slots[RESPCONSUMERQUEUESZ];
+  sem_t           ready;        // posted once per reply that put something in this queue
+  RESPCONSUMER   *rcs;
+};
+
+// returns RAMISOK to have the entry acknowledged, RAMISFAIL leaves it pending to be claimed again
+typedef int (*respEntryHandler)(void *handlerData,RESPENTRY *entry);
+
+RESPCONSUMER
+{
+  RESPCLIENT     *rcp;          // XREADGROUP and XAUTOCLAIM, only the reader uses it
+  RESPCLIENT     *ackRcp;       // XACK, only the ack thread uses it
+  char           *stream;
+  char           *group;
+  char           *consumer;
+  respEntryHandler handler;
+  void           *handlerData;
+  atomic_int      count;        // COUNT for XREADGROUP, may be changed while it runs
+  atomic_int      claimIdleMs;  // XAUTOCLAIM's min-idle-time, 0 turns claiming off
+  pthread_t       reader;
+  pthread_t       acker;
+  int             nWorkers;
+  pthread_t      *workers;
+  RESPENTRYQUEUE *queues;       // one per worker
+  int             nextWorker;   // entries go round robin, one worker keeps them in order
+  char            claimStart[64]; // XAUTOCLAIM's cursor
+
+  // acknowledgements waiting for the ack thread, "$len\r\nid\r\n" each
+  pthread_mutex_t ackLock;
+  pthread_cond_t  ackCond;
+  byte           *ackBuf;
+  size_t          ackSize;
+  size_t          ackUsed;
+  int             nAcks;
+
+  pthread_mutex_t socketLock;   // held to reconnect the reader's client or shut its socket down
+  atomic_int      stop;         // the reader, set with socketLock held
+  atomic_int      workerStop;   // the workers, once the reader has queued its last entry
+  atomic_int      ackStop;      // the ack thread, after the workers have handed over their acks
+  char * _Atomic  errorMsg;     // the last thing to go wrong, set by the reader and the ack thread
+
+  uint64_t        nEntries;     // handed to workers, updated by the reader only
+  uint64_t        nClaimed;     // of those, the ones XAUTOCLAIM took back
+  uint64_t        nAcked;       // the server's count of acknowledged, updated by the ack thread only
+  atomic_ullong   nFailed;      // handlers that returned RAMISFAIL
+  uint64_t        nReads;       // XREADGROUPs that returned entries
+};
+
+// connects twice to the server, creates group on stream at its end if it doesn't exist, and starts
+// reading as consumer with nWorkers threads calling handler on the entries
+RESPCONSUMER * respConsumerOpen(char *hostname,int port,const char *stream,const char *group,const char *consumer,
+                                int nWorkers,respEntryHandler handler,void *handlerData);
+
+// stops reading, lets the workers finish what they've been given, sends the last acknowledgements
+RESPCONSUMER * respConsumerClose(RESPCONSUMER *rcs);
+
+// the value of field name in entry, NULL if it doesn't have it
+RESPITEM * respEntryField(RESPENTRY *entry,const char *name);
+
+// a handler that wants to keep an entry after it returns must retain it and later release it
+void respEntryRetain(RESPENTRY *entry);
+void respEntryRelease(RESPENTRY *entry);
+
+#endif /* resp_consumer_h */
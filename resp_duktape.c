@@ -0,0 +1,212 @@
+//
+//  resp_duktape.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Commands are encoded in two passes over the stack, one to size the buffer and one to fill
+//  it, so nothing is allocated that a Duktape error could leak. Numbers are formatted in
+//  both passes, which costs less than keeping them somewhere.
+//
+
+#ifdef RP_USING_DUKTAPE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "duktape.h"
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_duktape.h"
+
+#define DUKNUMBERLEN  32           // %.17g of a double fits
+#define DUKSAFEINT    (1LL<<53)    // integers past this lose digits as JS numbers
+
+
+// the bytes of the value at idx. Numbers are formatted into numBuf
+static const byte *
+dukArgBytes(duk_context *ctx,duk_idx_t idx,char *numBuf,size_t *lenp)
+{
+  const void *p=NULL;
+  duk_size_t  len=0;
+  double      d;
+
+  switch(duk_get_type(ctx,idx))
+  {
+    case DUK_TYPE_STRING:
+      p=duk_get_lstring(ctx,idx,&len);
+      break;
+    case DUK_TYPE_NUMBER:
+    {
+      d=duk_get_number(ctx,idx);
+      if(d==floor(d) && fabs(d)<9.2e18)
+        len=sprintf(numBuf,"%lld",(long long)d);
+      else
+        len=sprintf(numBuf,"%.17g",d);
+      p=numBuf;
+    } break;
+    case DUK_TYPE_BOOLEAN:
+      p=duk_get_boolean(ctx,idx)?"1":"0";
+      len=1;
+      break;
+    case DUK_TYPE_BUFFER:
+      p=duk_get_buffer_data(ctx,idx,&len);
+      break;
+    case DUK_TYPE_OBJECT:
+      if(duk_is_buffer_data(ctx,idx)) // ArrayBuffer, typed arrays and Node.js Buffers
+      {
+        p=duk_get_buffer_data(ctx,idx,&len);
+        break;
+      }
+      // fall through
+    default:
+      (void)duk_error(ctx,DUK_ERR_TYPE_ERROR,"the value at stack index %d can't be sent to the server, only strings, numbers, booleans and buffers can",(int)idx);
+  }
+  *lenp=len;
+  return(p?(const byte *)p:(const byte *)""); // an empty buffer has no data pointer
+}
+
+size_t
+respDukEncode(duk_context *ctx,duk_idx_t first,byte **outBufp,size_t *outBufszp,size_t used)
+{
+  duk_idx_t top=duk_get_top(ctx),idx;
+  char      numBuf[DUKNUMBERLEN];
+  const byte *arg;
+  size_t    len,need;
+  char     *p;
+
+  first=duk_require_normalize_index(ctx,first);
+  if(first>=top)
+    (void)duk_error(ctx,DUK_ERR_ERROR,"no command given");
+
+  need=RESPMAXDIGITS+3;
+  for(idx=first;idx<top;idx++)
+  {
+    dukArgBytes(ctx,idx,numBuf,&len);
+    need+=RESPMAXDIGITS+5+len;
+  }
+  if(used+need>*outBufszp)
+  {
+    byte *newBuf=ramisRealloc(*outBufp,used+need+RESPCLIENTBUFSZ);
+
+    if(!newBuf)
+      (void)duk_error(ctx,DUK_ERR_ERROR,"out of memory encoding a command");
+    *outBufp=newBuf;
+    *outBufszp=used+need+RESPCLIENTBUFSZ;
+  }
+
+  p=(char *)*outBufp+used;
+  p+=sprintf(p,"*%d\r\n",(int)(top-first));
+  for(idx=first;idx<top;idx++)
+  {
+    arg=dukArgBytes(ctx,idx,numBuf,&len);
+    p+=sprintf(p,"$%zu\r\n",len);
+    memcpy(p,arg,len);
+    p+=len;
+    *p++='\r';
+    *p++='\n';
+  }
+  return((byte *)p-(*outBufp+used));
+}
+
+int
+respDukPushReply(duk_context *ctx,RESPITEM *items,int nItems,int i,int flags)
+{
+  RESPITEM *item;
+  uint64_t  n,k;
+  duk_idx_t container;
+
+  if(i>=nItems)
+  {
+    duk_push_undefined(ctx);
+    return(i);
+  }
+  item=&items[i++];
+  switch(item->respType)
+  {
+    case RESPISARRAY:
+    {
+      n=item->nItems;
+      if((flags&RESPDUKOBJECT) && !(n&1))
+      {
+        container=duk_push_object(ctx);
+        for(k=0;k<n;k+=2)
+        {
+          i=respDukPushReply(ctx,items,nItems,i,flags&~RESPDUKOBJECT);
+          i=respDukPushReply(ctx,items,nItems,i,flags&~RESPDUKOBJECT);
+          duk_put_prop(ctx,container);
+        }
+        break;
+      }
+      container=duk_push_array(ctx);
+      for(k=0;k<n;k++)
+      {
+        i=respDukPushReply(ctx,items,nItems,i,flags&~RESPDUKOBJECT);
+        duk_put_prop_index(ctx,container,(duk_uarridx_t)k);
+      }
+    } break;
+    case RESPISBULKSTR:
+    {
+      if(flags&RESPDUKBUFFERS)
+      {
+        void *buf=duk_push_fixed_buffer(ctx,item->length);
+
+        if(item->length)
+          memcpy(buf,item->loc,item->length);
+      }
+      else
+        duk_push_lstring(ctx,(const char *)item->loc,item->length);
+    } break;
+    case RESPISSTR:
+    case RESPISPLAINTXT:
+      duk_push_lstring(ctx,(const char *)item->loc,item->length);
+      break;
+    case RESPISINT:
+    {
+      if(item->rinteger>-DUKSAFEINT && item->rinteger<DUKSAFEINT)
+        duk_push_number(ctx,(double)item->rinteger);
+      else // as a string rather than rounded
+        duk_push_sprintf(ctx,"%lld",(long long)item->rinteger);
+    } break;
+    case RESPISFLOAT:
+      duk_push_number(ctx,item->rfloat);
+      break;
+    case RESPISERRORMSG:
+      duk_push_error_object(ctx,DUK_ERR_ERROR,"%.*s",(int)item->length,(const char *)item->loc);
+      break;
+    case RESPISNULL:
+    default:
+      duk_push_null(ctx);
+  }
+  return(i);
+}
+
+duk_ret_t
+respDukCommand(duk_context *ctx,RESPCLIENT *rcp,duk_idx_t first,int flags)
+{
+  RESPROTO *rpp;
+  uint64_t  t0=0;
+  size_t    n;
+
+  rcp->rppFrom->errorMsg=NULL;
+  if(rcp->trace)
+    t0=respTraceNow();
+  n=respDukEncode(ctx,first,&rcp->toBuf,&rcp->toBufSz,0);
+  if(rcp->trace)
+    respTracePhase(rcp->trace,RESPTRACEENCODE,t0);
+  if(!transmitRespCommand(rcp,rcp->toBuf,n))
+  {
+    if(rcp->trace)
+      respTraceDone(rcp->trace,1);
+    (void)duk_error(ctx,DUK_ERR_ERROR,"%s",rcp->rppFrom->errorMsg);
+  }
+  if(!(rpp=getRespReply(rcp)))
+    (void)duk_error(ctx,DUK_ERR_ERROR,"%s",rcp->rppFrom->errorMsg?rcp->rppFrom->errorMsg:"no reply from the server");
+
+  duk_require_stack(ctx,RESPNESTEDARRAYMAX*2+4); // an object level holds the container, a name and a value
+  respDukPushReply(ctx,rpp->items,rpp->nItems,0,flags);
+  return(1);
+}
+
+#endif /* RP_USING_DUKTAPE */
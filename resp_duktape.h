@@ -0,0 +1,37 @@
+//
+//  resp_duktape.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A direct path between the Duktape value stack and the client for JavaScript bindings.
+//  Arguments are taken off the stack by index and their strings and buffers are encoded
+//  from where Duktape keeps them, with no format string or per argument type lookup.
+//  Replies are pushed back as JS values in one pass over the items. Only built with
+//  RP_USING_DUKTAPE.
+//
+
+#ifndef resp_duktape_h
+#define resp_duktape_h
+#ifdef RP_USING_DUKTAPE
+#include "duktape.h"
+#include "respClient.h"
+
+#define RESPDUKBUFFERS  1 // bulk strings become buffers rather than strings, for binary values
+#define RESPDUKOBJECT   2 // a top level array of names and values becomes an object, for HGETALL and the like
+
+// sends the command made of the values on the stack from index first to the top and pushes its
+// reply. Strings and buffers are sent as they are, numbers are formatted and booleans are 1 or 0.
+// Throws on anything else and on errors talking to the server. Returns 1 for a duk_c_function
+duk_ret_t respDukCommand(duk_context *ctx,RESPCLIENT *rcp,duk_idx_t first,int flags);
+
+// encodes the values from index first to the top onto *outBufp at offset used, growing it.
+// Returns the number of bytes added or throws
+size_t respDukEncode(duk_context *ctx,duk_idx_t first,byte **outBufp,size_t *outBufszp,size_t used);
+
+// pushes the reply that starts at items[i] and returns the index after it. An error reply is
+// pushed as an Error object
+int respDukPushReply(duk_context *ctx,RESPITEM *items,int nItems,int i,int flags);
+
+#endif /* RP_USING_DUKTAPE */
+#endif /* resp_duktape_h */
@@ -0,0 +1,355 @@
+//
+//  resp_hotkeys.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The sketch uses conservative update, only the rows at the key's current minimum are
+//  raised, which keeps keys that share columns with a hot one from looking hot themselves.
+//  The rows' columns come from one 64 bit hash by double hashing. The heap is searched
+//  linearly for a key already in it, k is meant to be tens of keys, not thousands.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "resp_trace.h"
+#include "resp_hotkeys.h"
+
+#define HOTREAD   1
+#define HOTWRITE  2
+
+
+RESPHOTKEYS *
+freeRespHotKeys(RESPHOTKEYS *rhk)
+{
+  if(rhk)
+  {
+    if(rhk->sketch)
+      ramisFree(rhk->sketch);
+    if(rhk->top)
+      ramisFree(rhk->top);
+    ramisFree(rhk);
+  }
+  return(NULL);
+}
+
+RESPHOTKEYS *
+newRespHotKeys(int k,uint32_t sampleEvery)
+{
+  RESPHOTKEYS *rhk;
+  uint32_t width=RESPHOTMINWIDTH;
+
+  if(k<1)
+    return(NULL);
+  if(!(rhk=ramisCalloc(1,sizeof(RESPHOTKEYS))))
+    return(NULL);
+  while(width<(uint64_t)k*RESPHOTWIDTHPERKEY && width<(1u<<24))
+    width<<=1;
+  rhk->width=width;
+  rhk->k=k;
+  rhk->sampleEvery=sampleEvery?sampleEvery:1;
+  rhk->untilSample=rhk->sampleEvery;
+  rhk->sketch=ramisCalloc((size_t)RESPHOTDEPTH*width,sizeof(uint32_t));
+  rhk->top=ramisCalloc(k,sizeof(RESPHOTKEY));
+  if(!rhk->sketch || !rhk->top)
+    return(freeRespHotKeys(rhk));
+  rhk->windowStartNs=respTraceNow();
+  return(rhk);
+}
+
+void
+respHotKeysDumpEvery(RESPHOTKEYS *rhk,FILE *fh,int dumpSecs)
+{
+  rhk->dumpFh=dumpSecs>0?fh:NULL;
+  rhk->dumpNs=dumpSecs>0?(uint64_t)dumpSecs*1000000000ULL:0;
+}
+
+void
+respHotKeysReset(RESPHOTKEYS *rhk)
+{
+  memset(rhk->sketch,0,(size_t)RESPHOTDEPTH*rhk->width*sizeof(uint32_t));
+  rhk->nTop=0;
+  rhk->sampled=0;
+  rhk->windowStartNs=respTraceNow();
+}
+
+double
+respHotKeysWindowSecs(RESPHOTKEYS *rhk)
+{
+  uint64_t ns=respTraceNow()-rhk->windowStartNs;
+
+  return(ns?ns/1e9:1e-9);
+}
+
+
+/* *********************************** counting ***************************** */
+
+// FNV-1a with splitmix64's finalizer, so the high half is as good as the low one
+static uint64_t
+keyHash(const uint8_t *p,size_t len)
+{
+  uint64_t h=14695981039346656037ULL;
+
+  while(len--)
+  {
+    h^=*p++;
+    h*=1099511628211ULL;
+  }
+  h^=h>>30;
+  h*=0xbf58476d1ce4e5b9ULL;
+  h^=h>>27;
+  h*=0x94d049bb133111ebULL;
+  h^=h>>31;
+  return(h);
+}
+
+// adds weight to the key's columns, returning its new estimate
+static uint64_t
+sketchAdd(RESPHOTKEYS *rhk,uint64_t hash,uint32_t weight)
+{
+  uint32_t h1=(uint32_t)hash,h2=(uint32_t)(hash>>32)|1,mask=rhk->width-1;
+  uint32_t *cell[RESPHOTDEPTH];
+  uint64_t min=UINT32_MAX,est;
+  int d;
+
+  for(d=0;d<RESPHOTDEPTH;d++)
+  {
+    cell[d]=&rhk->sketch[(size_t)d*rhk->width+((h1+d*h2)&mask)];
+    if(*cell[d]<min)
+      min=*cell[d];
+  }
+  est=min+weight;
+  if(est>UINT32_MAX)
+    est=UINT32_MAX;
+  for(d=0;d<RESPHOTDEPTH;d++)
+    if(*cell[d]<est)
+      *cell[d]=(uint32_t)est;
+  return(est);
+}
+
+static void
+siftDown(RESPHOTKEY *heap,int n,int i)
+{
+  RESPHOTKEY tmp;
+  int child;
+
+  while((child=2*i+1)<n)
+  {
+    if(child+1<n && heap[child+1].count<heap[child].count)
+      child++;
+    if(heap[i].count<=heap[child].count)
+      break;
+    tmp=heap[i];
+    heap[i]=heap[child];
+    heap[child]=tmp;
+    i=child;
+  }
+}
+
+static void
+siftUp(RESPHOTKEY *heap,int i)
+{
+  RESPHOTKEY tmp;
+  int parent;
+
+  while(i && heap[parent=(i-1)/2].count>heap[i].count)
+  {
+    tmp=heap[i];
+    heap[i]=heap[parent];
+    heap[parent]=tmp;
+    i=parent;
+  }
+}
+
+static void
+countKey(RESPHOTKEYS *rhk,const uint8_t *key,size_t len,int kind)
+{
+  uint64_t hash=keyHash(key,len),est=sketchAdd(rhk,hash,rhk->sampleEvery);
+  RESPHOTKEY *hk;
+  int i;
+
+  for(i=0;i<rhk->nTop;i++)
+    if(rhk->top[i].hash==hash)
+    {
+      hk=&rhk->top[i];
+      hk->count=est;
+      hk->reads+=kind==HOTREAD?rhk->sampleEvery:0;
+      hk->writes+=kind==HOTWRITE?rhk->sampleEvery:0;
+      siftDown(rhk->top,rhk->nTop,i); // its count only goes up
+      return;
+    }
+
+  if(rhk->nTop<rhk->k)
+    i=rhk->nTop++;
+  else
+  if(est>rhk->top[0].count)
+    i=0; // takes the coolest one's place
+  else
+    return;
+  hk=&rhk->top[i];
+  hk->hash=hash;
+  hk->count=est;
+  // what it had before it made the list is only in the sketch, which doesn't split it
+  hk->reads=kind==HOTREAD?rhk->sampleEvery:0;
+  hk->writes=kind==HOTWRITE?rhk->sampleEvery:0;
+  hk->keyLen=(uint32_t)len;
+  if(len>RESPHOTKEYLEN-1)
+    len=RESPHOTKEYLEN-1;
+  memcpy(hk->key,key,len);
+  hk->key[len]='\0';
+  if(i)
+    siftUp(rhk->top,i);
+  else
+    siftDown(rhk->top,rhk->nTop,0);
+}
+
+// returns the next bulk string in a request and moves *pp past it, NULL if there isn't one
+static const uint8_t *
+nextBulkString(const uint8_t **pp,const uint8_t *end,size_t *lenp)
+{
+  const uint8_t *p=*pp;
+  size_t len=0;
+
+  if(p>=end || *p!='$')
+    return(NULL);
+  for(++p;p<end && isdigit(*p);p++)
+    len=len*10+(*p-'0');
+  p+=2;
+  if(p>end || len>(size_t)(end-p))
+    return(NULL);
+  *lenp=len;
+  *pp=p+len+2;
+  return(p);
+}
+
+// is argument i one of the keys the table gives cmd, which may be NULL, or in the range its movable keys were found in
+static int
+isKey(RAMISCMD *cmd,long nArgs,long i,int first,int last,int step)
+{
+  long tFirst=cmd?cmd->firstKey:0,tLast=!cmd?0:cmd->lastKey<0?nArgs+cmd->lastKey:cmd->lastKey,tStep=cmd && cmd->keyStep>0?cmd->keyStep:1;
+
+  return((tFirst>0 && i>=tFirst && i<=tLast && !((i-tFirst)%tStep)) || (first>0 && i>=first && i<=last && !((i-first)%step)));
+}
+
+void
+respHotKeysSample(RESPHOTKEYS *rhk,const uint8_t *buf,size_t n)
+{
+  const uint8_t *p=buf,*end=buf+n,*s;
+  const char *args[RESPHOTMOVABLEARGS];
+  size_t argLens[RESPHOTMOVABLEARGS];
+  size_t len;
+  long nArgs,i;
+  int first,last,step;
+  RAMISCMD *cmd;
+  int kind;
+
+  if(rhk->dumpFh && respTraceNow()-rhk->windowStartNs>=rhk->dumpNs)
+  {
+    respHotKeysDump(rhk,rhk->dumpFh);
+    respHotKeysReset(rhk);
+  }
+
+  // "*N\r\n$L\r\nNAME\r\n$L\r\nKEY\r\n..." for each command in the write
+  while(p<end && *p=='*')
+  {
+    for(nArgs=0,++p;p<end && isdigit(*p);p++)
+      nArgs=nArgs*10+(*p-'0');
+    p+=2;
+    if(nArgs<1 || !(s=nextBulkString(&p,end,&len)))
+      return;
+    rhk->sampled++;
+    cmd=ramisFindCommand((const char *)s,(unsigned int)len);
+    kind=!cmd?0:(cmd->flags&RAMISCMDWRITE)?HOTWRITE:(cmd->flags&RAMISCMDREADONLY)?HOTREAD:0;
+    first=last=0;
+    step=1;
+    if(cmd && (cmd->flags&RAMISCMDMOVABLEKEYS) && nArgs<=RESPHOTMOVABLEARGS)
+    {
+      // the keys depend on the arguments, so they're all found before any is counted
+      args[0]=(const char *)s;
+      argLens[0]=len;
+      for(i=1;i<nArgs;i++)
+      {
+        if(!(s=nextBulkString(&p,end,&len)))
+          return;
+        args[i]=(const char *)s;
+        argLens[i]=len;
+      }
+      if(respCommandKeyRange(cmd,(int)nArgs,args,argLens,&first,&last,&step)>0 && !strcmp(cmd->command,"migrate"))
+        cmd=NULL; // its table key is "" when KEYS lists them
+      for(i=1;i<nArgs;i++)
+        if(isKey(cmd,nArgs,i,first,last,step))
+          countKey(rhk,(const uint8_t *)args[i],argLens[i],kind);
+      continue;
+    }
+    for(i=1;i<nArgs;i++)
+    {
+      if(!(s=nextBulkString(&p,end,&len)))
+        return;
+      if(isKey(cmd,nArgs,i,first,last,step))
+        countKey(rhk,s,len,kind);
+    }
+  }
+}
+
+
+/* ********************************** reporting ***************************** */
+
+static int
+hotter(const void *a,const void *b)
+{
+  uint64_t ca=((const RESPHOTKEY *)a)->count,cb=((const RESPHOTKEY *)b)->count;
+
+  return(ca<cb?1:ca>cb?-1:0);
+}
+
+int
+respHotKeysTop(RESPHOTKEYS *rhk,RESPHOTKEY *out,int max)
+{
+  RESPHOTKEY *sorted;
+  int n=rhk->nTop<max?rhk->nTop:max;
+
+  if(n<=0)
+    return(0);
+  if(n==rhk->nTop || !(sorted=ramisMalloc(rhk->nTop*sizeof(RESPHOTKEY))))
+  {
+    memcpy(out,rhk->top,n*sizeof(RESPHOTKEY)); // without memory the heap's first max are taken
+    qsort(out,n,sizeof(RESPHOTKEY),hotter);
+    return(n);
+  }
+  memcpy(sorted,rhk->top,rhk->nTop*sizeof(RESPHOTKEY));
+  qsort(sorted,rhk->nTop,sizeof(RESPHOTKEY),hotter);
+  memcpy(out,sorted,n*sizeof(RESPHOTKEY));
+  ramisFree(sorted);
+  return(n);
+}
+
+void
+respHotKeysDump(RESPHOTKEYS *rhk,FILE *fh)
+{
+  double secs=respHotKeysWindowSecs(rhk);
+  RESPHOTKEY *keys=ramisMalloc(rhk->k*sizeof(RESPHOTKEY));
+  uint32_t j,len;
+  int i,n;
+
+  fprintf(fh,"hot keys over %.1fs, %llu commands sampled 1 in %u\n",secs,(unsigned long long)rhk->sampled,rhk->sampleEvery);
+  if(!keys)
+    return;
+  n=respHotKeysTop(rhk,keys,rhk->k);
+  for(i=0;i<n;i++)
+  {
+    fprintf(fh,"%3d %10.0f/s  reads %10.0f/s  writes %10.0f/s  ",i+1,keys[i].count/secs,keys[i].reads/secs,keys[i].writes/secs);
+    len=keys[i].keyLen<RESPHOTKEYLEN?keys[i].keyLen:RESPHOTKEYLEN-1;
+    for(j=0;j<len;j++)
+      if(isprint((unsigned char)keys[i].key[j]) && keys[i].key[j]!='\\')
+        fputc(keys[i].key[j],fh);
+      else
+        fprintf(fh,"\\x%02x",(unsigned char)keys[i].key[j]);
+    fprintf(fh,"%s\n",keys[i].keyLen>=RESPHOTKEYLEN?"...":"");
+  }
+  fflush(fh);
+  ramisFree(keys);
+}
@@ -0,0 +1,85 @@
+//
+//  resp_hotkeys.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Finds the keys a client hits hardest, to catch one key melting a shard as it happens.
+//  One write in sampleEvery has its commands' keys counted in a count-min sketch, and the
+//  k keys with the highest counts are kept in a heap with their reads and writes. Memory is
+//  fixed when it's made. Commands that aren't sampled cost a decrement.
+//
+
+#ifndef resp_hotkeys_h
+#define resp_hotkeys_h
+#include <stdio.h>
+#include <stdint.h>
+
+#define RESPHOTKEYLEN      64   // keys are truncated to fit, they're told apart by hash
+#define RESPHOTDEPTH       4    // sketch rows, each a separate hash of the key
+#define RESPHOTWIDTHPERKEY 128  // sketch columns for each of the top k, rounded up to a power of two
+#define RESPHOTMINWIDTH    1024
+#define RESPHOTMOVABLEARGS 256  // commands with movable keys and more arguments than this only count the table's keys
+
+#define RESPHOTKEY struct respHotKeyStruct
+RESPHOTKEY
+{
+  uint64_t hash;
+  uint64_t count;          // the sketch's estimate of the commands on it, scaled by sampleEvery
+  uint64_t reads;          // the part of count from read only commands
+  uint64_t writes;         // and from commands that write, others such as EXPIRE... are in neither
+  uint32_t keyLen;         // the key's real length
+  char     key[RESPHOTKEYLEN];
+};
+
+#define RESPHOTKEYS struct respHotKeysStruct
+RESPHOTKEYS
+{
+  uint32_t   *sketch;      // RESPHOTDEPTH rows of width counters
+  uint32_t    width;       // a power of two
+  RESPHOTKEY *top;         // a min heap on count, the coolest of the hot keys is top[0]
+  int         k;
+  int         nTop;
+  uint32_t    sampleEvery;
+  uint32_t    untilSample; // writes left before the next sampled one
+  uint64_t    sampled;     // commands counted in this window
+  uint64_t    windowStartNs;
+
+  // the periodic dump, when dumpFh isn't NULL
+  FILE       *dumpFh;
+  uint64_t    dumpNs;
+};
+
+// k hot keys are kept from 1 in sampleEvery writes
+RESPHOTKEYS * newRespHotKeys(int k,uint32_t sampleEvery);
+RESPHOTKEYS * freeRespHotKeys(RESPHOTKEYS *rhk);
+
+// writes the hot keys to fh and starts a new window every dumpSecs. A NULL fh turns it off
+void respHotKeysDumpEvery(RESPHOTKEYS *rhk,FILE *fh,int dumpSecs);
+
+// counts the keys of the RESP encoded commands in buf
+void respHotKeysSample(RESPHOTKEYS *rhk,const uint8_t *buf,size_t n);
+
+// called for each write, only sampled ones cost more than the decrement
+static inline void
+respHotKeysRequest(RESPHOTKEYS *rhk,const uint8_t *buf,size_t n)
+{
+  if(--rhk->untilSample)
+    return;
+  rhk->untilSample=rhk->sampleEvery;
+  respHotKeysSample(rhk,buf,n);
+}
+
+// copies up to max of the hot keys to out, hottest first, and returns how many there were
+int respHotKeysTop(RESPHOTKEYS *rhk,RESPHOTKEY *out,int max);
+
+// seconds since the window began, counts divided by it are rates
+double respHotKeysWindowSecs(RESPHOTKEYS *rhk);
+
+// writes the hot keys with their rates to fh
+void respHotKeysDump(RESPHOTKEYS *rhk,FILE *fh);
+
+// forgets everything and starts a new window
+void respHotKeysReset(RESPHOTKEYS *rhk);
+
+#endif /* resp_hotkeys_h */
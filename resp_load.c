@@ -0,0 +1,357 @@
+//
+//  resp_load.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The scanner keeps one count, the values still to come before the top level one is done.
+//  Every value takes one from it and an array adds its length, so nesting needs no stack.
+//  Bulk payloads are skipped by length and other lines with memchr(), so scanning costs far
+//  less than the network. Commands are scanned as they're generated to know how many replies
+//  to wait for, which also catches input that isn't RESP before the server drops us for it.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_load.h"
+
+#ifdef MSG_NOSIGNAL
+#define LOADSENDFLAGS MSG_NOSIGNAL
+#else
+#define LOADSENDFLAGS 0
+#endif
+
+#define LOADREADSZ  (64*1024) // what's read from a file at a time
+
+static const char replyOff[]="*3\r\n$6\r\nCLIENT\r\n$5\r\nREPLY\r\n$3\r\nOFF\r\n";
+static const char replyOn[]="*3\r\n$6\r\nCLIENT\r\n$5\r\nREPLY\r\n$2\r\nON\r\n";
+
+
+/* ********************************* scanning ******************************* */
+
+void
+respLoadScanInit(RESPLOADSCANNER *rsc,int requests)
+{
+  memset(rsc,0,sizeof(RESPLOADSCANNER));
+  rsc->requests=(char)requests;
+}
+
+// a value has been scanned, the top level one is done when nothing more is pending
+static inline void
+valueDone(RESPLOADSCANNER *rsc)
+{
+  rsc->lineType=0;
+  if(--rsc->pending)
+    return;
+  rsc->nValues++;
+  rsc->nErrors+=rsc->topError;
+}
+
+int
+respLoadScan(RESPLOADSCANNER *rsc,const byte *buf,size_t len)
+{
+  const byte *p=buf,*end=buf+len,*nl;
+  size_t n;
+
+  while(p<end)
+  {
+    if(rsc->bulkLeft)
+    {
+      n=(size_t)(end-p)<(uint64_t)rsc->bulkLeft?(size_t)(end-p):(size_t)rsc->bulkLeft;
+      p+=n;
+      if(!(rsc->bulkLeft-=n))
+        valueDone(rsc);
+      continue;
+    }
+
+    if(!rsc->lineType) // the type byte
+    {
+      rsc->lineType=(char)*p++;
+      rsc->number=0;
+      rsc->negative=0;
+      if(!rsc->pending)
+      {
+        rsc->pending=1;
+        rsc->topError=rsc->lineType=='-' && !rsc->requests;
+      }
+      switch(rsc->lineType)
+      {
+        case '+': case '-': case ':': case '$': case '*':
+          break;
+        default:
+          if(!rsc->requests || rsc->pending!=1)
+          {
+            rsc->errorMsg="RESP invalid type byte";
+            return(RAMISFAIL);
+          }
+          if(rsc->lineType=='\n') // a blank line between commands, servers skip them
+          {
+            rsc->lineType=0;
+            rsc->pending=0;
+          }
+          else // an inline command, or 'E' for a blank line's '\r'
+            rsc->lineType=rsc->lineType=='\r'?'E':'I';
+      }
+      continue;
+    }
+
+    if(rsc->lineType=='$' || rsc->lineType=='*')
+    {
+      for(;p<end && *p!='\n';p++)
+      {
+        if((unsigned)(*p-'0')<10)
+        {
+          if((rsc->number=rsc->number*10+(*p-'0'))>RESPMAXBULK)
+          {
+            rsc->errorMsg="RESP length too long";
+            return(RAMISFAIL);
+          }
+        }
+        else
+        if(*p=='-')
+          rsc->negative=1;
+        else
+        if(*p!='\r')
+        {
+          rsc->errorMsg="RESP invalid length";
+          return(RAMISFAIL);
+        }
+      }
+      if(p==end)
+        break;
+      p++;
+      if(rsc->negative) // a NULL bulk string or array
+        valueDone(rsc);
+      else
+      if(rsc->lineType=='$')
+        rsc->bulkLeft=rsc->number+2;
+      else
+      {
+        rsc->pending+=rsc->number;
+        valueDone(rsc); // the array header itself
+      }
+      continue;
+    }
+
+    // the rest of a simple string, error, integer or inline command line
+    nl=memchr(p,'\n',end-p);
+    n=(nl?nl:end)-p;
+    if(rsc->topError && rsc->pending==1 && !rsc->nErrors && rsc->firstErrorLen<RESPLOADERRLEN-1)
+    {
+      size_t take=n<RESPLOADERRLEN-1-rsc->firstErrorLen?n:RESPLOADERRLEN-1-rsc->firstErrorLen;
+
+      memcpy(rsc->firstError+rsc->firstErrorLen,p,take);
+      rsc->firstErrorLen+=take;
+      while(rsc->firstErrorLen && rsc->firstError[rsc->firstErrorLen-1]=='\r')
+        rsc->firstErrorLen--;
+      rsc->firstError[rsc->firstErrorLen]='\0';
+    }
+    if(!nl)
+      break;
+    p=nl+1;
+    if(rsc->lineType=='E')
+    {
+      rsc->lineType=0;
+      rsc->pending=0;
+    }
+    else
+      valueDone(rsc);
+  }
+  return(RAMISOK);
+}
+
+
+/* ********************************** loading ******************************* */
+
+// adds n bytes to the output, growing it
+static int
+appendOut(byte **bufp,size_t *bufSzp,size_t *usedp,const char *bytes,size_t n)
+{
+  if(*usedp+n>*bufSzp)
+  {
+    byte *newBuf=ramisRealloc(*bufp,*usedp+n+RESPLOADHIGHWATER);
+
+    if(!newBuf)
+      return(RAMISFAIL);
+    *bufp=newBuf;
+    *bufSzp=*usedp+n+RESPLOADHIGHWATER;
+  }
+  memcpy(*bufp+*usedp,bytes,n);
+  *usedp+=n;
+  return(RAMISOK);
+}
+
+// the server may have commands and replies in flight, so the connection is replaced
+static int
+loadFailed(RESPCLIENT *rcp,RESPLOADSTATS *stats,uint64_t start,char *errorMsg,byte *out)
+{
+  stats->elapsedNs=respTraceNow()-start;
+  if(out)
+    ramisFree(out);
+  reconnectRespServer(rcp);
+  rcp->rppFrom->errorMsg=errorMsg;
+  return(RAMISFAIL);
+}
+
+int
+respBulkLoad(RESPCLIENT *rcp,respLoadGenerator gen,void *genData,int flags,RESPLOADSTATS *stats)
+{
+  RESPLOADSCANNER cmds,replies;
+  byte       *out=NULL;
+  size_t      outSz=0,outUsed=0,outSent=0;
+  uint64_t    expected,start=respTraceNow();
+  ssize_t     n;
+  int         genDone=0,fdFlags;
+  struct pollfd pfd;
+
+  memset(stats,0,sizeof(RESPLOADSTATS));
+  rcp->rppFrom->errorMsg=NULL;
+  if(rcp->pendUsed || rcp->fromKept)
+  {
+    rcp->rppFrom->errorMsg="Commands are waiting on replies in respBulkLoad()";
+    return(RAMISFAIL);
+  }
+  if(rcp->socket<0)
+  {
+    rcp->rppFrom->errorMsg="Not connected to the server";
+    return(RAMISFAIL);
+  }
+  respLoadScanInit(&cmds,1);
+  respLoadScanInit(&replies,0);
+  if((flags&RESPLOADREPLYOFF) && !appendOut(&out,&outSz,&outUsed,replyOff,sizeof(replyOff)-1))
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respBulkLoad()";
+    return(RAMISFAIL);
+  }
+
+  fdFlags=fcntl(rcp->socket,F_GETFL);
+  fcntl(rcp->socket,F_SETFL,fdFlags|O_NONBLOCK);
+  pfd.fd=rcp->socket;
+  for(;;)
+  {
+    while(!genDone && outUsed-outSent<RESPLOADHIGHWATER)
+    {
+      if(outSent) // what's been sent makes room at the front
+      {
+        memmove(out,out+outSent,outUsed-outSent);
+        outUsed-=outSent;
+        outSent=0;
+      }
+      if((n=(*gen)(genData,&out,&outSz,outUsed))<0)
+        return(loadFailed(rcp,stats,start,"The generator failed in respBulkLoad()",out));
+      if(!n)
+      {
+        genDone=1;
+        if(cmds.pending || cmds.lineType)
+          return(loadFailed(rcp,stats,start,"The input ends partway through a command",out));
+        if((flags&RESPLOADREPLYOFF) && !appendOut(&out,&outSz,&outUsed,replyOn,sizeof(replyOn)-1))
+          return(loadFailed(rcp,stats,start,"Memory allocation error in respBulkLoad()",out));
+        break;
+      }
+      if(!respLoadScan(&cmds,out+outUsed,n))
+        return(loadFailed(rcp,stats,start,cmds.errorMsg,out));
+      outUsed+=n;
+    }
+    stats->commands=cmds.nValues;
+
+    if(flags&RESPLOADREPLYOFF)
+      expected=genDone;
+    else
+      expected=cmds.nValues;
+    if(genDone && outSent==outUsed && replies.nValues>=expected)
+      break;
+
+    pfd.events=POLLIN|(outSent<outUsed?POLLOUT:0);
+    pfd.revents=0;
+    n=poll(&pfd,1,RESPLOADSTALLSECS*1000);
+    if(rcp->metrics)
+      rcp->metrics->pollCalls++;
+    if(n<0 && errno==EINTR)
+      continue;
+    if(n<=0)
+    {
+      if(rcp->metrics)
+        rcp->metrics->timeouts+=!n;
+      return(loadFailed(rcp,stats,start,n?strerror(errno):"Timeout loading data to the server",out));
+    }
+
+    if(pfd.revents&(POLLIN|POLLHUP|POLLERR))
+    {
+      n=recv(rcp->socket,rcp->fromBuf,rcp->fromBufSize,0);
+      if(n<0 && (errno==EAGAIN || errno==EINTR))
+        continue;
+      if(rcp->metrics)
+      {
+        rcp->metrics->recvCalls++;
+        rcp->metrics->bytesIn+=n>0?n:0;
+      }
+      if(n<=0)
+        return(loadFailed(rcp,stats,start,n?strerror(errno):"Server closed the connection",out));
+      if(rcp->capture)
+        respCaptureFrame(rcp->capture,RESPCAPREPLY,rcp->fromBuf,n);
+      stats->bytesIn+=n;
+      if(!respLoadScan(&replies,rcp->fromBuf,n))
+        return(loadFailed(rcp,stats,start,replies.errorMsg,out));
+      stats->replies=replies.nValues;
+      stats->errors=replies.nErrors;
+      if(replies.nErrors && !*stats->firstError) // once its line is complete
+        strcpy(stats->firstError,replies.firstError);
+    }
+    if((pfd.revents&POLLOUT) && outSent<outUsed)
+    {
+      n=send(rcp->socket,out+outSent,outUsed-outSent,LOADSENDFLAGS);
+      if(n<0 && (errno==EAGAIN || errno==EINTR))
+        continue;
+      if(rcp->metrics)
+      {
+        rcp->metrics->sendCalls++;
+        rcp->metrics->bytesOut+=n>0?n:0;
+      }
+      if(n<=0)
+        return(loadFailed(rcp,stats,start,"Send to server socket failed",out));
+      if(rcp->capture)
+        respCaptureFrame(rcp->capture,RESPCAPCOMMAND,out+outSent,n);
+      outSent+=n;
+      stats->bytesOut+=n;
+    }
+  }
+
+  fcntl(rcp->socket,F_SETFL,fdFlags);
+  if(out)
+    ramisFree(out);
+  stats->elapsedNs=respTraceNow()-start;
+  return(RAMISOK);
+}
+
+static ssize_t
+fdGenerator(void *genData,byte **bufp,size_t *bufSzp,size_t used)
+{
+  ssize_t n;
+
+  if(used+LOADREADSZ>*bufSzp)
+  {
+    byte *newBuf=ramisRealloc(*bufp,used+LOADREADSZ);
+
+    if(!newBuf)
+      return(-1);
+    *bufp=newBuf;
+    *bufSzp=used+LOADREADSZ;
+  }
+  while((n=read(*(int *)genData,*bufp+used,*bufSzp-used))<0 && errno==EINTR);
+  return(n);
+}
+
+int
+respBulkLoadFd(RESPCLIENT *rcp,int fd,int flags,RESPLOADSTATS *stats)
+{
+  return(respBulkLoad(rcp,fdGenerator,&fd,flags,stats));
+}
@@ -0,0 +1,71 @@
+//
+//  resp_load.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Mass insertion. Already encoded commands are streamed to the server in big writes while
+//  the replies are read back at the same time, so neither side waits on the other. Replies
+//  are never parsed into items. A scanner walks the bytes and only counts top level replies
+//  and which of them were errors, it keeps nothing but the text of the first error.
+//
+
+#ifndef resp_load_h
+#define resp_load_h
+#include <stdint.h>
+#include <sys/types.h>
+#include "respClient.h"
+
+#define RESPLOADREPLYOFF   1          // run with CLIENT REPLY OFF, errors aren't seen
+#define RESPLOADHIGHWATER  (256*1024) // commands are generated until this much is waiting to go
+#define RESPLOADSTALLSECS  30         // give up when the server takes and sends nothing for this long
+#define RESPLOADERRLEN     128        // room for the first error reply's text
+
+// counts the top level values in a RESP byte stream given in pieces of any size
+#define RESPLOADSCANNER struct respLoadScannerStruct
+RESPLOADSCANNER
+{
+  uint64_t nValues;      // complete top level values, replies or commands
+  uint64_t nErrors;      // top level error replies among them
+  int64_t  pending;      // values still to come in the one being scanned, 0 between them
+  int64_t  bulkLeft;     // payload and CRLF bytes left to skip
+  int64_t  number;       // the length on a '$' or '*' line being read
+  char     lineType;     // the type byte of the line being read, 0 at the start of one
+  char     negative;     // the number is -1, a NULL
+  char     topError;     // the value being scanned is an error reply
+  char     requests;     // lines that aren't RESP are inline commands, for scanning what's sent
+  char     firstError[RESPLOADERRLEN];
+  size_t   firstErrorLen;
+  char    *errorMsg;     // NULL if all's ok
+};
+
+#define RESPLOADSTATS struct respLoadStatsStruct
+RESPLOADSTATS
+{
+  uint64_t commands;     // sent, from scanning what the generator made
+  uint64_t replies;      // top level replies read, just the one to CLIENT REPLY ON with RESPLOADREPLYOFF
+  uint64_t errors;       // error replies
+  uint64_t bytesOut;
+  uint64_t bytesIn;
+  uint64_t elapsedNs;
+  char     firstError[RESPLOADERRLEN]; // the text of the first error reply, "" if there wasn't one
+};
+
+// appends encoded commands to *bufp at offset used, growing it, as respEncodeInto() does.
+// Returns the number of bytes appended, 0 when there are no more or -1 on error
+typedef ssize_t (*respLoadGenerator)(void *genData,byte **bufp,size_t *bufSzp,size_t used);
+
+// sets up a scanner for replies, or commands if requests isn't 0
+void respLoadScanInit(RESPLOADSCANNER *rsc,int requests);
+
+// scans the next len bytes of the stream. RAMISFAIL with errorMsg set if they aren't RESP
+int respLoadScan(RESPLOADSCANNER *rsc,const byte *buf,size_t len);
+
+// sends what gen makes to the server until it returns 0 and all the replies are in. The client
+// can't have replies outstanding. A failure resets the connection, stats says how far it got
+int respBulkLoad(RESPCLIENT *rcp,respLoadGenerator gen,void *genData,int flags,RESPLOADSTATS *stats);
+
+// the same with commands read from fd, a file or the output of a generator program
+int respBulkLoadFd(RESPCLIENT *rcp,int fd,int flags,RESPLOADSTATS *stats);
+
+#endif /* resp_load_h */
@@ -0,0 +1,277 @@
+//
+//  resp_metrics.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The histograms are log linear like HdrHistogram: values under RESPHISTSUB get a bucket
+//  each, above that every power of two is split into RESPHISTSUB equal buckets. Recording
+//  is a count leading zeros, a shift and an increment. A value is filed by one less than
+//  itself so each bucket includes its upper bound, as Prometheus' le buckets do.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "resp_metrics.h"
+
+#define PROMPREFIX   "ramis_client_"
+#define PROMMINBIT   10 // Prometheus buckets are powers of two from about 1us
+#define PROMMAXBIT   34 // to about 17s
+
+
+/* ******************************** histograms ****************************** */
+
+static inline int
+histBucket(uint64_t v)
+{
+  int msb;
+
+  if(v<RESPHISTSUB)
+    return((int)v);
+  msb=63-__builtin_clzll(v);
+  if(msb>RESPHISTMAXBIT)
+    return(RESPHISTBUCKETS-1);
+  return((msb-RESPHISTSUBBITS+1)*RESPHISTSUB+(int)((v>>(msb-RESPHISTSUBBITS))&(RESPHISTSUB-1)));
+}
+
+// the smallest value that goes in bucket b
+static uint64_t
+bucketLow(int b)
+{
+  int group=b/RESPHISTSUB;
+
+  if(!group)
+    return((uint64_t)b);
+  return((uint64_t)(RESPHISTSUB+b%RESPHISTSUB)<<(group-1));
+}
+
+void
+respHistRecord(RESPHIST *h,uint64_t ns)
+{
+  ++h->buckets[histBucket(ns?ns-1:0)]; // bucket b holds bucketLow(b)+1 to bucketLow(b+1)
+  ++h->count;
+  h->sumNs+=ns;
+  if(ns>h->maxNs)
+    h->maxNs=ns;
+}
+
+uint64_t
+respHistPercentile(const RESPHIST *h,double p)
+{
+  uint64_t rank,seen=0,high;
+  int b;
+
+  if(!h->count)
+    return(0);
+  rank=(uint64_t)(p*h->count+0.5);
+  if(rank<1)
+    rank=1;
+  for(b=0;b<RESPHISTBUCKETS;b++)
+  {
+    seen+=h->buckets[b];
+    if(seen>=rank)
+      break;
+  }
+  if(b>=RESPHISTBUCKETS-1)
+    return(h->maxNs);
+  high=bucketLow(b+1); // the highest value the bucket stands for
+  return(high<h->maxNs?high:h->maxNs);
+}
+
+
+/* ********************************* metrics ******************************** */
+
+RESPMETRICS *
+freeRespMetrics(RESPMETRICS *rmp)
+{
+  int i;
+
+  if(rmp)
+  {
+    if(rmp->latency)
+    {
+      for(i=0;i<rmp->nLatency;i++)
+        if(rmp->latency[i])
+          ramisFree(rmp->latency[i]);
+      ramisFree(rmp->latency);
+    }
+    ramisFree(rmp);
+  }
+  return(NULL);
+}
+
+RESPMETRICS *
+newRespMetrics(void)
+{
+  RESPMETRICS *rmp=ramisCalloc(1,sizeof(RESPMETRICS));
+
+  if(!rmp)
+    return(NULL);
+  rmp->nLatency=ramisCommandCount()+1;
+  rmp->latency=ramisCalloc(rmp->nLatency,sizeof(RESPHIST *));
+  if(!rmp->latency)
+    return(freeRespMetrics(rmp));
+  rmp->pendingCommand=-1;
+  return(rmp);
+}
+
+void
+respMetricsReset(RESPMETRICS *rmp)
+{
+  RESPHIST **latency=rmp->latency;
+  int i,nLatency=rmp->nLatency;
+
+  for(i=0;i<nLatency;i++)
+    if(latency[i])
+      memset(latency[i],0,sizeof(RESPHIST));
+  memset(rmp,0,sizeof(RESPMETRICS));
+  rmp->latency=latency;
+  rmp->nLatency=nLatency;
+  rmp->pendingCommand=-1;
+}
+
+int
+respMetricsMerge(RESPMETRICS *dst,const RESPMETRICS *src)
+{
+  int i,b;
+
+  dst->requests+=src->requests;
+  dst->replies+=src->replies;
+  dst->errorReplies+=src->errorReplies;
+  dst->bytesOut+=src->bytesOut;
+  dst->bytesIn+=src->bytesIn;
+  dst->sendCalls+=src->sendCalls;
+  dst->recvCalls+=src->recvCalls;
+  dst->pollCalls+=src->pollCalls;
+  dst->timeouts+=src->timeouts;
+  dst->reconnects+=src->reconnects;
+  dst->bufGrowths+=src->bufGrowths;
+  dst->itemGrowths+=src->itemGrowths;
+
+  for(i=0;i<src->nLatency && i<dst->nLatency;i++)
+  {
+    RESPHIST *from=src->latency[i];
+    RESPHIST *to;
+
+    if(!from || !from->count)
+      continue;
+    if(!(to=dst->latency[i]) && !(to=dst->latency[i]=ramisCalloc(1,sizeof(RESPHIST))))
+      return(RAMISFAIL);
+    for(b=0;b<RESPHISTBUCKETS;b++)
+      to->buckets[b]+=from->buckets[b];
+    to->count+=from->count;
+    to->sumNs+=from->sumNs;
+    if(from->maxNs>to->maxNs)
+      to->maxNs=from->maxNs;
+  }
+  return(RAMISOK);
+}
+
+// the command name is the first bulk string of "*N\r\n$L\r\nNAME\r\n..."
+static int
+requestCommandIndex(RESPMETRICS *rmp,const uint8_t *buf,size_t n)
+{
+  const uint8_t *p=buf,*end=buf+n;
+  RAMISCMD *cmd;
+  size_t len=0;
+
+  if(n<4 || *p!='*' || !(p=memchr(p,'\n',n)) || ++p>=end || *p!='$')
+    return(rmp->nLatency-1);
+  for(++p;p<end && isdigit(*p);p++)
+    len=len*10+(*p-'0');
+  p+=2;
+  if(p+len>end || !(cmd=ramisFindCommand((const char *)p,(unsigned int)len)))
+    return(rmp->nLatency-1);
+  return(ramisCommandIndex(cmd));
+}
+
+void
+respMetricsRequestSent(RESPMETRICS *rmp,const uint8_t *buf,size_t n)
+{
+  ++rmp->requests;
+  if(rmp->pendingCommand>=0) // pipelined behind one that's still being timed
+    return;
+  rmp->pendingCommand=requestCommandIndex(rmp,buf,n);
+  clock_gettime(CLOCK_MONOTONIC,&rmp->pendingStart);
+}
+
+void
+respMetricsReplyDone(RESPMETRICS *rmp)
+{
+  struct timespec now;
+  RESPHIST *h;
+  int64_t ns;
+
+  if(rmp->pendingCommand<0)
+    return;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  ns=(int64_t)(now.tv_sec-rmp->pendingStart.tv_sec)*1000000000LL+(now.tv_nsec-rmp->pendingStart.tv_nsec);
+  h=rmp->latency[rmp->pendingCommand];
+  if(!h)
+    h=rmp->latency[rmp->pendingCommand]=ramisCalloc(1,sizeof(RESPHIST));
+  if(h) // without memory for the histogram the sample is dropped
+    respHistRecord(h,ns>0?(uint64_t)ns:0);
+  rmp->pendingCommand=-1;
+}
+
+
+/* ******************************** Prometheus ****************************** */
+
+static void
+promCounter(FILE *fh,const char *name,const char *help,const char *labels,uint64_t value)
+{
+  fprintf(fh,"# HELP " PROMPREFIX "%s %s\n",name,help);
+  fprintf(fh,"# TYPE " PROMPREFIX "%s counter\n",name);
+  fprintf(fh,PROMPREFIX "%s%s%s%s %llu\n",name,labels?"{":"",labels?labels:"",labels?"}":"",(unsigned long long)value);
+}
+
+int
+respMetricsPrometheus(const RESPMETRICS *rmp,FILE *fh,const char *labels)
+{
+  const char *sep=labels?",":"";
+  int i,b,bit;
+
+  if(labels && !*labels)
+    labels=NULL,sep="";
+
+  promCounter(fh,"requests_total","Writes of one or more commands",labels,rmp->requests);
+  promCounter(fh,"replies_total","Replies received",labels,rmp->replies);
+  promCounter(fh,"error_replies_total","Error replies received",labels,rmp->errorReplies);
+  promCounter(fh,"sent_bytes_total","Bytes sent",labels,rmp->bytesOut);
+  promCounter(fh,"received_bytes_total","Bytes received",labels,rmp->bytesIn);
+  promCounter(fh,"send_calls_total","send() calls",labels,rmp->sendCalls);
+  promCounter(fh,"recv_calls_total","recv() calls",labels,rmp->recvCalls);
+  promCounter(fh,"poll_calls_total","poll() calls",labels,rmp->pollCalls);
+  promCounter(fh,"timeouts_total","Reads that timed out",labels,rmp->timeouts);
+  promCounter(fh,"reconnects_total","Connections given up on",labels,rmp->reconnects);
+  promCounter(fh,"buffer_growths_total","Receive buffer reallocations",labels,rmp->bufGrowths);
+  promCounter(fh,"item_growths_total","Parser item list reallocations",labels,rmp->itemGrowths);
+
+  fprintf(fh,"# HELP " PROMPREFIX "command_duration_seconds Time from sending a command to its reply\n");
+  fprintf(fh,"# TYPE " PROMPREFIX "command_duration_seconds histogram\n");
+  for(i=0;i<rmp->nLatency;i++)
+  {
+    const RESPHIST *h=rmp->latency[i];
+    const char *name;
+    uint64_t cumulative=0;
+
+    if(!h || !h->count)
+      continue;
+    name=i<rmp->nLatency-1?ramisCommandAt(i)->command:"unknown";
+    for(b=0,bit=PROMMINBIT;bit<=PROMMAXBIT;bit++)
+    {
+      for(;b<histBucket((uint64_t)1<<bit);b++) // everything up to and including 2^bit
+        cumulative+=h->buckets[b];
+      fprintf(fh,PROMPREFIX "command_duration_seconds_bucket{%s%scommand=\"%s\",le=\"%.12g\"} %llu\n",
+              labels?labels:"",sep,name,(double)((uint64_t)1<<bit)/1e9,(unsigned long long)cumulative);
+    }
+    fprintf(fh,PROMPREFIX "command_duration_seconds_bucket{%s%scommand=\"%s\",le=\"+Inf\"} %llu\n",labels?labels:"",sep,name,(unsigned long long)h->count);
+    fprintf(fh,PROMPREFIX "command_duration_seconds_sum{%s%scommand=\"%s\"} %.9f\n",labels?labels:"",sep,name,h->sumNs/1e9);
+    fprintf(fh,PROMPREFIX "command_duration_seconds_count{%s%scommand=\"%s\"} %llu\n",labels?labels:"",sep,name,(unsigned long long)h->count);
+  }
+  return(ferror(fh)?RAMISFAIL:RAMISOK);
+}
@@ -0,0 +1,79 @@
+//
+//  resp_metrics.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Counters and per command latency histograms kept by a client while metrics are on.
+//  A client is only used by one thread at a time so they're plain integers, no atomics.
+//  Take a snapshot to read them and merge snapshots to add up several clients.
+//
+
+#ifndef resp_metrics_h
+#define resp_metrics_h
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// log linear buckets, 2^RESPHISTSUBBITS per power of two, about 6% resolution
+#define RESPHISTSUBBITS   4
+#define RESPHISTSUB       (1<<RESPHISTSUBBITS)
+#define RESPHISTMAXBIT    40 // about 18 minutes in nanoseconds, longer lands in the last bucket
+#define RESPHISTBUCKETS   ((RESPHISTMAXBIT-RESPHISTSUBBITS+2)*RESPHISTSUB)
+
+#define RESPHIST struct respHistStruct
+RESPHIST
+{
+  uint64_t count;
+  uint64_t sumNs;
+  uint64_t maxNs;
+  uint64_t buckets[RESPHISTBUCKETS];
+};
+
+#define RESPMETRICS struct respMetricsStruct
+RESPMETRICS
+{
+  uint64_t requests;      // writes of one or more commands
+  uint64_t replies;       // complete top level replies parsed
+  uint64_t errorReplies;  // replies that were errors from the server
+  uint64_t bytesOut;
+  uint64_t bytesIn;
+  uint64_t sendCalls;     // send() syscalls
+  uint64_t recvCalls;     // recv() syscalls
+  uint64_t pollCalls;     // poll() syscalls
+  uint64_t timeouts;
+  uint64_t reconnects;    // connections given up on
+  uint64_t bufGrowths;    // receive buffer reallocs, from the parser's counter
+  uint64_t itemGrowths;   // items list reallocs, from the parser's counter
+  RESPHIST **latency;     // by ramisCommandIndex(), the last one is for unknown commands
+  int       nLatency;
+
+  // the command being timed, if any
+  int             pendingCommand;
+  struct timespec pendingStart;
+};
+
+RESPMETRICS * newRespMetrics(void);
+RESPMETRICS * freeRespMetrics(RESPMETRICS *rmp);
+
+// zeroes everything, keeping the histograms that are allocated
+void respMetricsReset(RESPMETRICS *rmp);
+
+// adds the counts in src to dst. RAMISFAIL on allocation error
+int respMetricsMerge(RESPMETRICS *dst,const RESPMETRICS *src);
+
+// starts timing a request that was just sent, buf is the RESP encoded command
+void respMetricsRequestSent(RESPMETRICS *rmp,const uint8_t *buf,size_t n);
+
+// stops timing, the reply to the request has arrived
+void respMetricsReplyDone(RESPMETRICS *rmp);
+
+void respHistRecord(RESPHIST *h,uint64_t ns);
+
+// the latency at or under which fraction p (0..1) of the samples fall, in nanoseconds
+uint64_t respHistPercentile(const RESPHIST *h,double p);
+
+// writes the metrics in Prometheus text format. labels like client="cache" may be NULL
+int respMetricsPrometheus(const RESPMETRICS *rmp,FILE *fh,const char *labels);
+
+#endif /* resp_metrics_h */
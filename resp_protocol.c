@@ -12,13 +12,14 @@
 //
 // One major difference is that this handler includes floating point. The way
 // it differentiates between an integer and a floating point value is if it
-// sees a decimal point '.' within a numeric field
+// sees a decimal point '.' or an exponent within a numeric field
 //
 
 //#define NEWCOMMAND 1 // uncomment to regenerate skeleton code and headers
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <strings.h>
 #include <string.h>
 #include <unistd.h>
@@ -77,6 +78,104 @@ resetResProto(RESPROTO *rpp)
   }
 }
 
+// parses an optionally signed decimal integer. Nearly every field has one so this is kept to a
+// loop over the digits, anything too long to be sure of is left to strtoll() which clamps it
+// returns pointer to the end of the number or NULL if there are no digits
+static inline byte *
+parseRespInteger(byte *s,int64_t *pint)
+{
+  byte    *p=s;
+  uint64_t v=0;
+  int      neg=0,nDigits;
+  
+  if(*p=='-' || *p=='+')
+    neg=*p++=='-';
+  for(nDigits=0;(unsigned)(*p-'0')<10;p++,nDigits++)
+    v=v*10+(*p-'0');
+  if(!nDigits)
+    return(NULL);
+  if(nDigits>18) // might have overflowed
+  {
+    *pint=(int64_t)strtoll((char *)s,(char **)&p,10);
+    return(p);
+  }
+  *pint=neg?-(int64_t)v:(int64_t)v;
+  return(p);
+}
+
+// powers of ten that are exact as doubles
+static const double respExactPow10[]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+#define RESPMAXEXACTPOW10 22
+#define RESPMAXEXACTMANT  (1ULL<<53)
+
+// parses a floating point number. When the digits fit in a double's mantissa and the power of ten
+// is exact, one multiply or divide is correctly rounded (Clinger's fast path), which covers what
+// servers send like scores and INCRBYFLOAT results. Everything else is handed to strtod()
+static byte *
+parseRespFloat(byte *s,double *pfloat)
+{
+  byte    *p=s;
+  uint64_t mant=0;
+  int      neg=0,nDigits=0,exp10=0,expSign=1,exp=0;
+  
+  if(*p=='-' || *p=='+')
+    neg=*p++=='-';
+  for(;(unsigned)(*p-'0')<10;p++)
+  {
+    if(mant || *p!='0') // leading zeros aren't significant
+      nDigits++;
+    mant=mant*10+(*p-'0');
+    if(nDigits>19)
+      goto slowPath;
+  }
+  if(*p=='.')
+    for(++p;(unsigned)(*p-'0')<10;p++)
+    {
+      if(mant || *p!='0')
+        nDigits++;
+      mant=mant*10+(*p-'0');
+      exp10--;
+      if(nDigits>19)
+        goto slowPath;
+    }
+  if(*p=='e' || *p=='E')
+  {
+    byte *e=p+1;
+    
+    if(*e=='-' || *e=='+')
+      expSign=*e++=='-'?-1:1;
+    if((unsigned)(*e-'0')<10) // otherwise the 'e' isn't part of the number
+    {
+      for(;(unsigned)(*e-'0')<10 && exp<10000;e++)
+        exp=exp*10+(*e-'0');
+      if((unsigned)(*e-'0')<10)
+        goto slowPath;
+      exp10+=expSign*exp;
+      p=e;
+    }
+  }
+  
+  if(mant>RESPMAXEXACTMANT)
+    goto slowPath;
+  if(!mant)
+    *pfloat=0.0;
+  else
+  if(exp10>=0 && exp10<=RESPMAXEXACTPOW10)
+    *pfloat=(double)mant*respExactPow10[exp10];
+  else
+  if(exp10<0 && exp10>=-RESPMAXEXACTPOW10)
+    *pfloat=(double)mant/respExactPow10[-exp10];
+  else
+    goto slowPath;
+  if(neg)
+    *pfloat=-*pfloat;
+  return(p);
+  
+slowPath:
+  *pfloat=strtod((char *)s,(char **)&p);
+  return(p);
+}
+
 // looks at what's supposed to be a number and converts it into *pfloat or *pint
 // returns pointer to end of number on success, returns NULL if failure
 // *pfloat will be set to Nan if it's an integer
@@ -84,36 +183,31 @@ resetResProto(RESPROTO *rpp)
 static byte *
 parseRespNumber(RESPROTO *rp,byte *s,double *pfloat,int64_t *pint)
 {
+ byte *end=parseRespInteger(s,pint);
+ byte *intEnd;
  
- byte *p=s;
- byte   *endOfInt=NULL;
- byte   *endOfFloat=NULL;
- byte   *end;
- 
- *pint=(int64_t)strtoll((char *)p,(char **)&endOfInt,10); // cast because of long long def
-
- if(endOfInt==NULL || endOfInt==p)  // the int part should have parsed even if it was a floating pt val
+ if(end==NULL)  // the int part should have parsed even if it was a floating pt val
  {
    *pfloat=NAN;
    rp->errorMsg=("RESP unreconizable integer in numeric field");
    return(NULL);
  }
  
- *pfloat=strtod((char *)p,(char **)&endOfFloat);
- 
- 
- if(endOfFloat==endOfInt) // a floating point string encoding the same value must be longer
+ if(*end!='.' && *end!='e' && *end!='E')
  {
-     *pfloat=NAN;
-     end=endOfInt;
+   *pfloat=NAN;
+   return(end);
  }
- else end=endOfFloat;
  
+ intEnd=end;
+ end=parseRespFloat(s,pfloat);
  if(end==NULL)
  {
    rp->errorMsg="RESP unreconizable numeric value in field";
    return(NULL);
  }
+ if(end==intEnd) // a dangling 'e' or the like, it's just an integer
+   *pfloat=NAN;
    
  return(end);
 }
@@ -142,9 +236,10 @@ isThereEOL(byte *s,byte *end)
   int sawCR=0;
   while(s<end)
   {
-    if(*s=='\0') // null terminated from a prior parse
+    if(*s=='\0') // null terminated from a prior parse, only the LF of its CRLF can follow
     {
-      while(s<end && (*s=='\0' || *s=='\x0a'))
+      ++s;
+      if(s<end && *s=='\n')
          ++s;
       return(s);
     }
@@ -209,6 +304,7 @@ growRespInItems(RESPROTO *rpp)
    }
    rpp->items=newItems;
    rpp->maxItems=newMaxItems;
+   rpp->nItemGrowths++;
    return(1);
 }
 
@@ -219,6 +315,10 @@ static void
 reinitRESP(RESPROTO *rp,byte *buf,size_t bufLen)
 {
    rp->nItems=0;
+   rp->arrayDepth=0;
+   rp->nReplies=0;
+   rp->nReplyItems=0;
+   rp->replyEnd=buf;
    rp->buf=rp->currPointer=buf;
    rp->bufEnd=buf+bufLen;
    rp->errorMsg=NULL;
@@ -230,19 +330,27 @@ respBufRealloc(RESPROTO *rp,byte *oldBuffer,size_t newSize)
 {
   int i;
   byte *newBuffer=ramisRealloc(oldBuffer,newSize);
+  if(newBuffer)
+    rp->nBufGrowths++;
   if(newBuffer && newBuffer!=oldBuffer) // the latter clause is because calloc may return same region
   {
       rp->currPointer= newBuffer + (rp->currPointer-oldBuffer);
       rp->bufEnd=(newBuffer) + (rp->bufEnd-oldBuffer);
+      rp->replyEnd=(newBuffer) + (rp->replyEnd-oldBuffer);
       rp->buf=newBuffer;
     
       // now we have to make all the already parsed pointers valid again
       for(i=0;i<rp->nItems;i++)
-         if(rp->items[i].respType==RESPISSTR || rp->items[i].respType==RESPISBULKSTR || rp->items[i].respType==RESPISPLAINTXT)
-            rp->items[i].loc=newBuffer + (rp->items[i].loc-oldBuffer);
+         switch(rp->items[i].respType)
+         {
+            case RESPISSTR: case RESPISBULKSTR: case RESPISPLAINTXT:
+            case RESPISERRORMSG: case RESPISINT: case RESPISFLOAT:
+               rp->items[i].loc=newBuffer + (rp->items[i].loc-oldBuffer);
+         }
      
   }
-  else rp->errorMsg="Failed attempt to grow recieve buffer size in respBufRealloc()";
+  else if(!newBuffer) // growing in place is fine
+     rp->errorMsg="Failed attempt to grow recieve buffer size in respBufRealloc()";
   
   return(newBuffer);
 }
@@ -369,7 +477,7 @@ convertRespPlaintext(RESPROTO *rpp,byte *p,byte *end)
       
       parseRespNumber(rpp,p,&floatingpoint,&integer);
       
-      if(floatingpoint==NAN)
+      if(isnan(floatingpoint))
       {
         thisItem->respType=RESPISINT;
         thisItem->rinteger=integer;
@@ -414,6 +522,27 @@ decrementArray(RESPROTO *rpp)
  
 }
 
+// returns how many items make up the value at items[first], counting the members of arrays
+// and their nested arrays, or 0 if the items end before the value does
+int
+respReplySpan(RESPITEM *items,int nItems,int first)
+{
+  int i=first;
+  uint64_t needed=1;
+  
+  while(needed)
+  {
+    if(i>=nItems)
+      return(0);
+    --needed;
+    if(items[i].respType==RESPISARRAY)
+      needed+=items[i].nItems;
+    ++i;
+  }
+  return(i-first);
+}
+
+
 // sets the error message and returns the error code
 static int
 respParseError(RESPROTO *rpp,char *str)
@@ -490,9 +619,17 @@ parseResProto(RESPROTO *rpp,byte *buf,size_t bufLen,int newBuffer)
          {
             thisItem->respType=RESPISARRAY;
 
-            if(!parseRespNumber(rpp,p+1,&floatingPoint,&integer))
+            if(!parseRespInteger(p+1,&integer))
                return(respParseError(rpp,"RESP invalid integer array length after '*'"));
 
+            decrementArray(rpp); // the array is itself a member of any enclosing array
+            if(integer<0) // NULL array, e.g. EXEC after a WATCHed key changed
+            {
+               thisItem->respType=RESPISNULL;
+               thisItem->loc=NULL;
+               ++rpp->nItems;
+               break;
+            }
             thisItem->length=integer;
             if(thisItem->length!=0) // if it's not the 0 length array
             {
@@ -502,7 +639,6 @@ parseResProto(RESPROTO *rpp,byte *buf,size_t bufLen,int newBuffer)
                rpp->arrayNest[rpp->arrayDepth++]=(uint32_t)integer;
             }
             ++rpp->nItems;
-            decrementArray(rpp); // PBR added March 30th 2021 to solve a conflicting understanding with RESP docs
             break;
          }
          case '+': // simple string
@@ -519,7 +655,7 @@ parseResProto(RESPROTO *rpp,byte *buf,size_t bufLen,int newBuffer)
             if(!parseRespNumber(rpp,p+1,&floatingPoint,&integer))
                return(respParseError(rpp,"RESP non-integer or non-floating point value in numeric ':' field"));
             
-            if(strchr((char *)p,'.'))
+            if(!isnan(floatingPoint))
             {
               thisItem->rfloat=floatingPoint;
               thisItem->loc=p;
@@ -546,7 +682,7 @@ parseResProto(RESPROTO *rpp,byte *buf,size_t bufLen,int newBuffer)
          }
          case '$':                  // bulk string
          {
-            if(!parseRespNumber(rpp,p+1,&floatingPoint,&integer))
+            if(!parseRespInteger(p+1,&integer))
                return(respParseError(rpp,"RESP invalid integer length in bulk string ($N\\r\\n)"));
             
             if(integer==-1) // NULL Reply
@@ -565,7 +701,10 @@ parseResProto(RESPROTO *rpp,byte *buf,size_t bufLen,int newBuffer)
             {
               byte *testEol=isThereEOL(nextItem+integer,end);
               if(!testEol)
+              {
+                  rpp->currPointer=restoreTo;
                   return(RESP_PARSE_INCOMPLETE);
+              }
               else
                   {
                      thisItem->loc=nextItem;
@@ -575,7 +714,8 @@ parseResProto(RESPROTO *rpp,byte *buf,size_t bufLen,int newBuffer)
                      break;
                   }
             }
-            else return(RESP_PARSE_INCOMPLETE);
+            rpp->currPointer=restoreTo; // come back to the $N header when the payload has arrived
+            return(RESP_PARSE_INCOMPLETE);
          }
          default :                  // could be an ascii command string for the server
          {
@@ -590,12 +730,302 @@ parseResProto(RESPROTO *rpp,byte *buf,size_t bufLen,int newBuffer)
          }
      }
      restoreTo=p=nextItem;
+     if(!rpp->arrayDepth) // a top level reply has been completed
+     {
+        rpp->nReplies++;
+        rpp->nReplyItems=rpp->nItems;
+        rpp->replyEnd=p;
+        if(rpp->maxReplies && rpp->nReplies>=rpp->maxReplies) // what's after it is left for later
+          break;
+     }
    }
+   rpp->currPointer=p;     // so a later call with more data picks up here
    if(rpp->arrayDepth) // we're still expecting more array members
          return(RESP_PARSE_INCOMPLETE);
    return(RESP_PARSE_COMPLETE);
 }
 
+
+/* ***************************** server side requests ************************* */
+
+RESPREQUESTS *
+freeRespRequests(RESPREQUESTS *rqp)
+{
+  if(rqp)
+  {
+    if(rqp->requests)
+      ramisFree(rqp->requests);
+    if(rqp->argv)
+      ramisFree(rqp->argv);
+    if(rqp->argvlen)
+      ramisFree(rqp->argvlen);
+    ramisFree(rqp);
+  }
+  return(NULL);
+}
+
+RESPREQUESTS *
+newRespRequests(void)
+{
+  RESPREQUESTS *rqp=ramisCalloc(1,sizeof(RESPREQUESTS));
+  
+  if(!rqp)
+    return(NULL);
+  rqp->requests=ramisMalloc(INITIALRESPREQUESTS*sizeof(RESPREQUEST));
+  rqp->argv=ramisMalloc(INITIALRESPREQUESTS*4*sizeof(char *));
+  rqp->argvlen=ramisMalloc(INITIALRESPREQUESTS*4*sizeof(size_t));
+  if(!rqp->requests || !rqp->argv || !rqp->argvlen)
+    return(freeRespRequests(rqp));
+  rqp->maxRequests=INITIALRESPREQUESTS;
+  rqp->maxArgs=INITIALRESPREQUESTS*4;
+  return(rqp);
+}
+
+// makes room for n more arguments
+static int
+growRequestArgs(RESPREQUESTS *rqp,int n)
+{
+  int newMax=rqp->maxArgs;
+  const char **newArgv;
+  size_t *newArgvlen;
+  
+  if(rqp->nArgs+n<=rqp->maxArgs)
+    return(RAMISOK);
+  while(newMax<rqp->nArgs+n)
+    newMax*=RESPITEMSGROWTH;
+  newArgv=ramisRealloc(rqp->argv,newMax*sizeof(char *));
+  if(newArgv)
+    rqp->argv=newArgv;
+  newArgvlen=ramisRealloc(rqp->argvlen,newMax*sizeof(size_t));
+  if(newArgvlen)
+    rqp->argvlen=newArgvlen;
+  if(!newArgv || !newArgvlen)
+  {
+    rqp->errorMsg="Unable to realloc more memory for RESP request arguments";
+    return(RAMISFAIL);
+  }
+  rqp->maxArgs=newMax;
+  return(RAMISOK);
+}
+
+static int
+requestError(RESPREQUESTS *rqp,char *str)
+{
+  rqp->errorMsg=str;
+  return(RESP_PARSE_ERROR);
+}
+
+// reads the N of a "*N\r\n" or "$N\r\n" header at p whose line ends at eol
+static int
+requestHeaderNumber(byte *p,byte *eol,int64_t *pint)
+{
+  byte *numberEnd=parseRespInteger(p+1,pint);
+  
+  return(numberEnd!=NULL && numberEnd+1==eol && *numberEnd=='\r');
+}
+
+// parses the "*N\r\n$L\r\n...\r\n" request at *pp and moves *pp past it
+static int
+parseMultibulkRequest(RESPREQUESTS *rqp,byte **pp,byte *end)
+{
+  byte   *start=*pp,*p=*pp,*eol;
+  int64_t n,len,i;
+  
+  if(!(eol=memchr(p,'\n',end-p)))
+    return(end-p>RESPMAXINLINE?requestError(rqp,"Protocol error: too big mbulk count string"):RESP_PARSE_INCOMPLETE);
+  if(!requestHeaderNumber(p,eol,&n) || n>RESPMAXMULTIBULK)
+    return(requestError(rqp,"Protocol error: invalid multibulk length"));
+  p=eol+1;
+  if(n<=0) // an empty request is skipped
+  {
+    *pp=p;
+    return(RESP_PARSE_COMPLETE);
+  }
+  // *N is only a claim, room for the rest is made as the arguments arrive
+  if(!growRequestArgs(rqp,n<RESPARGSUPFRONT?(int)n:RESPARGSUPFRONT))
+    return(RESP_PARSE_ERROR);
+  
+  for(i=0;i<n;i++)
+  {
+    if(p>=end)
+      return(RESP_PARSE_INCOMPLETE);
+    if(!growRequestArgs(rqp,1))
+      return(RESP_PARSE_ERROR);
+    if(*p!='$')
+      return(requestError(rqp,"Protocol error: expected '$'"));
+    if(!(eol=memchr(p,'\n',end-p)))
+      return(end-p>RESPMAXINLINE?requestError(rqp,"Protocol error: too big bulk count string"):RESP_PARSE_INCOMPLETE);
+    if(!requestHeaderNumber(p,eol,&len) || len<0 || len>RESPMAXBULK)
+      return(requestError(rqp,"Protocol error: invalid bulk length"));
+    p=eol+1;
+    if(end-p<len+2)
+    {
+      rqp->wanted=(size_t)(p-start)+len+2;
+      return(RESP_PARSE_INCOMPLETE);
+    }
+    if(p[len]!='\r' || p[len+1]!='\n')
+      return(requestError(rqp,"Protocol error: bulk string not followed by CRLF"));
+    rqp->argv[rqp->nArgs]=(const char *)p;
+    rqp->argvlen[rqp->nArgs++]=(size_t)len;
+    p+=len+2;
+  }
+  *pp=p;
+  return(RESP_PARSE_COMPLETE);
+}
+
+static inline int
+hexDigitValue(byte c)
+{
+  if(c>='0' && c<='9') return(c-'0');
+  if(c>='a' && c<='f') return(c-'a'+10);
+  if(c>='A' && c<='F') return(c-'A'+10);
+  return(-1);
+}
+
+// splits an inline command line at *pp into arguments the way redis-cli quotes them. Quoted
+// arguments are unescaped in place, which only ever shortens them. Nothing is guessed to be
+// a number, every argument is a string
+static int
+parseInlineRequest(RESPREQUESTS *rqp,byte **pp,byte *end)
+{
+  byte *s=*pp,*eol,*lineEnd,*w,*arg;
+  int   hi,lo;
+  
+  if(!(eol=memchr(s,'\n',end-s)))
+    return(end-s>RESPMAXINLINE?requestError(rqp,"Protocol error: too big inline request"):RESP_PARSE_INCOMPLETE);
+  lineEnd=eol>s && eol[-1]=='\r'?eol-1:eol;
+  
+  for(;;)
+  {
+    while(s<lineEnd && isspace(*s))
+      s++;
+    if(s>=lineEnd)
+      break;
+    if(!growRequestArgs(rqp,1))
+      return(RESP_PARSE_ERROR);
+    arg=w=s;
+    
+    if(*s=='"')
+    {
+      for(s++;;)
+      {
+        if(s>=lineEnd)
+          return(requestError(rqp,"Protocol error: unbalanced quotes in request"));
+        if(*s=='"')
+          break;
+        if(*s=='\\' && s+3<lineEnd && s[1]=='x' && (hi=hexDigitValue(s[2]))>=0 && (lo=hexDigitValue(s[3]))>=0)
+        {
+          *w++=(byte)(hi*16+lo);
+          s+=4;
+        }
+        else
+        if(*s=='\\' && s+1<lineEnd)
+        {
+          switch(*++s)
+          {
+            case 'n': *w++='\n';break;
+            case 'r': *w++='\r';break;
+            case 't': *w++='\t';break;
+            case 'b': *w++='\b';break;
+            case 'a': *w++='\a';break;
+            default : *w++=*s;break;
+          }
+          s++;
+        }
+        else *w++=*s++;
+      }
+      if(++s<lineEnd && !isspace(*s)) // the closing quote must end the argument
+        return(requestError(rqp,"Protocol error: unbalanced quotes in request"));
+    }
+    else
+    if(*s=='\'')
+    {
+      for(s++;;)
+      {
+        if(s>=lineEnd)
+          return(requestError(rqp,"Protocol error: unbalanced quotes in request"));
+        if(*s=='\'')
+          break;
+        if(*s=='\\' && s+1<lineEnd && s[1]=='\'')
+          s++;
+        *w++=*s++;
+      }
+      if(++s<lineEnd && !isspace(*s))
+        return(requestError(rqp,"Protocol error: unbalanced quotes in request"));
+    }
+    else
+    {
+      while(s<lineEnd && !isspace(*s))
+        s++;
+      w=s;
+    }
+    rqp->argv[rqp->nArgs]=(const char *)arg;
+    rqp->argvlen[rqp->nArgs++]=(size_t)(w-arg);
+  }
+  *pp=eol+1;
+  return(RESP_PARSE_COMPLETE);
+}
+
+// splits bufLen bytes from a client into the complete requests in them, see resp_protocol.h
+int
+parseRespRequests(RESPREQUESTS *rqp,byte *buf,size_t bufLen)
+{
+  byte *p=buf,*end=buf+bufLen,*start;
+  int   ret=RESP_PARSE_COMPLETE,firstArg,i;
+  RESPREQUEST *rq;
+  
+  rqp->nRequests=0;
+  rqp->nArgs=0;
+  rqp->consumed=0;
+  rqp->wanted=0;
+  rqp->errorMsg=NULL;
+  
+  while(p<end)
+  {
+    start=p;
+    firstArg=rqp->nArgs;
+    ret=*p=='*'?parseMultibulkRequest(rqp,&p,end):parseInlineRequest(rqp,&p,end);
+    if(ret!=RESP_PARSE_COMPLETE)
+    {
+      rqp->nArgs=firstArg; // drop the arguments of the partial request
+      break;
+    }
+    rqp->consumed=p-buf;
+    if(rqp->nArgs==firstArg) // empty lines and *0 are skipped
+      continue;
+    
+    if(rqp->nRequests==rqp->maxRequests)
+    {
+      RESPREQUEST *newRequests=ramisRealloc(rqp->requests,rqp->maxRequests*RESPITEMSGROWTH*sizeof(RESPREQUEST));
+      if(!newRequests)
+      {
+        rqp->errorMsg="Unable to realloc more memory for RESP requests";
+        ret=RESP_PARSE_ERROR;
+        rqp->nArgs=firstArg;
+        break;
+      }
+      rqp->requests=newRequests;
+      rqp->maxRequests*=RESPITEMSGROWTH;
+    }
+    rq=&rqp->requests[rqp->nRequests++];
+    rq->firstArg=firstArg;
+    rq->argc=rqp->nArgs-firstArg;
+    rq->offset=(size_t)(start-buf);
+    rq->length=(size_t)(p-start);
+  }
+  
+  // the argument arrays are done growing so the pointers into them can be handed out
+  for(i=0;i<rqp->nRequests;i++)
+  {
+    rq=&rqp->requests[i];
+    rq->argv=rqp->argv+rq->firstArg;
+    rq->argvlen=rqp->argvlen+rq->firstArg;
+  }
+  if(ret==RESP_PARSE_ERROR)
+    return(-1);
+  return(rqp->nRequests);
+}
+
 #ifdef NEEDEDLATERBUTNOTNOW
 // returns the ascii rendered length of a double when printed
 static size_t
@@ -705,32 +1135,194 @@ respPrintfItems(char *s)
 
 
 
-// quickly estimate the amount of buffer required to encode to RESP.
-// It overestimates, but it's faster than rendering to find out.
-size_t
-respApproxBufNeeded(RESPROTO *rpp)
+/* ******************************** reply encoding ****************************** */
+
+// the digits and CRLF of the small numbers that most replies are made of: counts, array sizes
+// and short bulk string lengths. They're shared by ':', '*' and '$' lines
+static const struct { uint8_t len; char s[6]; } respSharedNumbers[RESPSHAREDNUMBERS]={
+  {3,"0\r\n"},{3,"1\r\n"},{3,"2\r\n"},{3,"3\r\n"},{3,"4\r\n"},{3,"5\r\n"},{3,"6\r\n"},{3,"7\r\n"},{3,"8\r\n"},{3,"9\r\n"},
+  {4,"10\r\n"},{4,"11\r\n"},{4,"12\r\n"},{4,"13\r\n"},{4,"14\r\n"},{4,"15\r\n"},{4,"16\r\n"},{4,"17\r\n"},{4,"18\r\n"},{4,"19\r\n"},
+  {4,"20\r\n"},{4,"21\r\n"},{4,"22\r\n"},{4,"23\r\n"},{4,"24\r\n"},{4,"25\r\n"},{4,"26\r\n"},{4,"27\r\n"},{4,"28\r\n"},{4,"29\r\n"},
+  {4,"30\r\n"},{4,"31\r\n"},{4,"32\r\n"},{4,"33\r\n"},{4,"34\r\n"},{4,"35\r\n"},{4,"36\r\n"},{4,"37\r\n"},{4,"38\r\n"},{4,"39\r\n"},
+  {4,"40\r\n"},{4,"41\r\n"},{4,"42\r\n"},{4,"43\r\n"},{4,"44\r\n"},{4,"45\r\n"},{4,"46\r\n"},{4,"47\r\n"},{4,"48\r\n"},{4,"49\r\n"},
+  {4,"50\r\n"},{4,"51\r\n"},{4,"52\r\n"},{4,"53\r\n"},{4,"54\r\n"},{4,"55\r\n"},{4,"56\r\n"},{4,"57\r\n"},{4,"58\r\n"},{4,"59\r\n"},
+  {4,"60\r\n"},{4,"61\r\n"},{4,"62\r\n"},{4,"63\r\n"},{4,"64\r\n"},{4,"65\r\n"},{4,"66\r\n"},{4,"67\r\n"},{4,"68\r\n"},{4,"69\r\n"},
+  {4,"70\r\n"},{4,"71\r\n"},{4,"72\r\n"},{4,"73\r\n"},{4,"74\r\n"},{4,"75\r\n"},{4,"76\r\n"},{4,"77\r\n"},{4,"78\r\n"},{4,"79\r\n"},
+  {4,"80\r\n"},{4,"81\r\n"},{4,"82\r\n"},{4,"83\r\n"},{4,"84\r\n"},{4,"85\r\n"},{4,"86\r\n"},{4,"87\r\n"},{4,"88\r\n"},{4,"89\r\n"},
+  {4,"90\r\n"},{4,"91\r\n"},{4,"92\r\n"},{4,"93\r\n"},{4,"94\r\n"},{4,"95\r\n"},{4,"96\r\n"},{4,"97\r\n"},{4,"98\r\n"},{4,"99\r\n"}
+};
+
+static const char respDigitPairs[]="00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+// how many decimal digits in v
+static inline int
+respDigits(uint64_t v)
+{
+  int n=1;
+  
+  for(;;)
+  {
+    if(v<10)    return(n);
+    if(v<100)   return(n+1);
+    if(v<1000)  return(n+2);
+    if(v<10000) return(n+3);
+    v/=10000;
+    n+=4;
+  }
+}
+
+// writes v in decimal two digits at a time, returns how many digits
+static inline int
+respUtoa(uint64_t v,byte *dst)
+{
+  int n=respDigits(v),i=n-1;
+  
+  while(v>=100)
+  {
+    int pair=(int)(v%100)*2;
+    v/=100;
+    dst[i]=respDigitPairs[pair+1];
+    dst[i-1]=respDigitPairs[pair];
+    i-=2;
+  }
+  if(v<10)
+    dst[i]=(byte)('0'+v);
+  else
+  {
+    dst[i]=respDigitPairs[v*2+1];
+    dst[i-1]=respDigitPairs[v*2];
+  }
+  return(n);
+}
+
+// writes a ":N\r\n", "*N\r\n" or "$N\r\n" line, returns where it ended
+static inline byte *
+respNumberLine(byte *bufp,byte type,int64_t v)
+{
+  uint64_t u;
+  
+  *bufp++=type;
+  if(v>=0 && v<RESPSHAREDNUMBERS)
+  {
+    memcpy(bufp,respSharedNumbers[v].s,respSharedNumbers[v].len);
+    return(bufp+respSharedNumbers[v].len);
+  }
+  u=(uint64_t)v;
+  if(v<0)
+  {
+    *bufp++='-';
+    u=-u;
+  }
+  bufp+=respUtoa(u,bufp);
+  *bufp++='\r';*bufp++='\n';
+  return(bufp);
+}
+
+// how long a number line is, type and CRLF included
+static inline size_t
+respNumberLineLen(int64_t v)
+{
+  if(v<0)
+    return(4+respDigits(-(uint64_t)v));
+  return(3+respDigits((uint64_t)v));
+}
+
+// floats are RAMIS only. %.17g round trips any double and the parser needs to see a '.' or exponent
+static byte *
+respFloatLine(byte *bufp,double f)
+{
+  int n;
+  
+  *bufp++=':';
+  n=snprintf((char *)bufp,RESPMAXFLOATLEN-3,"%.17g",f);
+  if(!strpbrk((char *)bufp,".eEn")) // not already a float, inf or nan
+  {
+    bufp[n++]='.';
+    bufp[n++]='0';
+  }
+  bufp+=n;
+  *bufp++='\r';*bufp++='\n';
+  return(bufp);
+}
+
+// the bytes needed to encode the out items, not counting bulk payloads of at least minRef bytes
+// which are pointed to instead. *nRefs is set to how many of those there are
+static size_t
+replyBufNeeded(RESPROTO *rpp,size_t minRef,int *nRefs)
 {
   int i;
   size_t needed=0;
   
+  *nRefs=0;
   for(i=0;i<rpp->nOutItems;i++)
   {
      RESPITEM *item=&rpp->outItems[i];
      switch(item->respType)
      {
        case(RESPISNULL)    :  needed+=RESPNULLLENGTH;break;
-       case(RESPISFLOAT)   :
-       case(RESPISINT)     :
-       case(RESPISARRAY)   :  needed+=RESPMAXDIGITLEN;break;
+       case(RESPISFLOAT)   :  needed+=RESPMAXFLOATLEN;break;
+       case(RESPISINT)     :  needed+=respNumberLineLen(item->rinteger);break;
+       case(RESPISARRAY)   :  needed+=respNumberLineLen((int64_t)item->length);break;
        case(RESPISPLAINTXT):
        case(RESPISERRORMSG):
        case(RESPISSTR)     :  needed+=item->length+3;break;
-       case(RESPISBULKSTR) :  needed+=RESPMAXDIGITLEN+item->length+2;break;
+       case(RESPISBULKSTR) :
+       {
+         needed+=respNumberLineLen((int64_t)item->length)+2;
+         if(item->length>=minRef)
+           ++*nRefs;
+         else
+           needed+=item->length;
+         break;
+       }
      }
   }
  return(needed);
 }
 
+// how much buffer respGenerateReply() needs, exact except that floats are given the most they can take
+size_t
+respApproxBufNeeded(RESPROTO *rpp)
+{
+  int nRefs;
+  
+  return(replyBufNeeded(rpp,SIZE_MAX,&nRefs));
+}
+
+// encodes one item. A bulk payload that isn't copied (copyPayload is 0) is left out, the
+// caller puts it between the header and the CRLF
+static byte *
+encodeReplyItem(byte *bufp,RESPITEM *item,int copyPayload)
+{
+  switch(item->respType)
+  {
+    case(RESPISNULL):   memcpy(bufp,RESPNULL,RESPNULLLENGTH);return(bufp+RESPNULLLENGTH);
+    case(RESPISFLOAT):  return(respFloatLine(bufp,item->rfloat));
+    case(RESPISINT):    return(respNumberLine(bufp,':',item->rinteger));
+    case(RESPISARRAY):  return(respNumberLine(bufp,'*',(int64_t)item->length));
+    case(RESPISPLAINTXT): // plaintext should not occur but we'll encode as a string
+    case(RESPISSTR):
+    case(RESPISERRORMSG):
+    {
+      *bufp++=item->respType==RESPISERRORMSG?'-':'+';
+      memcpy(bufp,item->loc,item->length);
+      bufp+=item->length;
+      *bufp++='\r';*bufp++='\n';
+      return(bufp);
+    }
+    case(RESPISBULKSTR):
+    {
+      bufp=respNumberLine(bufp,'$',(int64_t)item->length);
+      if(!copyPayload)
+        return(bufp);
+      memcpy(bufp,item->loc,item->length);
+      bufp+=item->length;
+      *bufp++='\r';*bufp++='\n';
+      return(bufp);
+    }
+  }
+  return(bufp);
+}
 
 
 /*
@@ -748,62 +1340,289 @@ respGenerateReply(RESPROTO *rpp,byte **outBufp,size_t *outBufszp)
   
   if(bufSizeRequired>*outBufszp) // we need to grow the buffer
   {
-    if(!*outBufp)
-      *outBufp=ramisMalloc(bufSizeRequired);
-    else
-      *outBufp=ramisRealloc(*outBufp,bufSizeRequired);
+    byte *newBuf=ramisRealloc(*outBufp,bufSizeRequired); // realloc(NULL,...) is a malloc
       
-    if(!outBufp)
+    if(!newBuf)
       return(-1);
      
+    *outBufp=newBuf;
     *outBufszp=bufSizeRequired;
   }
   
   bufp=*outBufp;
+  for(i=0;i<rpp->nOutItems;i++)
+    bufp=encodeReplyItem(bufp,&rpp->outItems[i],1);
+ return(bufp-*outBufp);
+}
+
+
+RESPREPLYIOV *
+freeRespReplyIov(RESPREPLYIOV *riv)
+{
+  if(riv)
+  {
+    if(riv->iov)
+      ramisFree(riv->iov);
+    if(riv->buf)
+      ramisFree(riv->buf);
+    ramisFree(riv);
+  }
+  return(NULL);
+}
+
+RESPREPLYIOV *
+newRespReplyIov(size_t minRef)
+{
+  RESPREPLYIOV *riv=ramisCalloc(1,sizeof(RESPREPLYIOV));
   
+  if(riv)
+    riv->minRef=minRef?minRef:RESPIOVMINREF;
+  return(riv);
+}
+
+/*
+ * Encodes the out items as an iovec list for writev(). Bulk string payloads of at least
+ * riv->minRef bytes are pointed to where they are rather than copied, so they have to stay put
+ * until the reply is written. Everything else is encoded into riv->buf. Returns the number of
+ * bytes in the reply or -1 on allocation error
+*/
+ssize_t
+respGenerateReplyIov(RESPROTO *rpp,RESPREPLYIOV *riv)
+{
+  int i,nRefs,maxIov;
+  byte *bufp,*runStart;
+  size_t needed=replyBufNeeded(rpp,riv->minRef,&nRefs);
+  
+  if(needed>riv->bufSize)
+  {
+    byte *newBuf=ramisRealloc(riv->buf,needed);
+    if(!newBuf)
+      return(-1);
+    riv->buf=newBuf;
+    riv->bufSize=needed;
+  }
+  maxIov=2*nRefs+1; // a payload splits the encoded run in two
+  if(maxIov>riv->maxIov)
+  {
+    struct iovec *newIov=ramisRealloc(riv->iov,maxIov*sizeof(struct iovec));
+    if(!newIov)
+      return(-1);
+    riv->iov=newIov;
+    riv->maxIov=maxIov;
+  }
+  
+  riv->nIov=0;
+  riv->totalLen=0;
+  runStart=bufp=riv->buf;
   for(i=0;i<rpp->nOutItems;i++)
   {
-     RESPITEM *item=&rpp->outItems[i];
-     switch(item->respType)
-     {
-       case(RESPISNULL):   {bufp+=sprintf((char *)bufp,"%s","$-1\r\n");break;}
-       case(RESPISFLOAT):  {bufp+=sprintf((char *)bufp,":%#.*e\r\n",DBL_DECIMAL_DIG-1,item->rfloat);break;}
-       case(RESPISINT):    {bufp+=sprintf((char *)bufp,":%lld\r\n",item->rinteger);break;}
-       case(RESPISARRAY):  {bufp+=sprintf((char *)bufp,"*%zd\r\n",item->length);break;}
-       case(RESPISPLAINTXT): // plaintext should not occur but we'll encode as a string
-       case(RESPISSTR):
-       {
-         *bufp++='+';
-         memcpy(bufp,item->loc,item->length);
-         *bufp++='\r';*bufp++='\n';
-         break;
-       }
-       case(RESPISBULKSTR):
-       {
-         bufp+=sprintf((char *)bufp,"$%zu\r\n",item->length);
-         memcpy(bufp,item->loc,item->length);
-         bufp+=item->length;
-         *bufp++='\r';*bufp++='\n';
-         break;
-       }
-      case(RESPISERRORMSG):
-       {
-         *bufp++='+';
-         memcpy(bufp,item->loc,item->length);
-         *bufp++='\r';*bufp++='\n';
-         break;
-       }
-     }
+    RESPITEM *item=&rpp->outItems[i];
+    int copyPayload=item->respType!=RESPISBULKSTR || item->length<riv->minRef;
+    
+    bufp=encodeReplyItem(bufp,item,copyPayload);
+    if(copyPayload)
+      continue;
+    riv->iov[riv->nIov].iov_base=runStart;
+    riv->iov[riv->nIov++].iov_len=bufp-runStart;
+    riv->iov[riv->nIov].iov_base=item->loc;
+    riv->iov[riv->nIov++].iov_len=item->length;
+    riv->totalLen+=(bufp-runStart)+item->length;
+    runStart=bufp;
+    *bufp++='\r';*bufp++='\n';
   }
- return(bufp-*outBufp);
+  if(bufp>runStart)
+  {
+    riv->iov[riv->nIov].iov_base=runStart;
+    riv->iov[riv->nIov++].iov_len=bufp-runStart;
+    riv->totalLen+=bufp-runStart;
+  }
+  riv->iovp=riv->iov;
+  riv->nIovLeft=riv->nIov;
+  return((ssize_t)riv->totalLen);
+}
+
+// moves past n bytes that writev() wrote. Returns RAMISOK when the whole reply has been written
+int
+respReplyIovConsume(RESPREPLYIOV *riv,size_t n)
+{
+  while(riv->nIovLeft && n>=riv->iovp->iov_len)
+  {
+    n-=riv->iovp->iov_len;
+    riv->iovp++;
+    riv->nIovLeft--;
+  }
+  if(riv->nIovLeft)
+  {
+    riv->iovp->iov_base=(byte *)riv->iovp->iov_base+n;
+    riv->iovp->iov_len-=n;
+  }
+  return(riv->nIovLeft?RAMISFAIL:RAMISOK);
 }
+
+
+
+/*
+ * RESP encodes an argument vector as a command array and appends it to *outBufp at offset used.
+ * The buffer is grown if needed ( *outBufp and *outBufszp are updated ). If *outBufp is NULL it
+ * will be allocated. argvlen may be NULL if every argument is a '\0' terminated string.
+ * Returns the number of bytes appended or -1 on allocation error
+*/
+ssize_t
+respEncodeArgv(byte **outBufp,size_t *outBufszp,size_t used,int argc,const char **argv,const size_t *argvlen)
+{
+  int i;
+  byte *bufp;
+  size_t len;
+  size_t bufSizeRequired=used+RESPMAXDIGITLEN; // the *N header
+  
+  for(i=0;i<argc;i++)
+     bufSizeRequired+=RESPMAXDIGITLEN+(argvlen?argvlen[i]:strlen(argv[i]))+2;
   
+  if(bufSizeRequired>*outBufszp) // we need to grow the buffer
+  {
+    byte *newBuf=ramisRealloc(*outBufp,bufSizeRequired);
+    if(!newBuf)
+      return(-1);
+    *outBufp=newBuf;
+    *outBufszp=bufSizeRequired;
+  }
   
+  bufp=*outBufp+used;
+  bufp=respNumberLine(bufp,'*',argc);
+  for(i=0;i<argc;i++)
+  {
+    len=argvlen?argvlen[i]:strlen(argv[i]);
+    bufp=respNumberLine(bufp,'$',(int64_t)len);
+    memcpy(bufp,argv[i],len);
+    bufp+=len;
+    *bufp++='\r';*bufp++='\n';
+  }
+ return(bufp-(*outBufp+used));
+}
 
 
+// an argument as a count, -1 if it isn't one. argv isn't '\0' terminated
+static long
+argCount(const char *arg,size_t len)
+{
+  long n=0;
 
+  if(!len || len>9)
+    return(-1);
+  while(len--)
+  {
+    if(*arg<'0' || *arg>'9')
+      return(-1);
+    n=n*10+(*arg++-'0');
+  }
+  return(n);
+}
 
+// argument i's length, argvlen may be NULL
+static size_t
+argLen(const char **argv,const size_t *argvlen,int i)
+{
+  return(argvlen?argvlen[i]:strlen(argv[i]));
+}
 
+// the index of the argument after the first word in argv[from...] or 0 if it isn't there
+static int
+afterWord(int argc,const char **argv,const size_t *argvlen,int from,const char *word)
+{
+  size_t len=strlen(word);
+  int i;
 
+  for(i=from;i<argc-1;i++)
+    if(argLen(argv,argvlen,i)==len && !strncasecmp(argv[i],word,len))
+      return(i+1);
+  return(0);
+}
 
+/*
+ * The keys of a command with movable keys that aren't where the table says: from its numkeys argument, after
+ * STREAMS or KEYS, or the destination after STORE. They're argv[*first] to argv[*last] every *step.
+ * Returns 1 if there are some, 0 if there aren't (or cmd doesn't move its keys) and -1 if they can't be found
+*/
+int
+respCommandKeyRange(const struct ramisCommandStruct *cmd,int argc,const char **argv,const size_t *argvlen,int *first,int *last,int *step)
+{
+  const char *name=cmd->command;
+  long numKeys;
+  int  at=0,i;
+
+  *first=*last=0;
+  *step=1;
+  if(!(cmd->flags&RAMISCMDMOVABLEKEYS))
+    return(0);
+
+  if(cmd->commandClass==RAMISCLASSSCRIPTING) // EVAL script numkeys key... and FCALL function numkeys key...
+    at=2;
+  else
+  if(!strcmp(name,"blmpop") || !strcmp(name,"bzmpop")) // timeout numkeys key...
+    at=2;
+  else
+  if(!strcmp(name,"lmpop") || !strcmp(name,"zmpop") || !strcmp(name,"sintercard") || !strcmp(name,"zdiff") ||
+     !strcmp(name,"zinter") || !strcmp(name,"zintercard") || !strcmp(name,"zunion")) // numkeys key...
+    at=1;
+  else
+  if(!strcmp(name,"zdiffstore") || !strcmp(name,"zinterstore") || !strcmp(name,"zunionstore")) // destination numkeys key...
+    at=2;
+  else
+  if(!strcmp(name,"xread") || !strcmp(name,"xreadgroup")) // ... STREAMS key... id...
+  {
+    if(!(i=afterWord(argc,argv,argvlen,1,"STREAMS")) || (argc-i)%2)
+      return(-1);
+    *first=i;
+    *last=i+(argc-i)/2-1;
+    return(1);
+  }
+  else
+  if(!strcmp(name,"migrate")) // host port "" db timeout ... KEYS key...
+  {
+    if(argc<4 || argLen(argv,argvlen,3)) // the key is where the table says
+      return(0);
+    if(!(i=afterWord(argc,argv,argvlen,6,"KEYS")))
+      return(-1);
+    *first=i;
+    *last=argc-1;
+    return(1);
+  }
+  else
+  if(!strcmp(name,"sort") || !strcmp(name,"georadius") || !strcmp(name,"georadiusbymember")) // key ... STORE destination
+  {
+    if(!(i=afterWord(argc,argv,argvlen,2,"STORE")) && (strncmp(name,"geo",3) || !(i=afterWord(argc,argv,argvlen,2,"STOREDIST"))))
+      return(0);
+    *first=*last=i;
+    return(1);
+  }
+  else // SORT_RO only has the table's key
+    return(0);
+
+  if(at>=argc || (numKeys=argCount(argv[at],argLen(argv,argvlen,at)))<0)
+    return(-1);
+  if(!numKeys)
+    return(cmd->commandClass==RAMISCLASSSCRIPTING?0:-1); // a script may have no keys
+  if(numKeys>=argc-at)
+    return(-1);
+  *first=at+1;
+  *last=at+(int)numKeys;
+  return(1);
+}
 
+/*
+ * The index of cmd's first key in argv, the table's if it has one there. Returns 0 if the command has no keys
+ * and -1 if they can't be found
+*/
+int
+respCommandFirstKey(const struct ramisCommandStruct *cmd,int argc,const char **argv,const size_t *argvlen)
+{
+  int first,last,step,found;
+
+  if(!(cmd->flags&RAMISCMDMOVABLEKEYS))
+    return(cmd->firstKey>0 && cmd->firstKey<argc?cmd->firstKey:0);
+  if((found=respCommandKeyRange(cmd,argc,argv,argvlen,&first,&last,&step))<0)
+    return(-1);
+  if(found>0 && !strcmp(cmd->command,"migrate")) // its table key is "" when KEYS lists them
+    return(first);
+  return(cmd->firstKey>0 && cmd->firstKey<argc?cmd->firstKey:found?first:0); // SORT's key comes before its STORE
+}
@@ -11,6 +11,7 @@
 #ifndef resp_protocol_h
 #define resp_protocol_h
 #include <stdio.h>
+#include <sys/uio.h>
 
 // You'll have to change this in order to run the code generators
 #define RESPCODEDIR "/Users/Cube/Src/rampart/rampart"
@@ -37,6 +38,9 @@
 #define RESPNULL        "$-1\r\n"
 #define RESPNULLLENGTH   5
 #define RESPMAXDIGITLEN  26 // max RESP rendered digits in a decimal number + \r\n
+#define RESPMAXFLOATLEN  32 // max RESP rendered floating point field including ':' and \r\n
+#define RESPSHAREDNUMBERS 100 // numbers below this have their encoding precomputed
+#define RESPIOVMINREF   4096 // default size at which bulk payloads are pointed to instead of copied
 
 #define RESPITEM struct respItemStruct
 RESPITEM
@@ -68,6 +72,61 @@ RESPROTO
    uint32_t arrayNest[RESPNESTEDARRAYMAX]; // keep track of how remaining items are needed for array
    uint8_t  arrayDepth; // how deeply are we in a nested array
    byte     isServer;   // flag to indicate if this is parsing for server or client
+   int      nReplies;   // how many complete top level replies have been parsed from buf
+   int      nReplyItems;// how many of the items belong to those complete replies
+   byte *   replyEnd;   // one past the end of the last complete top level reply in buf
+   int      maxReplies; // parsing stops after this many top level replies, 0 for no limit
+   uint64_t nItemGrowths;// how many times the items list was reallocated
+   uint64_t nBufGrowths; // how many times respBufRealloc() grew the buffer
+};
+
+#define INITIALRESPREQUESTS  16                    // preallocated requests in a RESPREQUESTS
+#define RESPMAXINLINE       (64*1024)             // longest inline command or header line
+#define RESPMAXBULK         (512LL*1024*1024)     // biggest argument a client may send
+#define RESPMAXMULTIBULK    (1024*1024)           // most arguments in one command
+#define RESPARGSUPFRONT     1024                  // arguments made room for before any have arrived
+
+// one command from a client, argv[i] points into the buffer that was parsed
+#define RESPREQUEST struct respRequestStruct
+RESPREQUEST
+{
+   int           argc;
+   const char  **argv;      // not '\0' terminated, use argvlen
+   size_t       *argvlen;
+   int           firstArg;  // where argv starts in the RESPREQUESTS arrays
+   size_t        offset;    // where the command starts in the buffer
+   size_t        length;    // how many bytes of the buffer it takes
+};
+
+// a batch of pipelined commands from one buffer
+#define RESPREQUESTS struct respRequestsStruct
+RESPREQUESTS
+{
+   RESPREQUEST  *requests;
+   int           nRequests;
+   int           maxRequests;
+   const char  **argv;      // every request's arguments one after another
+   size_t       *argvlen;
+   int           nArgs;
+   int           maxArgs;
+   size_t        consumed;  // bytes used by complete requests, what's after them is a partial request to keep
+   size_t        wanted;    // if not 0 the partial request needs at least this many bytes to complete
+   char         *errorMsg;  // NULL if all's ok
+};
+
+// a reply encoded for writev(), big bulk payloads are pointed to where they are
+#define RESPREPLYIOV struct respReplyIovStruct
+RESPREPLYIOV
+{
+   struct iovec *iov;       // the whole reply
+   int           nIov;
+   int           maxIov;
+   struct iovec *iovp;      // what's left to write after respReplyIovConsume()
+   int           nIovLeft;
+   byte         *buf;       // everything that isn't a big payload, encoded
+   size_t        bufSize;
+   size_t        totalLen;  // bytes in the reply
+   size_t        minRef;    // bulk payloads at least this big aren't copied
 };
 
 #define RESP_PARSE_INCOMPLETE    0 // more data needed to complete object
@@ -85,16 +144,55 @@ RESPROTO *freeRespProto(RESPROTO *rpp); // destructor
 // parses the buffer returns 1 if complete , 0 if incomplete, -1 on error
 int parseResProto(RESPROTO *rpp,byte *buf,size_t bufSize,int newBuffer);
 
+RESPREQUESTS *newRespRequests(void);
+RESPREQUESTS *freeRespRequests(RESPREQUESTS *rqp);
+
+// server side: splits a client's buffer into the complete commands in it, RESP arrays of bulk
+// strings or inline text lines. Returns how many there are or -1 with errorMsg set on a protocol
+// error, in which case the requests before the bad one are still there. Quoted inline arguments
+// are unescaped in place so buf must be writable
+int parseRespRequests(RESPREQUESTS *rqp,byte *buf,size_t bufLen);
+
 // resets the parser to new state except it does not free allocated items list
 void resetResProto(RESPROTO *rpp);
 
+// how many items make up the value at items[first] including nested array members, 0 if incomplete
+int respReplySpan(RESPITEM *items,int nItems,int first);
+
 //Creates a buffer containing the RESP encoded reply from a command
 ssize_t respGenerateReply(RESPROTO *rpp,byte **outBufp,size_t *outBufszp);
 
-// sees if it's a legitimate command and if so provides info about it
-const struct ramisCommandsStruct *
+// minRef is the payload size from which bulk strings are pointed to rather than copied, 0 for the default
+RESPREPLYIOV *newRespReplyIov(size_t minRef);
+RESPREPLYIOV *freeRespReplyIov(RESPREPLYIOV *riv);
+
+// encodes the out items for writev(riv->iovp,riv->nIovLeft), returns the reply's length or -1
+ssize_t respGenerateReplyIov(RESPROTO *rpp,RESPREPLYIOV *riv);
+
+// moves past n bytes that writev() wrote, RAMISOK when there's nothing left to write
+int respReplyIovConsume(RESPREPLYIOV *riv,size_t n);
+
+// RESP encodes an argument vector as a command and appends it to *outBufp at offset used
+ssize_t respEncodeArgv(byte **outBufp,size_t *outBufszp,size_t used,int argc,const char **argv,const size_t *argvlen);
+
+// sees if it's a legitimate command and if so provides info about it, case doesn't matter
+// the table is generated by ramis_cmdgen into ramis_commands.c
+struct ramisCommandStruct *
 ramisFindCommand (register const char *str, register unsigned int len);
 
+// how many commands there are and each one's position in the table, for per command arrays
+int ramisCommandCount(void);
+int ramisCommandIndex(const struct ramisCommandStruct *cmd);
+struct ramisCommandStruct *ramisCommandAt(int i);
+
+// the index of cmd's first key in argv, following numkeys, STREAMS or KEYS for commands with movable
+// keys. 0 if it has none, -1 if they can't be found. argvlen may be NULL for '\0' terminated args
+int respCommandFirstKey(const struct ramisCommandStruct *cmd,int argc,const char **argv,const size_t *argvlen);
+
+// the keys of a command with movable keys beyond the table's, argv[*first] to argv[*last] every *step.
+// 1 if it has some, 0 if not and -1 if its numkeys, STREAMS or KEYS arguments don't say where they are
+int respCommandKeyRange(const struct ramisCommandStruct *cmd,int argc,const char **argv,const size_t *argvlen,int *first,int *last,int *step);
+
 // RESP encodes parameters in a printf kind of way and outputs them to fh
 int respPrintf(RESPROTO *rpp,FILE *fh,char *fmt,...);
 
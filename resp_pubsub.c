@@ -0,0 +1,575 @@
+//
+//  resp_pubsub.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The reader thread recv()s whatever has arrived into a burst buffer and parses it
+//  in one go. Each complete message becomes a RESPSUBMSG pointing into the buffer
+//  and is pushed onto the lock free queue of the worker that owns its route. A
+//  message split across reads is copied to the front of the next burst buffer, which
+//  is the only copying done. Workers drop their reference to a burst after the
+//  handler returns and the last one out puts the buffer on a lock free recycle list
+//  that the reader takes back in one swap.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_pubsub.h"
+
+
+/* ********************************* queues ********************************* */
+
+// called by the reader only
+static int
+subQueuePush(RESPSUBQUEUE *q,RESPSUBMSG *msg)
+{
+  size_t tail=atomic_load_explicit(&q->tail,memory_order_relaxed);
+  size_t head=atomic_load_explicit(&q->head,memory_order_acquire);
+
+  if(tail-head==RESPSUBQUEUESZ) // full
+    return(0);
+  q->slots[tail&(RESPSUBQUEUESZ-1)]=msg;
+  atomic_store_explicit(&q->tail,tail+1,memory_order_release);
+  return(1);
+}
+
+// called by the queue's worker only
+static RESPSUBMSG *
+subQueuePop(RESPSUBQUEUE *q)
+{
+  RESPSUBMSG *msg;
+  size_t head=atomic_load_explicit(&q->head,memory_order_relaxed);
+  size_t tail=atomic_load_explicit(&q->tail,memory_order_acquire);
+
+  if(head==tail) // empty
+    return(NULL);
+  msg=q->slots[head&(RESPSUBQUEUESZ-1)];
+  atomic_store_explicit(&q->head,head+1,memory_order_release);
+  return(msg);
+}
+
+
+/* ******************************** batches ********************************* */
+
+static void
+freeSubBatch(RESPSUBBATCH *batch)
+{
+  if(batch->buf)
+    ramisFree(batch->buf);
+  if(batch->msgs)
+    ramisFree(batch->msgs);
+  ramisFree(batch);
+}
+
+// gets a burst buffer of at least size bytes, recycled if there's one available
+static RESPSUBBATCH *
+getSubBatch(RESPSUBSCRIBER *rsp,size_t size)
+{
+  RESPSUBBATCH *batch=rsp->spare;
+
+  if(!batch) // take everything the workers have released in one shot, no ABA with a single taker
+    batch=atomic_exchange_explicit(&rsp->recycled,NULL,memory_order_acquire);
+
+  if(batch)
+    rsp->spare=batch->next;
+  else
+  {
+    batch=ramisCalloc(1,sizeof(RESPSUBBATCH));
+    if(!batch)
+      return(NULL);
+    batch->rsp=rsp;
+  }
+
+  if(batch->bufSize<size)
+  {
+    byte *newBuf=ramisRealloc(batch->buf,size);
+    if(!newBuf)
+    {
+      freeSubBatch(batch);
+      return(NULL);
+    }
+    batch->buf=newBuf;
+    batch->bufSize=size;
+  }
+  batch->next=NULL;
+  atomic_store_explicit(&batch->refCount,1,memory_order_relaxed); // the reader's reference
+  return(batch);
+}
+
+static void
+releaseSubBatch(RESPSUBBATCH *batch)
+{
+  RESPSUBSCRIBER *rsp=batch->rsp;
+
+  if(atomic_fetch_sub_explicit(&batch->refCount,1,memory_order_acq_rel)!=1)
+    return;
+
+  batch->next=atomic_load_explicit(&rsp->recycled,memory_order_relaxed);
+  while(!atomic_compare_exchange_weak_explicit(&rsp->recycled,&batch->next,batch,memory_order_release,memory_order_relaxed))
+    ;
+}
+
+void
+respSubRetain(RESPSUBMSG *msg)
+{
+  atomic_fetch_add_explicit(&msg->batch->refCount,1,memory_order_relaxed);
+}
+
+void
+respSubRelease(RESPSUBMSG *msg)
+{
+  releaseSubBatch(msg->batch);
+}
+
+
+/* ********************************* routes ********************************* */
+
+// FNV-1a
+static uint32_t
+subRouteHash(const byte *name,size_t len,int isPattern)
+{
+  uint32_t h=2166136261u^(uint32_t)isPattern;
+  while(len--)
+  {
+    h^=*name++;
+    h*=16777619u;
+  }
+  return(h);
+}
+
+// call with routeLock held
+static RESPSUBROUTE *
+findSubRoute(RESPSUBSCRIBER *rsp,const byte *name,size_t len,int isPattern)
+{
+  RESPSUBROUTE *route=rsp->routes[subRouteHash(name,len,isPattern)&(RESPSUBROUTESLOTS-1)];
+
+  for(;route;route=route->next)
+    if(route->nameLen==len && route->isPattern==isPattern && !memcmp(route->name,name,len))
+      return(route);
+  return(NULL);
+}
+
+
+// sends SUBSCRIBE PSUBSCRIBE UNSUBSCRIBE or PUNSUBSCRIBE, the reply is read by the reader thread.
+// Fails if the reader has stopped, errorMsg says why
+static int
+sendSubCommand(RESPSUBSCRIBER *rsp,const char *command,const char *name)
+{
+  const char *argv[2];
+  int ret;
+
+  if(!atomic_load(&rsp->readerRunning)) // nothing would read the reply or the messages
+    return(RAMISFAIL);
+  argv[0]=command;
+  argv[1]=name;
+  pthread_mutex_lock(&rsp->sendLock);
+  ret=postRespCommandArgv(rsp->rcp,2,argv,NULL);
+  pthread_mutex_unlock(&rsp->sendLock);
+  return(ret);
+}
+
+
+static int
+addSubRoute(RESPSUBSCRIBER *rsp,char *name,int isPattern,void (*handler)(void *handlerData,RESPSUBMSG *msg),void *handlerData)
+{
+  RESPSUBROUTE *route;
+  size_t   len=strlen(name);
+  uint32_t hash=subRouteHash((byte *)name,len,isPattern);
+
+  pthread_rwlock_wrlock(&rsp->routeLock);
+  route=findSubRoute(rsp,(byte *)name,len,isPattern);
+  if(!route)
+  {
+    route=ramisCalloc(1,sizeof(RESPSUBROUTE));
+    if(route)
+       route->name=strdup(name);
+    if(!route || !route->name)
+    {
+      if(route)
+        ramisFree(route);
+      pthread_rwlock_unlock(&rsp->routeLock);
+      rsp->errorMsg="Memory allocation error in respSubscribe";
+      return(RAMISFAIL);
+    }
+    route->nameLen=len;
+    route->isPattern=isPattern;
+    route->worker=hash%rsp->nWorkers;
+    route->next=rsp->routes[hash&(RESPSUBROUTESLOTS-1)];
+    rsp->routes[hash&(RESPSUBROUTESLOTS-1)]=route;
+  }
+  route->handler=handler;
+  route->handlerData=handlerData;
+  atomic_store(&route->active,1);
+  pthread_rwlock_unlock(&rsp->routeLock);
+
+  return(sendSubCommand(rsp,isPattern?"PSUBSCRIBE":"SUBSCRIBE",name));
+}
+
+int
+respSubscribe(RESPSUBSCRIBER *rsp,char *channel,void (*handler)(void *handlerData,RESPSUBMSG *msg),void *handlerData)
+{
+  return(addSubRoute(rsp,channel,0,handler,handlerData));
+}
+
+int
+respPSubscribe(RESPSUBSCRIBER *rsp,char *pattern,void (*handler)(void *handlerData,RESPSUBMSG *msg),void *handlerData)
+{
+  return(addSubRoute(rsp,pattern,1,handler,handlerData));
+}
+
+// routes are never freed until close so the reader and workers can hold pointers to them
+int
+respUnsubscribe(RESPSUBSCRIBER *rsp,char *channelOrPattern,int isPattern)
+{
+  RESPSUBROUTE *route;
+
+  pthread_rwlock_rdlock(&rsp->routeLock);
+  route=findSubRoute(rsp,(byte *)channelOrPattern,strlen(channelOrPattern),isPattern);
+  if(route)
+    atomic_store(&route->active,0);
+  pthread_rwlock_unlock(&rsp->routeLock);
+
+  return(sendSubCommand(rsp,isPattern?"PUNSUBSCRIBE":"UNSUBSCRIBE",channelOrPattern));
+}
+
+
+/* ********************************* threads ******************************** */
+
+static void *
+subWorker(void *arg)
+{
+  RESPSUBQUEUE   *q=arg;
+  RESPSUBMSG     *msg;
+
+  for(;;)
+  {
+    sem_wait(&q->ready);
+    while((msg=subQueuePop(q)))
+    {
+      if(atomic_load_explicit(&msg->route->active,memory_order_relaxed))
+        msg->route->handler(msg->route->handlerData,msg);
+      respSubRelease(msg);
+    }
+    if(atomic_load(&q->rsp->stop))
+      break;
+  }
+  return(NULL);
+}
+
+
+// the connection dropped, keep trying to get it back and resubscribe to everything
+static int
+resubscribe(RESPSUBSCRIBER *rsp)
+{
+  int i;
+  RESPSUBROUTE *route;
+
+  while(!atomic_load(&rsp->stop))
+  {
+    pthread_mutex_lock(&rsp->sendLock);
+    i=reconnectRespServer(rsp->rcp);
+    pthread_mutex_unlock(&rsp->sendLock);
+    if(i)
+    {
+      pthread_rwlock_rdlock(&rsp->routeLock);
+      for(i=0;i<RESPSUBROUTESLOTS;i++)
+        for(route=rsp->routes[i];route;route=route->next)
+          if(atomic_load(&route->active))
+            sendSubCommand(rsp,route->isPattern?"PSUBSCRIBE":"SUBSCRIBE",route->name);
+      pthread_rwlock_unlock(&rsp->routeLock);
+      return(RAMISOK);
+    }
+    sleep(1);
+  }
+  return(RAMISFAIL);
+}
+
+
+// turns the complete replies at the front of batch into messages and queues them for the workers
+static int
+routeSubBurst(RESPSUBSCRIBER *rsp,RESPSUBBATCH *batch)
+{
+  RESPROTO   *rpp=rsp->rpp;
+  RESPITEM   *items=rpp->items;
+  RESPSUBMSG *msg;
+  int   i,span,nMsgs=0;
+  int   touched[RESPSUBMAXWORKERS];
+
+  if(batch->maxMsgs<rpp->nReplies) // every reply might be a message
+  {
+    RESPSUBMSG *newMsgs=ramisRealloc(batch->msgs,rpp->nReplies*sizeof(RESPSUBMSG));
+    if(!newMsgs)
+    {
+      rsp->errorMsg="Memory allocation error in subscriber reader";
+      return(RAMISFAIL);
+    }
+    batch->msgs=newMsgs;
+    batch->maxMsgs=rpp->nReplies;
+  }
+
+  for(i=0;i<rpp->nReplyItems;i+=span)
+  {
+    span=respReplySpan(items,rpp->nReplyItems,i);
+    if(!span)
+      break;
+    if(items[i].respType!=RESPISARRAY || span<4 || items[i+1].respType!=RESPISBULKSTR)
+      continue; // subscribe confirmations and such
+
+    msg=&batch->msgs[nMsgs];
+    if(span==4 && items[i+1].length==7 && !memcmp(items[i+1].loc,"message",7))
+    {
+      msg->pattern=NULL;
+      msg->patternLen=0;
+      msg->channel=items[i+2].loc;
+      msg->channelLen=items[i+2].length;
+      msg->payload=items[i+3].loc;
+      msg->payloadLen=items[i+3].length;
+    }
+    else
+    if(span==5 && items[i+1].length==8 && !memcmp(items[i+1].loc,"pmessage",8))
+    {
+      msg->pattern=items[i+2].loc;
+      msg->patternLen=items[i+2].length;
+      msg->channel=items[i+3].loc;
+      msg->channelLen=items[i+3].length;
+      msg->payload=items[i+4].loc;
+      msg->payloadLen=items[i+4].length;
+    }
+    else continue;
+    msg->batch=batch;
+    ++nMsgs;
+  }
+
+  if(!nMsgs)
+    return(RAMISOK);
+
+  memset(touched,0,sizeof(int)*rsp->nWorkers);
+  pthread_rwlock_rdlock(&rsp->routeLock);
+  for(i=0,msg=batch->msgs;i<nMsgs;i++,msg++)
+  {
+    if(msg->pattern)
+      msg->route=findSubRoute(rsp,msg->pattern,msg->patternLen,1);
+    else
+      msg->route=findSubRoute(rsp,msg->channel,msg->channelLen,0);
+
+    if(!msg->route || !atomic_load_explicit(&msg->route->active,memory_order_relaxed))
+    {
+      ++rsp->nUnrouted;
+      continue;
+    }
+
+    atomic_fetch_add_explicit(&batch->refCount,1,memory_order_relaxed);
+    while(!subQueuePush(&rsp->queues[msg->route->worker],msg))
+    { // the worker is behind, wake it and let it catch up
+      sem_post(&rsp->queues[msg->route->worker].ready);
+      if(atomic_load(&rsp->stop))
+      {
+        releaseSubBatch(batch);
+        pthread_rwlock_unlock(&rsp->routeLock);
+        return(RAMISFAIL);
+      }
+      sched_yield();
+    }
+    touched[msg->route->worker]=1;
+    ++rsp->nMessages;
+  }
+  pthread_rwlock_unlock(&rsp->routeLock);
+
+  for(i=0;i<rsp->nWorkers;i++) // one wakeup per worker per burst
+    if(touched[i])
+      sem_post(&rsp->queues[i].ready);
+
+  return(RAMISOK);
+}
+
+
+static void *
+subReader(void *arg)
+{
+  RESPSUBSCRIBER *rsp=arg;
+  RESPSUBBATCH   *batch,*next;
+  size_t  used=0,tail;
+  ssize_t nread;
+  int     parseRet;
+
+  batch=getSubBatch(rsp,RESPSUBBATCHSZ);
+  while(batch && !atomic_load(&rsp->stop))
+  {
+    if(used==batch->bufSize) // a single message is bigger than the buffer, no one else has seen it yet
+    {
+      byte *newBuf=ramisRealloc(batch->buf,batch->bufSize*2);
+      if(!newBuf)
+      {
+        rsp->errorMsg="Memory allocation error in subscriber reader";
+        break;
+      }
+      batch->buf=newBuf;
+      batch->bufSize*=2;
+    }
+
+    nread=recv(rsp->rcp->socket,batch->buf+used,batch->bufSize-used,0);
+    if(nread<=0)
+    {
+      if(atomic_load(&rsp->stop) || !resubscribe(rsp))
+        break;
+      used=0; // whatever partial message we had is gone
+      continue;
+    }
+    used+=nread;
+
+    parseRet=parseResProto(rsp->rpp,batch->buf,used,1);
+    if(parseRet==RESP_PARSE_ERROR)
+    {
+      rsp->errorMsg=rsp->rpp->errorMsg;
+      if(!resubscribe(rsp))
+        break;
+      used=0;
+      continue;
+    }
+    if(!rsp->rpp->nReplies) // not even one whole message yet
+      continue;
+
+    ++rsp->nBursts;
+    if(!routeSubBurst(rsp,batch))
+      break;
+
+    // move the start of a partial message to a fresh buffer and let go of this one
+    tail=used-(rsp->rpp->replyEnd-batch->buf);
+    next=getSubBatch(rsp,tail>RESPSUBBATCHSZ/2?tail*2:RESPSUBBATCHSZ);
+    if(next && tail)
+      memcpy(next->buf,rsp->rpp->replyEnd,tail);
+    releaseSubBatch(batch);
+    batch=next;
+    used=tail;
+  }
+
+  if(!batch && !rsp->errorMsg)
+    rsp->errorMsg="Memory allocation error in subscriber reader";
+  if(batch)
+    releaseSubBatch(batch);
+  atomic_store(&rsp->readerRunning,0);
+  return(NULL);
+}
+
+
+RESPSUBSCRIBER *
+respSubscriberClose(RESPSUBSCRIBER *rsp)
+{
+  int i;
+  RESPSUBMSG   *msg;
+  RESPSUBROUTE *route,*nextRoute;
+  RESPSUBBATCH *batch,*nextBatch;
+
+  if(!rsp)
+    return(NULL);
+
+  atomic_store(&rsp->stop,1);
+  if(rsp->reader)
+  {
+    if(rsp->rcp && rsp->rcp->socket>-1)
+      shutdown(rsp->rcp->socket,SHUT_RDWR); // kicks the reader out of recv()
+    pthread_join(rsp->reader,NULL);
+  }
+
+  if(rsp->queues)
+  {
+    for(i=0;i<rsp->nWorkers;i++)
+    {
+      if(rsp->workers && rsp->workers[i])
+      {
+        sem_post(&rsp->queues[i].ready);
+        pthread_join(rsp->workers[i],NULL);
+      }
+      while((msg=subQueuePop(&rsp->queues[i]))) // anything the workers didn't get to
+        respSubRelease(msg);
+      sem_destroy(&rsp->queues[i].ready);
+    }
+    ramisFree(rsp->queues);
+  }
+  if(rsp->workers)
+    ramisFree(rsp->workers);
+
+  for(batch=rsp->spare;batch;batch=nextBatch)
+  {
+    nextBatch=batch->next;
+    freeSubBatch(batch);
+  }
+  for(batch=atomic_load(&rsp->recycled);batch;batch=nextBatch)
+  {
+    nextBatch=batch->next;
+    freeSubBatch(batch);
+  }
+
+  for(i=0;i<RESPSUBROUTESLOTS;i++)
+    for(route=rsp->routes[i];route;route=nextRoute)
+    {
+      nextRoute=route->next;
+      ramisFree(route->name);
+      ramisFree(route);
+    }
+
+  if(rsp->rpp)
+    freeRespProto(rsp->rpp);
+  if(rsp->rcp)
+    closeRespClient(rsp->rcp);
+  pthread_rwlock_destroy(&rsp->routeLock);
+  pthread_mutex_destroy(&rsp->sendLock);
+  ramisFree(rsp);
+  return(NULL);
+}
+
+
+RESPSUBSCRIBER *
+respSubscriberOpen(char *hostname,int port,int nWorkers)
+{
+  int i;
+  RESPSUBSCRIBER *rsp;
+
+  if(nWorkers<1 || nWorkers>RESPSUBMAXWORKERS)
+    return(NULL);
+
+  rsp=ramisCalloc(1,sizeof(RESPSUBSCRIBER));
+  if(!rsp)
+    return(NULL);
+
+  pthread_mutex_init(&rsp->sendLock,NULL);
+  pthread_rwlock_init(&rsp->routeLock,NULL);
+  rsp->nWorkers=nWorkers;
+  rsp->rcp=connectRespServer(hostname,port);
+  rsp->rpp=newResProto(0);
+  rsp->queues=ramisCalloc(nWorkers,sizeof(RESPSUBQUEUE));
+  rsp->workers=ramisCalloc(nWorkers,sizeof(pthread_t));
+  if(!rsp->rcp || !rsp->rpp || !rsp->queues || !rsp->workers)
+  {
+    if(rsp->queues) // none of the semaphores exist yet
+    {
+      ramisFree(rsp->queues);
+      rsp->queues=NULL;
+    }
+    return(respSubscriberClose(rsp));
+  }
+  respClientWaitForever(rsp->rcp,1);
+
+  for(i=0;i<nWorkers;i++)
+  {
+    rsp->queues[i].rsp=rsp;
+    sem_init(&rsp->queues[i].ready,0,0);
+  }
+  for(i=0;i<nWorkers;i++)
+    if(pthread_create(&rsp->workers[i],NULL,subWorker,&rsp->queues[i]))
+      return(respSubscriberClose(rsp));
+
+  atomic_store(&rsp->readerRunning,1);
+  if(pthread_create(&rsp->reader,NULL,subReader,rsp))
+    return(respSubscriberClose(rsp));
+
+  return(rsp);
+}
@@ -0,0 +1,115 @@
+//
+//  resp_pubsub.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A subscriber engine that owns a SUBSCRIBE connection. One reader thread pulls
+//  messages off the socket in bursts, parses each burst in one pass and routes the
+//  messages by channel or pattern to worker threads. Messages point into the buffer
+//  they were read into, which is reference counted and freed by whoever is last done.
+//
+
+#ifndef resp_pubsub_h
+#define resp_pubsub_h
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include "respClient.h"
+
+#define RESPSUBBATCHSZ    65536  // initial size of a burst buffer, grows to fit huge messages
+#define RESPSUBQUEUESZ     4096  // messages a worker queue can hold, must be a power of 2
+#define RESPSUBROUTESLOTS   256  // hash slots in the route table, must be a power of 2
+#define RESPSUBMAXWORKERS    64
+
+#define RESPSUBMSG   struct respSubMessageStruct
+#define RESPSUBBATCH struct respSubBatchStruct
+#define RESPSUBROUTE struct respSubRouteStruct
+#define RESPSUBQUEUE struct respSubQueueStruct
+#define RESPSUBSCRIBER struct respSubscriberStruct
+
+RESPSUBMSG
+{
+  byte        *channel;       // '\0' terminated, these all point into the burst buffer
+  size_t       channelLen;
+  byte        *pattern;       // the PSUBSCRIBE pattern that matched or NULL
+  size_t       patternLen;
+  byte        *payload;       // the PUBLISHed data
+  size_t       payloadLen;
+  RESPSUBROUTE *route;        // where it's going
+  RESPSUBBATCH *batch;        // the burst it was read in
+};
+
+RESPSUBBATCH
+{
+  atomic_int   refCount;      // the reader holds one, and each undelivered or retained message one
+  RESPSUBBATCH *next;         // for the recycle list
+  RESPSUBSCRIBER *rsp;        // who to give it back to
+  byte        *buf;           // what was read from the socket
+  size_t       bufSize;
+  RESPSUBMSG  *msgs;          // the messages parsed from buf
+  int          maxMsgs;
+};
+
+RESPSUBROUTE
+{
+  char        *name;          // channel or pattern
+  size_t       nameLen;
+  int          isPattern;
+  atomic_int   active;        // cleared by respUnsubscribe()
+  int          worker;        // all messages for a route go to one worker so they stay in order
+  void       (*handler)(void *handlerData,RESPSUBMSG *msg);
+  void        *handlerData;
+  RESPSUBROUTE *next;         // hash chain
+};
+
+RESPSUBQUEUE // single producer (the reader) single consumer (a worker) ring
+{
+  _Atomic size_t head;        // next slot the worker will take
+  _Atomic size_t tail;        // next slot the reader will fill
+  RESPSUBMSG  *slots[RESPSUBQUEUESZ];
+  sem_t        ready;         // posted once per burst that put something in this queue
+  RESPSUBSCRIBER *rsp;
+};
+
+RESPSUBSCRIBER
+{
+  RESPCLIENT  *rcp;           // the subscription connection, only the reader thread reads it
+  pthread_mutex_t sendLock;   // serializes SUBSCRIBE etc. from caller threads
+  pthread_rwlock_t routeLock; // the reader holds it for reading once per burst
+  RESPSUBROUTE *routes[RESPSUBROUTESLOTS];
+  RESPROTO    *rpp;           // the reader's parser
+  pthread_t    reader;
+  int          nWorkers;
+  pthread_t   *workers;
+  RESPSUBQUEUE *queues;       // one per worker
+  _Atomic(RESPSUBBATCH *) recycled; // freed by workers, taken back all at once by the reader
+  RESPSUBBATCH *spare;        // recycled batches taken back by the reader but not yet reused
+  atomic_int   stop;
+  atomic_int   readerRunning; // cleared when the reader gives up, subscribing then fails
+  char        *errorMsg;      // why the reader stopped
+  uint64_t     nMessages;     // routed to a handler, updated by the reader only
+  uint64_t     nUnrouted;     // arrived for a channel with no active route
+  uint64_t     nBursts;
+};
+
+// connects to the server and starts the reader and nWorkers worker threads
+RESPSUBSCRIBER * respSubscriberOpen(char *hostname,int port,int nWorkers);
+
+// SUBSCRIBEs to channel, messages on it are passed to handler() on a worker thread
+int respSubscribe(RESPSUBSCRIBER *rsp,char *channel,void (*handler)(void *handlerData,RESPSUBMSG *msg),void *handlerData);
+
+// PSUBSCRIBEs to pattern, messages matching it are passed to handler() on a worker thread
+int respPSubscribe(RESPSUBSCRIBER *rsp,char *pattern,void (*handler)(void *handlerData,RESPSUBMSG *msg),void *handlerData);
+
+// UNSUBSCRIBEs or PUNSUBSCRIBEs and stops routing to the handler
+int respUnsubscribe(RESPSUBSCRIBER *rsp,char *channelOrPattern,int isPattern);
+
+// stops the threads, releases undelivered messages and closes the connection
+RESPSUBSCRIBER * respSubscriberClose(RESPSUBSCRIBER *rsp);
+
+// a handler that wants to keep a message after it returns must retain it and later release it
+void respSubRetain(RESPSUBMSG *msg);
+void respSubRelease(RESPSUBMSG *msg);
+
+#endif /* resp_pubsub_h */
@@ -0,0 +1,203 @@
+//
+//  resp_reconnect.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The client thread only ever touches the RESPRECONNECT under its lock, and only when its
+//  own socket is already gone, so a healthy connection costs nothing.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include "ramis.h"
+#include "resp_reconnect.h"
+
+
+// waits up to timeoutMs for a non blocking connect() to finish, RAMISOK if it connected
+static int
+connectFinished(int fd,int timeoutMs)
+{
+  struct pollfd pfd;
+  int       err=0;
+  socklen_t errLen=sizeof(err);
+
+  memset(&pfd,0,sizeof(pfd));
+  pfd.fd=fd;
+  pfd.events=POLLOUT;
+  if(poll(&pfd,1,timeoutMs)<=0)
+    return(RAMISFAIL);
+  if(getsockopt(fd,SOL_SOCKET,SO_ERROR,&err,&errLen) || err)
+    return(RAMISFAIL);
+  return(RAMISOK);
+}
+
+// resolves and connects with a time limit, returns the socket or -1
+static int
+openReconnectSocket(const char *hostname,int port)
+{
+  struct addrinfo hints,*res,*ai;
+  char portStr[16];
+  int  fd=-1,flags;
+
+  memset(&hints,0,sizeof(hints));
+  hints.ai_family=AF_UNSPEC;
+  hints.ai_socktype=SOCK_STREAM;
+  snprintf(portStr,sizeof(portStr),"%d",port);
+  if(getaddrinfo(hostname,portStr,&hints,&res))
+    return(-1);
+
+  for(ai=res;ai;ai=ai->ai_next)
+  {
+    if((fd=socket(ai->ai_family,ai->ai_socktype,ai->ai_protocol))<0)
+      continue;
+    flags=fcntl(fd,F_GETFL,0);
+    fcntl(fd,F_SETFL,flags|O_NONBLOCK);
+    if(!connect(fd,ai->ai_addr,ai->ai_addrlen) || (errno==EINPROGRESS && connectFinished(fd,RESPRECONNECTTIMEOUTMS)))
+    {
+      fcntl(fd,F_SETFL,flags); // the client expects a blocking socket
+      break;
+    }
+    close(fd);
+    fd=-1;
+  }
+  freeaddrinfo(res);
+  return(fd);
+}
+
+// called with the lock held, returns early if woken to stop
+static void
+backoffWait(RESPRECONNECT *rrp,int delayMs)
+{
+  struct timespec until;
+
+  clock_gettime(CLOCK_REALTIME,&until);
+  until.tv_sec+=delayMs/1000;
+  until.tv_nsec+=(long)(delayMs%1000)*1000000L;
+  if(until.tv_nsec>=1000000000L)
+  {
+    until.tv_sec++;
+    until.tv_nsec-=1000000000L;
+  }
+  while(!rrp->stop && pthread_cond_timedwait(&rrp->wake,&rrp->lock,&until)!=ETIMEDOUT);
+}
+
+static void *
+reconnectThread(void *arg)
+{
+  RESPRECONNECT *rrp=arg;
+  int delay=RESPRECONNECTMINMS;
+  int fd,sleepFor;
+
+  pthread_mutex_lock(&rrp->lock);
+  while(!rrp->stop)
+  {
+    if(!rrp->lost)
+    {
+      pthread_cond_wait(&rrp->wake,&rrp->lock);
+      continue;
+    }
+
+    pthread_mutex_unlock(&rrp->lock);
+    fd=openReconnectSocket(rrp->hostname,rrp->port);
+    pthread_mutex_lock(&rrp->lock);
+    ++rrp->nAttempts;
+
+    if(fd>-1)
+    {
+      if(rrp->readySocket>-1)
+        close(rrp->readySocket);
+      rrp->readySocket=fd;
+      rrp->lost=0;
+      ++rrp->nReconnects;
+      delay=RESPRECONNECTMINMS;
+      continue;
+    }
+
+    // half the delay plus a random part of the other half keeps many clients from retrying in step
+    sleepFor=delay/2+rand_r(&rrp->seed)%(delay/2+1);
+    delay=delay*2>RESPRECONNECTMAXMS?RESPRECONNECTMAXMS:delay*2;
+    backoffWait(rrp,sleepFor);
+  }
+  pthread_mutex_unlock(&rrp->lock);
+  return(NULL);
+}
+
+
+RESPRECONNECT *
+freeRespReconnect(RESPRECONNECT *rrp)
+{
+  if(rrp)
+  {
+    pthread_mutex_lock(&rrp->lock);
+    rrp->stop=1;
+    pthread_cond_signal(&rrp->wake);
+    pthread_mutex_unlock(&rrp->lock);
+    pthread_join(rrp->thread,NULL);
+
+    if(rrp->readySocket>-1)
+      close(rrp->readySocket);
+    pthread_cond_destroy(&rrp->wake);
+    pthread_mutex_destroy(&rrp->lock);
+    ramisFree(rrp->hostname);
+    ramisFree(rrp);
+  }
+  return(NULL);
+}
+
+RESPRECONNECT *
+newRespReconnect(char *hostname,int port)
+{
+  RESPRECONNECT *rrp=ramisCalloc(1,sizeof(RESPRECONNECT));
+
+  if(!rrp)
+    return(NULL);
+  if(!(rrp->hostname=strdup(hostname)))
+  {
+    ramisFree(rrp);
+    return(NULL);
+  }
+  rrp->port=port;
+  rrp->readySocket=-1;
+  rrp->seed=(unsigned)time(NULL)^(unsigned)(uintptr_t)rrp;
+  pthread_mutex_init(&rrp->lock,NULL);
+  pthread_cond_init(&rrp->wake,NULL);
+  if(pthread_create(&rrp->thread,NULL,reconnectThread,rrp))
+  {
+    pthread_cond_destroy(&rrp->wake);
+    pthread_mutex_destroy(&rrp->lock);
+    ramisFree(rrp->hostname);
+    ramisFree(rrp);
+    return(NULL);
+  }
+  return(rrp);
+}
+
+void
+respReconnectLost(RESPRECONNECT *rrp)
+{
+  pthread_mutex_lock(&rrp->lock);
+  rrp->lost=1;
+  pthread_cond_signal(&rrp->wake);
+  pthread_mutex_unlock(&rrp->lock);
+}
+
+int
+respReconnectTake(RESPRECONNECT *rrp)
+{
+  int fd;
+
+  pthread_mutex_lock(&rrp->lock);
+  fd=rrp->readySocket;
+  rrp->readySocket=-1;
+  pthread_mutex_unlock(&rrp->lock);
+  return(fd);
+}
@@ -0,0 +1,49 @@
+//
+//  resp_reconnect.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Replaces a client's dead connection from a background thread so that no request waits
+//  on name resolution or connect(). The thread sleeps until a connection is lost, then
+//  retries with exponential backoff and jitter until it has a new socket for the client
+//  to pick up.
+//
+
+#ifndef resp_reconnect_h
+#define resp_reconnect_h
+#include <pthread.h>
+#include <stdint.h>
+
+#define RESPRECONNECTMINMS     50  // first retry delay, doubled after each failure
+#define RESPRECONNECTMAXMS   5000  // the longest delay between attempts
+#define RESPRECONNECTTIMEOUTMS 2000 // how long one connect() attempt may take
+
+#define RESPRECONNECT struct respReconnectStruct
+RESPRECONNECT
+{
+  pthread_t       thread;
+  pthread_mutex_t lock;        // guards everything below
+  pthread_cond_t  wake;
+  char           *hostname;    // our own copy, the resolution happens in the thread
+  int             port;
+  int             lost;        // the client gave up on its socket and needs another
+  int             readySocket; // a new connection waiting for the client, -1 if none
+  int             stop;
+  unsigned        seed;        // for the jitter
+  uint64_t        nAttempts;   // connect attempts made
+  uint64_t        nReconnects; // attempts that worked
+};
+
+RESPRECONNECT * newRespReconnect(char *hostname,int port);
+
+// stops the thread and closes any connection the client never picked up
+RESPRECONNECT * freeRespReconnect(RESPRECONNECT *rrp);
+
+// the client's socket is dead, start working on a replacement
+void respReconnectLost(RESPRECONNECT *rrp);
+
+// returns the replacement socket if there is one yet, otherwise -1
+int respReconnectTake(RESPRECONNECT *rrp);
+
+#endif /* resp_reconnect_h */
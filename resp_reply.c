@@ -0,0 +1,241 @@
+//
+//  resp_reply.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Detaching swaps pointers. The only bytes copied are those of replies to pipelined commands
+//  that were read along with the detached one, they have to go with the client. The pool is
+//  locked as replies may be freed by whichever thread they were handed to.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_reply.h"
+
+
+static void
+destroyReply(RESPREPLY *rrp)
+{
+  if(rrp->items)
+    ramisFree(rrp->items);
+  if(rrp->buf)
+    ramisFree(rrp->buf);
+  if(rrp->arena)
+    ramisFree(rrp->arena);
+  ramisFree(rrp);
+}
+
+// frees the spares and, if nothing holds it any more, the pool. Called with the lock held
+static void
+dropSpares(RESPREPLYPOOL *pool)
+{
+  RESPREPLY *rrp;
+
+  while((rrp=pool->spare))
+  {
+    pool->spare=rrp->next;
+    destroyReply(rrp);
+  }
+  pool->nSpare=0;
+}
+
+static void
+unrefPool(RESPREPLYPOOL *pool)
+{
+  int refs;
+
+  pthread_mutex_lock(&pool->lock);
+  refs=--pool->refs;
+  if(!refs)
+    dropSpares(pool);
+  pthread_mutex_unlock(&pool->lock);
+  if(!refs)
+  {
+    pthread_mutex_destroy(&pool->lock);
+    ramisFree(pool);
+  }
+}
+
+void
+respReplyPoolRelease(RESPREPLYPOOL *pool)
+{
+  if(!pool)
+    return;
+  pthread_mutex_lock(&pool->lock);
+  dropSpares(pool); // only the client takes them
+  pthread_mutex_unlock(&pool->lock);
+  unrefPool(pool);
+}
+
+static RESPREPLYPOOL *
+newReplyPool(void)
+{
+  RESPREPLYPOOL *pool=ramisCalloc(1,sizeof(RESPREPLYPOOL));
+
+  if(!pool)
+    return(NULL);
+  if(pthread_mutex_init(&pool->lock,NULL))
+  {
+    ramisFree(pool);
+    return(NULL);
+  }
+  pool->refs=1; // the client's
+  return(pool);
+}
+
+// a spare from the pool or a new one with a receive buffer of at least bufSize
+static RESPREPLY *
+takeSpare(RESPREPLYPOOL *pool,size_t bufSize)
+{
+  RESPREPLY *rrp;
+
+  pthread_mutex_lock(&pool->lock);
+  if((rrp=pool->spare))
+  {
+    pool->spare=rrp->next;
+    pool->nSpare--;
+  }
+  pool->refs++;
+  pthread_mutex_unlock(&pool->lock);
+
+  if(!rrp)
+  {
+    if(!(rrp=ramisCalloc(1,sizeof(RESPREPLY))) || !(rrp->items=ramisCalloc(INITIALRESPITEMS,sizeof(RESPITEM))))
+      goto failed;
+    rrp->maxItems=INITIALRESPITEMS;
+    rrp->pool=pool;
+  }
+  if(rrp->bufSize<bufSize)
+  {
+    byte *newBuf=ramisRealloc(rrp->buf,bufSize);
+
+    if(!newBuf)
+      goto failed;
+    rrp->buf=newBuf;
+    rrp->bufSize=bufSize;
+  }
+  rrp->next=NULL;
+  return(rrp);
+
+failed:
+  if(rrp)
+    destroyReply(rrp);
+  unrefPool(pool);
+  return(NULL);
+}
+
+RESPREPLY *
+freeRespReply(RESPREPLY *rrp)
+{
+  RESPREPLYPOOL *pool;
+
+  if(!rrp || atomic_fetch_sub_explicit(&rrp->refCount,1,memory_order_acq_rel)!=1)
+    return(NULL);
+  pool=rrp->pool;
+  if(rrp->arena) // decompressed values only, the codec makes its own
+  {
+    ramisFree(rrp->arena);
+    rrp->arena=NULL;
+  }
+  rrp->nItems=rrp->nReplies=0;
+  pthread_mutex_lock(&pool->lock);
+  // kept only while the client is there to take it, and if it isn't holding a lot of memory
+  if(pool->refs>1 && pool->nSpare<RESPREPLYPOOLMAX && rrp->bufSize+rrp->maxItems*sizeof(RESPITEM)<=RESPREPLYKEEPBUF)
+  {
+    rrp->next=pool->spare;
+    pool->spare=rrp;
+    pool->nSpare++;
+    rrp=NULL;
+  }
+  pthread_mutex_unlock(&pool->lock);
+  if(rrp)
+    destroyReply(rrp);
+  unrefPool(pool);
+  return(NULL);
+}
+
+void
+respReplyRetain(RESPREPLY *rrp)
+{
+  atomic_fetch_add_explicit(&rrp->refCount,1,memory_order_relaxed);
+}
+
+// true if any of the reply's strings are in the codec's arena
+static int
+usesArena(RESPREPLY *rrp,RESPCODEC *codec)
+{
+  int i;
+
+  if(!codec->unpackArena)
+    return(0);
+  for(i=0;i<rrp->nItems;i++)
+    if(rrp->items[i].respType==RESPISBULKSTR && rrp->items[i].loc>=codec->unpackArena && rrp->items[i].loc<codec->unpackArena+codec->unpackArenaSize)
+      return(1);
+  return(0);
+}
+
+RESPREPLY *
+respDetachReply(RESPCLIENT *rcp)
+{
+  RESPROTO  *rpp=rcp->rppFrom;
+  RESPREPLY *rrp;
+  RESPITEM  *items;
+  byte      *buf;
+  size_t     bufSize;
+  int        maxItems;
+
+  if(!rpp->nItems)
+  {
+    rpp->errorMsg="There's no reply to detach in respDetachReply()";
+    return(NULL);
+  }
+  if(!rcp->replyPool && !(rcp->replyPool=newReplyPool()))
+  {
+    rpp->errorMsg="Memory allocation error in respDetachReply()";
+    return(NULL);
+  }
+  // the kept replies and room to receive after them, a full buffer would read as a lost connection
+  if(!(rrp=takeSpare(rcp->replyPool,rcp->fromKept+RESPCLIENTBUFSZ)))
+  {
+    rpp->errorMsg="Memory allocation error in respDetachReply()";
+    return(NULL);
+  }
+
+  // replies that came in after this one stay with the client
+  if(rcp->fromKept)
+    memcpy(rrp->buf,rcp->fromNext,rcp->fromKept);
+  rcp->fromNext=rrp->buf;
+
+  buf=rcp->fromBuf;
+  bufSize=rcp->fromBufSize;
+  items=rpp->items;
+  maxItems=rpp->maxItems;
+  rcp->fromBuf=rcp->fromReadp=rrp->buf;
+  rcp->fromBufSize=rrp->bufSize;
+  rpp->items=rrp->items;
+  rpp->maxItems=rrp->maxItems;
+  rrp->buf=buf;
+  rrp->bufSize=bufSize;
+  rrp->items=items;
+  rrp->maxItems=maxItems;
+  rrp->nItems=rpp->nItems;
+  rrp->nReplies=rpp->nReplies;
+  atomic_store_explicit(&rrp->refCount,1,memory_order_relaxed);
+
+  if(rcp->codec && usesArena(rrp,rcp->codec))
+  {
+    rrp->arena=rcp->codec->unpackArena;
+    rcp->codec->unpackArena=NULL;
+    rcp->codec->unpackArenaSize=0;
+  }
+
+  rpp->nItems=rpp->nReplies=rpp->nReplyItems=0;
+  rpp->buf=rpp->currPointer=rpp->bufEnd=rpp->replyEnd=rcp->fromBuf;
+  return(rrp);
+}
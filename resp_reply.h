@@ -0,0 +1,59 @@
+//
+//  resp_reply.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A reply normally lives in the client's parser and receive buffer and is gone with the next
+//  command. Detaching it hands the items list and the buffer they point into to a RESPREPLY
+//  and swaps in a spare pair from the client's pool, so keeping a reply costs no copying
+//  however big it is. Freeing the reply puts its pair back in the pool. Replies can be freed
+//  from any thread and after the client is closed.
+//
+
+#ifndef resp_reply_h
+#define resp_reply_h
+#include <pthread.h>
+#include <stdatomic.h>
+#include "resp_protocol.h"
+
+#define RESPREPLYPOOLMAX   16           // freed replies kept for their buffers
+#define RESPREPLYKEEPBUF   (1024*1024)  // replies holding more than this aren't kept
+
+#define RESPREPLYPOOL struct respReplyPoolStruct
+
+#define RESPREPLY struct respReplyStruct
+RESPREPLY
+{
+  RESPITEM      *items;      // as they were in the client's RESPROTO
+  int            nItems;
+  int            nReplies;   // more than one if it came from getRespReplies()
+
+  // what the items point into
+  byte          *buf;        // the receive buffer
+  size_t         bufSize;
+  int            maxItems;   // the items list's size
+  byte          *arena;      // decompressed values, NULL if there weren't any
+  RESPREPLYPOOL *pool;
+  RESPREPLY     *next;       // in the pool
+  atomic_int     refCount;   // 1 when detached, respReplyRetain() adds one and freeRespReply() takes one
+};
+
+RESPREPLYPOOL
+{
+  pthread_mutex_t lock;
+  RESPREPLY      *spare;     // freed replies whose buffers get swapped into the client
+  int             nSpare;
+  int             refs;      // the client and every reply handed out
+};
+
+// gives the reply's memory back to the pool it came from once the last reference is freed
+RESPREPLY * freeRespReply(RESPREPLY *rrp);
+
+// for sharing a reply, each holder frees it once
+void respReplyRetain(RESPREPLY *rrp);
+
+// the client's hold on its pool, the pool is freed when the last reply out of it is
+void respReplyPoolRelease(RESPREPLYPOOL *pool);
+
+#endif /* resp_reply_h */
@@ -0,0 +1,210 @@
+//
+//  resp_scan.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A scan keeps at most one page request outstanding. When a page arrives its
+//  cursor is pulled out and the request for the following page is transmitted
+//  before any of the page's elements are handed out. The reply to that request
+//  waits in the socket while the caller works through the current page.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_scan.h"
+
+
+// microseconds on a clock that doesn't jump around
+static double
+scanNowUsec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((double)ts.tv_sec*1e6+(double)ts.tv_nsec/1e3);
+}
+
+
+// transmits the request for the page at rsp->cursor
+static int
+requestScanPage(RESPSCAN *rsp)
+{
+  const char *argv[7];
+  char countBuf[RESPMAXDIGITS];
+  int  argc=0;
+
+  argv[argc++]=rsp->command;
+  if(rsp->key)
+    argv[argc++]=rsp->key;
+  argv[argc++]=rsp->cursor;
+  if(rsp->match)
+  {
+    argv[argc++]="MATCH";
+    argv[argc++]=rsp->match;
+  }
+  sprintf(countBuf,"%d",rsp->count);
+  argv[argc++]="COUNT";
+  argv[argc++]=countBuf;
+
+  if(!postRespCommandArgv(rsp->rcp,argc,argv,NULL))
+    return(RAMISFAIL);
+  rsp->pending=1;
+  return(RAMISOK);
+}
+
+
+// AIMD style: if the prefetch didn't cover the wait, ask for bigger pages so there are
+// fewer round trips. If the server took a long time to produce a page, back off.
+static void
+adaptScanCount(RESPSCAN *rsp,double waitedUsec)
+{
+  if(!rsp->adaptive)
+    return;
+
+  if(waitedUsec>RESPSCANSLOWUSEC)
+    rsp->count/=2;
+  else
+  if(waitedUsec>RESPSCANSTALLUSEC)
+    rsp->count*=2;
+
+  if(rsp->count<RESPSCANMINCOUNT)
+    rsp->count=RESPSCANMINCOUNT;
+  else
+  if(rsp->count>RESPSCANMAXCOUNT)
+    rsp->count=RESPSCANMAXCOUNT;
+}
+
+
+// reads the outstanding page, and if there's more to come asks for the next one
+static int
+readScanPage(RESPSCAN *rsp)
+{
+  RESPROTO *rpp;
+  RESPITEM *items;
+  double    startTime=scanNowUsec();
+
+  rsp->pending=0;
+  rpp=getRespReply(rsp->rcp);
+  if(!rpp)
+    return(RAMISFAIL);
+
+  adaptScanCount(rsp,scanNowUsec()-startTime);
+
+  items=rpp->items;  // a page is *2 $cursor *N elements...
+  if(rpp->nItems<3 || items[0].respType!=RESPISARRAY || items[0].nItems!=2 ||
+     items[1].respType!=RESPISBULKSTR || items[1].length>=RESPMAXDIGITS || items[2].respType!=RESPISARRAY)
+  {
+    if(!(rpp->nItems && items[0].respType==RESPISERRORMSG)) // respClienError() will show those
+      rpp->errorMsg="Unexpected reply to SCAN in respScanNext()";
+    return(RAMISFAIL);
+  }
+
+  memcpy(rsp->cursor,items[1].loc,items[1].length);
+  rsp->cursor[items[1].length]='\0';
+  rsp->nextItem=3;
+  rsp->endItem=rpp->nItems;
+
+  if(strcmp(rsp->cursor,"0") && !requestScanPage(rsp)) // the server's done when the cursor is 0
+  {
+    rsp->errorMsg=rpp->errorMsg; // hand out what we have, report this at the end of the page
+    rpp->errorMsg=NULL;
+  }
+
+  return(RAMISOK);
+}
+
+
+RESPSCAN *
+respScanClose(RESPSCAN *rsp)
+{
+  if(rsp)
+  {
+    if(rsp->pending)
+      getRespReply(rsp->rcp); // throw away the prefetched page to keep in sync with the server
+    if(rsp->command)
+      ramisFree(rsp->command);
+    if(rsp->key)
+      ramisFree(rsp->key);
+    if(rsp->match)
+      ramisFree(rsp->match);
+    ramisFree(rsp);
+  }
+  return(NULL);
+}
+
+
+// starts a scan and transmits the request for the first page
+RESPSCAN *
+respScanOpen(RESPCLIENT *rcp,char *command,char *key,char *match,int count)
+{
+  RESPSCAN *rsp;
+
+  if(strcasecmp(command,"SCAN") && strcasecmp(command,"HSCAN") && strcasecmp(command,"SSCAN") && strcasecmp(command,"ZSCAN"))
+  {
+    rcp->rppFrom->errorMsg="respScanOpen() only runs SCAN HSCAN SSCAN or ZSCAN";
+    return(NULL);
+  }
+  if(!strcasecmp(command,"SCAN")==(key!=NULL)) // SCAN is the only one without a key
+  {
+    rcp->rppFrom->errorMsg="respScanOpen() needs a key for HSCAN SSCAN ZSCAN and none for SCAN";
+    return(NULL);
+  }
+
+  rsp=ramisCalloc(1,sizeof(RESPSCAN));
+  if(!rsp)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respScanOpen";
+    return(NULL);
+  }
+
+  rsp->rcp=rcp;
+  rsp->command=strdup(command);
+  rsp->key=key?strdup(key):NULL;
+  rsp->match=match?strdup(match):NULL;
+  if(!rsp->command || (key && !rsp->key) || (match && !rsp->match))
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respScanOpen";
+    return(respScanClose(rsp));
+  }
+
+  if(count<=0)
+  {
+    rsp->adaptive=1;
+    count=RESPSCANDEFCOUNT;
+  }
+  rsp->count=count;
+  strcpy(rsp->cursor,"0");
+
+  if(!requestScanPage(rsp))
+    return(respScanClose(rsp));
+
+  return(rsp);
+}
+
+
+// hands out the next element, reading the prefetched page when the current one runs out
+RESPITEM *
+respScanNext(RESPSCAN *rsp)
+{
+  while(rsp->nextItem>=rsp->endItem)
+  {
+    if(rsp->errorMsg)
+    {
+      rsp->rcp->rppFrom->errorMsg=rsp->errorMsg;
+      return(NULL);
+    }
+
+    if(!rsp->pending) // the last page has been handed out
+      return(NULL);
+
+    if(!readScanPage(rsp))
+      return(NULL);
+  }
+  return(&rsp->rcp->rppFrom->items[rsp->nextItem++]);
+}
@@ -0,0 +1,49 @@
+//
+//  resp_scan.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Iterates over SCAN, HSCAN, SSCAN and ZSCAN results one element at a time.
+//  The next page is requested as soon as the cursor for it is known so that the
+//  network round trip overlaps with processing of the current page.
+//
+
+#ifndef resp_scan_h
+#define resp_scan_h
+#include "respClient.h"
+
+#define RESPSCANDEFCOUNT    100  // starting COUNT for an adaptive scan
+#define RESPSCANMINCOUNT     10  // adaptive COUNT will not go below this
+#define RESPSCANMAXCOUNT  10000  // or above this
+#define RESPSCANSTALLUSEC   250  // waiting longer than this for a page means the prefetch didn't hide the RTT
+#define RESPSCANSLOWUSEC  20000  // waiting longer than this means pages are too expensive for the server
+
+#define RESPSCAN struct respScanStruct
+RESPSCAN
+{
+  RESPCLIENT *rcp;                  // the connection being scanned, it's busy until respScanClose()
+  char       *command;              // SCAN HSCAN SSCAN or ZSCAN
+  char       *key;                  // the key being scanned, NULL for SCAN
+  char       *match;                // MATCH pattern or NULL
+  char        cursor[RESPMAXDIGITS];// the cursor for the next page
+  int         count;                // COUNT being sent with each page
+  int         adaptive;             // adjust count to the time spent waiting for pages
+  int         pending;              // a page has been requested and not yet read
+  int         nextItem;             // index in rcp->rppFrom->items of the next element to hand out
+  int         endItem;              // one past the last element of the current page
+  char       *errorMsg;             // error that happened while prefetching the next page
+};
+
+// starts a scan. command is one of SCAN HSCAN SSCAN ZSCAN, key is NULL for SCAN
+// match may be NULL, count<=0 makes the COUNT adapt to observed page latency
+RESPSCAN * respScanOpen(RESPCLIENT *rcp,char *command,char *key,char *match,int count);
+
+// returns the next element or NULL when the scan is finished or on error (see respClienError())
+// HSCAN returns field then value, ZSCAN returns member then score
+RESPITEM * respScanNext(RESPSCAN *rsp);
+
+// finishes the scan, reads any outstanding page so the connection stays in sync, and frees it
+RESPSCAN * respScanClose(RESPSCAN *rsp);
+
+#endif /* resp_scan_h */
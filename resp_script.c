@@ -0,0 +1,272 @@
+//
+//  resp_script.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_script.h"
+
+#define RESPSCRIPTSTACKARGS 32 // calls with fewer arguments than this don't malloc
+
+
+/* ********************************** SHA1 ********************************** */
+// FIPS 180-1, only used at registration time so it's written for clarity
+
+#define SHA1ROL(v,n) (((v)<<(n))|((v)>>(32-(n))))
+
+static void
+sha1Block(uint32_t *h,const byte *block)
+{
+  uint32_t w[80],a,b,c,d,e,f,k,t;
+  int i;
+
+  for(i=0;i<16;i++)
+    w[i]=(uint32_t)block[i*4]<<24|(uint32_t)block[i*4+1]<<16|(uint32_t)block[i*4+2]<<8|block[i*4+3];
+  for(;i<80;i++)
+    w[i]=SHA1ROL(w[i-3]^w[i-8]^w[i-14]^w[i-16],1);
+
+  a=h[0];b=h[1];c=h[2];d=h[3];e=h[4];
+  for(i=0;i<80;i++)
+  {
+    if(i<20)      {f=(b&c)|(~b&d);       k=0x5A827999;}
+    else if(i<40) {f=b^c^d;              k=0x6ED9EBA1;}
+    else if(i<60) {f=(b&c)|(b&d)|(c&d);  k=0x8F1BBCDC;}
+    else          {f=b^c^d;              k=0xCA62C1D6;}
+    t=SHA1ROL(a,5)+f+e+k+w[i];
+    e=d;d=c;c=SHA1ROL(b,30);b=a;a=t;
+  }
+  h[0]+=a;h[1]+=b;h[2]+=c;h[3]+=d;h[4]+=e;
+}
+
+void
+respSha1Hex(const byte *data,size_t len,char *hex)
+{
+  uint32_t h[5]={0x67452301,0xEFCDAB89,0x98BADCFE,0x10325476,0xC3D2E1F0};
+  byte     last[128];
+  size_t   i,tail=len%64,lastLen;
+  uint64_t bits=(uint64_t)len*8;
+
+  for(i=0;i+64<=len;i+=64)
+    sha1Block(h,data+i);
+
+  memset(last,0,sizeof(last));
+  memcpy(last,data+i,tail);
+  last[tail]=0x80;
+  lastLen=tail<56?64:128;
+  for(i=0;i<8;i++)
+    last[lastLen-1-i]=(byte)(bits>>(i*8));
+  sha1Block(h,last);
+  if(lastLen==128)
+    sha1Block(h,last+64);
+
+  for(i=0;i<5;i++)
+    sprintf(hex+i*8,"%08x",h[i]);
+}
+
+
+/* ******************************** registry ******************************** */
+
+RESPSCRIPT *
+respScriptFree(RESPSCRIPT *script)
+{
+  if(script)
+  {
+    if(script->body)
+      ramisFree(script->body);
+    if(script->function)
+      ramisFree(script->function);
+    ramisFree(script);
+  }
+  return(NULL);
+}
+
+RESPSCRIPT *
+respScriptRegister(char *body)
+{
+  RESPSCRIPT *script=ramisCalloc(1,sizeof(RESPSCRIPT));
+
+  if(!script)
+    return(NULL);
+  script->body=strdup(body);
+  if(!script->body)
+    return(respScriptFree(script));
+  script->bodyLen=strlen(body);
+  respSha1Hex((byte *)script->body,script->bodyLen,script->sha);
+  return(script);
+}
+
+RESPSCRIPT *
+respFunctionRegister(char *libraryCode,char *function)
+{
+  RESPSCRIPT *script=respScriptRegister(libraryCode);
+
+  if(!script)
+    return(NULL);
+  script->function=strdup(function);
+  if(!script->function)
+    return(respScriptFree(script));
+  return(script);
+}
+
+// calls made after this use EVALSHA_RO or FCALL_RO when readOnly is set
+RESPSCRIPT *
+respScriptReadOnly(RESPSCRIPT *script,int readOnly)
+{
+  if(script)
+    script->readOnly=readOnly!=0;
+  return(script);
+}
+
+
+/* ********************************** calls ********************************* */
+
+// is the reply an error that says the server doesn't have the script or function
+static int
+isMissingScript(RESPSCRIPT *script,RESPROTO *rpp)
+{
+  char *msg;
+
+  if(!rpp->nItems || rpp->items[0].respType!=RESPISERRORMSG)
+    return(0);
+  msg=(char *)rpp->items[0].loc;
+  if(script->function)
+    return(strstr(msg,"Function not found")!=NULL);
+  return(!strncmp(msg,"NOSCRIPT",8));
+}
+
+// gives the server the body, SCRIPT LOAD for scripts, FUNCTION LOAD REPLACE for libraries
+static int
+loadScript(RESPCLIENT *rcp,RESPSCRIPT *script)
+{
+  const char *argv[3];
+  size_t argvlen[3];
+  RESPROTO *rpp;
+  int argc=0;
+
+  if(script->function)
+  {
+    argv[argc]="FUNCTION";argvlen[argc++]=8;
+    argv[argc]="LOAD";    argvlen[argc++]=4;
+    argv[argc]="REPLACE"; argvlen[argc++]=7;
+  }
+  else
+  {
+    argv[argc]="SCRIPT";  argvlen[argc++]=6;
+    argv[argc]="LOAD";    argvlen[argc++]=4;
+  }
+  argv[argc]=script->body;argvlen[argc++]=script->bodyLen;
+
+  if(!postRespCommandArgv(rcp,argc,argv,argvlen) || !(rpp=getRespReply(rcp)))
+    return(RAMISFAIL);
+  if(respClienError(rcp))
+    return(RAMISFAIL);
+  if(!script->function && (rpp->items[0].length!=RESPSHA1HEXLEN || memcmp(rpp->items[0].loc,script->sha,RESPSHA1HEXLEN)))
+  {
+    rpp->errorMsg="SCRIPT LOAD returned a different SHA1 than respScriptRegister() computed";
+    return(RAMISFAIL);
+  }
+  return(RAMISOK);
+}
+
+RESPROTO *
+respEvalScriptArgv(RESPCLIENT *rcp,RESPSCRIPT *script,int nKeys,int argc,const char **argv,const size_t *argvlen)
+{
+  const char *stackArgv[RESPSCRIPTSTACKARGS];
+  size_t      stackArgvLen[RESPSCRIPTSTACKARGS];
+  const char **cmdArgv=stackArgv;
+  size_t     *cmdArgvLen=stackArgvLen;
+  char        nKeysBuf[RESPMAXDIGITS];
+  RESPROTO   *rpp=NULL;
+  int         i,tries;
+
+  if(argc+3>RESPSCRIPTSTACKARGS)
+  {
+    cmdArgv=ramisMalloc((argc+3)*sizeof(char *));
+    cmdArgvLen=ramisMalloc((argc+3)*sizeof(size_t));
+    if(!cmdArgv || !cmdArgvLen)
+    {
+      rcp->rppFrom->errorMsg="Memory allocation error in respEvalScript";
+      goto done;
+    }
+  }
+
+  if(script->function)
+    cmdArgv[0]=script->readOnly?"FCALL_RO":"FCALL";
+  else
+    cmdArgv[0]=script->readOnly?"EVALSHA_RO":"EVALSHA";
+  cmdArgvLen[0]=strlen(cmdArgv[0]);
+  cmdArgv[1]=script->function?script->function:script->sha;
+  cmdArgvLen[1]=strlen(cmdArgv[1]);
+  sprintf(nKeysBuf,"%d",nKeys);
+  cmdArgv[2]=nKeysBuf;
+  cmdArgvLen[2]=strlen(nKeysBuf);
+  for(i=0;i<argc;i++)
+  {
+    cmdArgv[i+3]=argv[i];
+    cmdArgvLen[i+3]=argvlen?argvlen[i]:strlen(argv[i]);
+  }
+
+  for(tries=0;tries<2;tries++) // the second time is after loading the script
+  {
+    if(!postRespCommandArgv(rcp,argc+3,cmdArgv,cmdArgvLen) || !(rpp=getRespReply(rcp)))
+      break;
+    if(tries || !isMissingScript(script,rpp))
+      break;
+    if(!loadScript(rcp,script))
+    {
+      rpp=NULL;
+      break;
+    }
+  }
+
+  done:
+  if(cmdArgv!=stackArgv)
+  {
+    if(cmdArgv)
+      ramisFree(cmdArgv);
+    if(cmdArgvLen)
+      ramisFree(cmdArgvLen);
+  }
+  return(rpp);
+}
+
+RESPROTO *
+respEvalScript(RESPCLIENT *rcp,RESPSCRIPT *script,const char **keys,const char **args)
+{
+  const char *stackArgv[RESPSCRIPTSTACKARGS];
+  const char **argv=stackArgv;
+  RESPROTO   *rpp;
+  int nKeys=0,nArgs=0,i;
+
+  while(keys && keys[nKeys])
+    ++nKeys;
+  while(args && args[nArgs])
+    ++nArgs;
+
+  if(nKeys+nArgs>RESPSCRIPTSTACKARGS)
+  {
+    argv=ramisMalloc((nKeys+nArgs)*sizeof(char *));
+    if(!argv)
+    {
+      rcp->rppFrom->errorMsg="Memory allocation error in respEvalScript";
+      return(NULL);
+    }
+  }
+  for(i=0;i<nKeys;i++)
+    argv[i]=keys[i];
+  for(i=0;i<nArgs;i++)
+    argv[nKeys+i]=args[i];
+
+  rpp=respEvalScriptArgv(rcp,script,nKeys,nKeys+nArgs,argv,NULL);
+
+  if(argv!=stackArgv)
+    ramisFree(argv);
+  return(rpp);
+}
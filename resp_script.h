@@ -0,0 +1,48 @@
+//
+//  resp_script.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Lua scripts and functions are registered once. Calls send EVALSHA (or FCALL)
+//  with a digest computed at registration, so the body only crosses the wire when
+//  the server reports it doesn't have it, after which the call is retried.
+//
+
+#ifndef resp_script_h
+#define resp_script_h
+#include "respClient.h"
+
+#define RESPSHA1HEXLEN 40
+
+#define RESPSCRIPT struct respScriptStruct
+RESPSCRIPT
+{
+  char   *body;                    // Lua script, or library code for a function
+  size_t  bodyLen;
+  char    sha[RESPSHA1HEXLEN+1];   // hex SHA1 of body as the server will compute it
+  char   *function;                // function name for FCALL, NULL for an EVALSHA script
+  int     readOnly;                // use EVALSHA_RO / FCALL_RO, set with respScriptReadOnly()
+};
+
+// registers a Lua script for EVALSHA. The body is copied.
+RESPSCRIPT * respScriptRegister(char *body);
+
+// registers a function that lives in libraryCode (the text given to FUNCTION LOAD) for FCALL
+RESPSCRIPT * respFunctionRegister(char *libraryCode,char *function);
+
+// marks the script or function read only so it's called with EVALSHA_RO or FCALL_RO, returns script
+RESPSCRIPT * respScriptReadOnly(RESPSCRIPT *script,int readOnly);
+
+RESPSCRIPT * respScriptFree(RESPSCRIPT *script);
+
+// runs the script. keys and args are NULL terminated lists of strings, either may be NULL
+RESPROTO * respEvalScript(RESPCLIENT *rcp,RESPSCRIPT *script,const char **keys,const char **args);
+
+// runs the script with argc binary safe arguments, the first nKeys of which are keys
+RESPROTO * respEvalScriptArgv(RESPCLIENT *rcp,RESPSCRIPT *script,int nKeys,int argc,const char **argv,const size_t *argvlen);
+
+// hex SHA1 of data into hex which must hold RESPSHA1HEXLEN+1 bytes
+void respSha1Hex(const byte *data,size_t len,char *hex);
+
+#endif /* resp_script_h */
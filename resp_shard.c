@@ -0,0 +1,399 @@
+//
+//  resp_shard.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Each server gets RESPSHARDPOINTS points on a 32 bit ring, hashed from "host:port-i".
+//  A key belongs to the first point at or after its own hash, so adding or removing a
+//  server only moves the keys next to that server's points.
+//  Split commands are posted to every server involved before any reply is read, so the
+//  servers work on their parts at the same time.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_shard.h"
+
+#define SHARDMERGEARRAY 1 // MGET, an array of values in the caller's key order
+#define SHARDMERGEOK    2 // MSET, +OK if every server said so
+#define SHARDMERGESUM   3 // DEL and friends, the sum of the servers' counts
+
+#define SHARDSPLIT struct shardSplitStruct
+SHARDSPLIT
+{
+  const char *command;
+  int         step;    // arguments per key
+  int         merge;   // SHARDMERGE*
+};
+
+static const SHARDSPLIT splitCommands[]=
+{
+  {"MGET",  1,SHARDMERGEARRAY},
+  {"MSET",  2,SHARDMERGEOK},
+  {"DEL",   1,SHARDMERGESUM},
+  {"UNLINK",1,SHARDMERGESUM},
+  {"EXISTS",1,SHARDMERGESUM},
+  {"TOUCH", 1,SHARDMERGESUM},
+  {NULL,0,0}
+};
+
+
+// FNV-1a with murmur3's finalizer, FNV alone leaves "host:port-1", "host:port-2"... too close together
+static uint32_t
+shardHash(const byte *p,size_t len)
+{
+  uint32_t h=2166136261u;
+
+  while(len--)
+  {
+    h^=*p++;
+    h*=16777619u;
+  }
+  h^=h>>16;
+  h*=0x85ebca6b;
+  h^=h>>13;
+  h*=0xc2b2ae35;
+  h^=h>>16;
+  return(h);
+}
+
+static int
+comparePoints(const void *a,const void *b)
+{
+  uint32_t ha=((const RESPSHARDPOINT *)a)->hash;
+  uint32_t hb=((const RESPSHARDPOINT *)b)->hash;
+
+  return(ha<hb?-1:ha>hb);
+}
+
+static size_t
+argLength(const char **argv,const size_t *argvlen,int i)
+{
+  return(argvlen?argvlen[i]:strlen(argv[i]));
+}
+
+
+RESPSHARDS *
+respShardsClose(RESPSHARDS *rsp)
+{
+  int i;
+
+  if(rsp)
+  {
+    if(rsp->clients)
+    {
+      for(i=0;i<rsp->nServers;i++)
+        closeRespClient(rsp->clients[i]);
+      ramisFree(rsp->clients);
+    }
+    if(rsp->ring)
+      ramisFree(rsp->ring);
+    if(rsp->reply)
+      freeRespProto(rsp->reply);
+    if(rsp->shardReply)
+      ramisFree(rsp->shardReply);
+    if(rsp->cursor)
+      ramisFree(rsp->cursor);
+    if(rsp->keyServer)
+      ramisFree(rsp->keyServer);
+    if(rsp->argv)
+      ramisFree(rsp->argv);
+    if(rsp->argvlen)
+      ramisFree(rsp->argvlen);
+    ramisFree(rsp);
+  }
+  return(NULL);
+}
+
+RESPSHARDS *
+respShardsOpen(int nServers,char **hostnames,int *ports)
+{
+  RESPSHARDS *rsp;
+  char  name[1024];
+  int   i,s,len;
+
+  if(nServers<1 || nServers>RESPSHARDMAX)
+    return(NULL);
+
+  rsp=ramisCalloc(1,sizeof(RESPSHARDS));
+  if(!rsp)
+    return(NULL);
+  rsp->nServers=nServers;
+  rsp->clients=ramisCalloc(nServers,sizeof(RESPCLIENT *));
+  rsp->nPoints=nServers*RESPSHARDPOINTS;
+  rsp->ring=ramisMalloc(rsp->nPoints*sizeof(RESPSHARDPOINT));
+  rsp->reply=newResProto(0);
+  rsp->shardReply=ramisCalloc(nServers,sizeof(RESPROTO *));
+  rsp->cursor=ramisCalloc(nServers,sizeof(int));
+  if(!rsp->clients || !rsp->ring || !rsp->reply || !rsp->shardReply || !rsp->cursor)
+    return(respShardsClose(rsp));
+
+  for(s=0;s<nServers;s++)
+  {
+    if(!(rsp->clients[s]=connectRespServer(hostnames[s],ports[s])))
+      return(respShardsClose(rsp));
+    for(i=0;i<RESPSHARDPOINTS;i++)
+    {
+      len=snprintf(name,sizeof(name),"%s:%d-%d",hostnames[s],ports[s],i);
+      if(len>=(int)sizeof(name))
+        len=sizeof(name)-1;
+      rsp->ring[s*RESPSHARDPOINTS+i].hash=shardHash((byte *)name,len);
+      rsp->ring[s*RESPSHARDPOINTS+i].server=s;
+    }
+  }
+  qsort(rsp->ring,rsp->nPoints,sizeof(RESPSHARDPOINT),comparePoints);
+  return(rsp);
+}
+
+
+int
+respShardIndex(RESPSHARDS *rsp,const char *key,size_t keyLen)
+{
+  const char *open=memchr(key,'{',keyLen);
+  const char *close;
+  uint32_t h;
+  int lo=0,hi=rsp->nPoints,mid;
+
+  if(open && (close=memchr(open+1,'}',key+keyLen-open-1))!=NULL && close>open+1)
+  {
+    key=open+1;
+    keyLen=close-key;
+  }
+  h=shardHash((const byte *)key,keyLen);
+
+  while(lo<hi)
+  {
+    mid=(lo+hi)/2;
+    if(rsp->ring[mid].hash<h)
+      lo=mid+1;
+    else
+      hi=mid;
+  }
+  if(lo==rsp->nPoints) // past the last point wraps around to the first
+    lo=0;
+  return(rsp->ring[lo].server);
+}
+
+RESPCLIENT *
+respShardClient(RESPSHARDS *rsp,const char *key)
+{
+  return(rsp->clients[respShardIndex(rsp,key,strlen(key))]);
+}
+
+
+// makes room for a split command of argc arguments and nKeys keys
+static int
+growShardScratch(RESPSHARDS *rsp,int argc,int nKeys)
+{
+  if(argc>rsp->maxArgv)
+  {
+    const char **newArgv=ramisRealloc(rsp->argv,argc*sizeof(char *));
+    size_t *newArgvlen;
+
+    if(!newArgv)
+      return(RAMISFAIL);
+    rsp->argv=newArgv;
+    newArgvlen=ramisRealloc(rsp->argvlen,argc*sizeof(size_t));
+    if(!newArgvlen)
+      return(RAMISFAIL);
+    rsp->argvlen=newArgvlen;
+    rsp->maxArgv=argc;
+  }
+  if(nKeys>rsp->maxKeys)
+  {
+    int *newKeyServer=ramisRealloc(rsp->keyServer,nKeys*sizeof(int));
+
+    if(!newKeyServer)
+      return(RAMISFAIL);
+    rsp->keyServer=newKeyServer;
+    rsp->maxKeys=nKeys;
+  }
+  if(nKeys+1>rsp->reply->maxItems)
+  {
+    RESPITEM *newItems=ramisRealloc(rsp->reply->items,(nKeys+1)*sizeof(RESPITEM));
+
+    if(!newItems)
+      return(RAMISFAIL);
+    rsp->reply->items=newItems;
+    rsp->reply->maxItems=nKeys+1;
+  }
+  return(RAMISOK);
+}
+
+// puts the servers' replies to a split command back together in rsp->reply
+static RESPROTO *
+mergeShardReplies(RESPSHARDS *rsp,const SHARDSPLIT *split,int nKeys)
+{
+  RESPROTO *reply=rsp->reply;
+  RESPITEM *items=reply->items;
+  RESPROTO *rpp;
+  int64_t   sum=0;
+  int       i,s,first=-1;
+
+  // an error from any server is the answer
+  for(s=0;s<rsp->nServers;s++)
+  {
+    if(!(rpp=rsp->shardReply[s]))
+      continue;
+    if(first<0)
+      first=s;
+    if(rpp->items[0].respType==RESPISERRORMSG)
+    {
+      items[0]=rpp->items[0];
+      reply->nItems=1;
+      return(reply);
+    }
+    if(split->merge==SHARDMERGESUM)
+      sum+=rpp->items[0].rinteger;
+  }
+
+  switch(split->merge)
+  {
+    case SHARDMERGEARRAY:
+    {
+      items[0].respType=RESPISARRAY;
+      items[0].nItems=nKeys;
+      items[0].loc=NULL;
+      for(i=0;i<nKeys;i++)
+      {
+        s=rsp->keyServer[i];
+        rpp=rsp->shardReply[s];
+        if(rsp->cursor[s]>=rpp->nItems)
+        {
+          reply->errorMsg="A server returned too few values in respShardCommandArgv()";
+          return(NULL);
+        }
+        items[i+1]=rpp->items[rsp->cursor[s]++];
+      }
+      reply->nItems=nKeys+1;
+    } break;
+    case SHARDMERGEOK:
+    {
+      items[0]=rsp->shardReply[first]->items[0];
+      reply->nItems=1;
+    } break;
+    case SHARDMERGESUM:
+    {
+      items[0].respType=RESPISINT;
+      items[0].rinteger=sum;
+      items[0].loc=NULL;
+      reply->nItems=1;
+    } break;
+  }
+  return(reply);
+}
+
+// posts each server its part of the command, then collects all the replies
+static RESPROTO *
+splitShardCommand(RESPSHARDS *rsp,const SHARDSPLIT *split,int argc,const char **argv,const size_t *argvlen)
+{
+  RESPCLIENT *rcp;
+  char *errorMsg=NULL;
+  int   nKeys=(argc-1)/split->step;
+  int   i,j,s,n;
+
+  if((argc-1)%split->step || !nKeys)
+  {
+    rsp->reply->errorMsg="Wrong number of arguments in respShardCommandArgv()";
+    return(NULL);
+  }
+  if(!growShardScratch(rsp,argc,nKeys))
+  {
+    rsp->reply->errorMsg="Memory allocation error in respShardCommandArgv()";
+    return(NULL);
+  }
+
+  for(i=0;i<nKeys;i++)
+    rsp->keyServer[i]=respShardIndex(rsp,argv[1+i*split->step],argLength(argv,argvlen,1+i*split->step));
+
+  rsp->argv[0]=argv[0];
+  rsp->argvlen[0]=argLength(argv,argvlen,0);
+  for(s=0;s<rsp->nServers;s++)
+  {
+    rsp->shardReply[s]=NULL;
+    rsp->cursor[s]=-1;
+    for(n=1,i=0;i<nKeys;i++)
+      if(rsp->keyServer[i]==s)
+        for(j=1+i*split->step;j<1+(i+1)*split->step;j++)
+        {
+          rsp->argv[n]=argv[j];
+          rsp->argvlen[n++]=argLength(argv,argvlen,j);
+        }
+    if(n==1) // none of the keys are on this server
+      continue;
+    if(!postRespCommandArgv(rsp->clients[s],n,rsp->argv,rsp->argvlen))
+      errorMsg=rsp->clients[s]->rppFrom->errorMsg;
+    else
+      rsp->cursor[s]=0;
+  }
+
+  // every posted reply is read, even after a failure, to keep the connections in sync
+  for(s=0;s<rsp->nServers;s++)
+  {
+    if(rsp->cursor[s]<0)
+      continue;
+    rcp=rsp->clients[s];
+    if(!(rsp->shardReply[s]=getRespReply(rcp)))
+      errorMsg=rcp->rppFrom->errorMsg;
+    else
+      rsp->cursor[s]=1; // values start after the array header
+  }
+
+  if(errorMsg)
+  {
+    rsp->reply->errorMsg=errorMsg;
+    return(NULL);
+  }
+  return(mergeShardReplies(rsp,split,nKeys));
+}
+
+RESPROTO *
+respShardCommandArgv(RESPSHARDS *rsp,int argc,const char **argv,const size_t *argvlen)
+{
+  const SHARDSPLIT *split;
+  RAMISCMD   *cmd;
+  RESPCLIENT *rcp;
+  RESPROTO   *rpp;
+  size_t      len;
+  int         keyIndex;
+
+  rsp->reply->errorMsg=NULL;
+  if(argc<1)
+  {
+    rsp->reply->errorMsg="No command given to respShardCommandArgv()";
+    return(NULL);
+  }
+
+  len=argLength(argv,argvlen,0);
+  for(split=splitCommands;split->command;split++)
+    if(strlen(split->command)==len && !strncasecmp(argv[0],split->command,len))
+      break;
+  if(split->command && rsp->nServers>1)
+    return(splitShardCommand(rsp,split,argc,argv,argvlen));
+
+  // the command table says where the key is, or numkeys or STREAMS when it moves. Commands
+  // without keys go to the first server
+  cmd=ramisFindCommand(argv[0],len);
+  keyIndex=cmd?respCommandFirstKey(cmd,argc,argv,argvlen):1;
+  if(keyIndex<0)
+  {
+    rsp->reply->errorMsg="Can't find the command's keys to pick a server in respShardCommandArgv()";
+    return(NULL);
+  }
+  if(keyIndex>0 && keyIndex<argc)
+    rcp=rsp->clients[respShardIndex(rsp,argv[keyIndex],argLength(argv,argvlen,keyIndex))];
+  else
+    rcp=rsp->clients[0];
+  if(!postRespCommandArgv(rcp,argc,argv,argvlen) || !(rpp=getRespReply(rcp)))
+  {
+    rsp->reply->errorMsg=rcp->rppFrom->errorMsg;
+    return(NULL);
+  }
+  return(rpp);
+}
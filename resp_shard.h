@@ -0,0 +1,59 @@
+//
+//  resp_shard.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Spreads keys over several independent servers with a ketama style consistent hash ring.
+//  Single key commands go to the key's server. MGET, MSET and DEL style commands are split
+//  by server, sent to all of them before any reply is read, and put back together in order.
+//
+
+#ifndef resp_shard_h
+#define resp_shard_h
+#include "respClient.h"
+
+#define RESPSHARDPOINTS 160 // points on the ring per server
+#define RESPSHARDMAX    1024
+
+#define RESPSHARDPOINT struct respShardPointStruct
+RESPSHARDPOINT
+{
+  uint32_t hash;
+  int      server;
+};
+
+#define RESPSHARDS struct respShardsStruct
+RESPSHARDS
+{
+  RESPCLIENT    **clients;     // one connection per server
+  int             nServers;
+  RESPSHARDPOINT *ring;        // sorted by hash
+  int             nPoints;
+  RESPROTO       *reply;       // the put back together reply to a split command, errorMsg is set on failures
+  RESPROTO      **shardReply;  // each server's reply to its part of a split command
+  int            *cursor;      // each server's next unused item in shardReply
+  int            *keyServer;   // the server each key of the current command goes to
+  int             maxKeys;
+  const char    **argv;        // one server's part of a split command
+  size_t         *argvlen;
+  int             maxArgv;
+};
+
+// connects to nServers servers. hostnames must stay valid until respShardsClose()
+RESPSHARDS * respShardsOpen(int nServers,char **hostnames,int *ports);
+
+RESPSHARDS * respShardsClose(RESPSHARDS *rsp);
+
+// which server holds the key. Only the part between the first { and the } after it is hashed
+// if that's not empty, so related keys like user:{42}:name and user:{42}:email stay together
+int respShardIndex(RESPSHARDS *rsp,const char *key,size_t keyLen);
+
+// the connection to the server that holds key, for use with sendRespCommand()
+RESPCLIENT * respShardClient(RESPSHARDS *rsp,const char *key);
+
+// sends a command to the server of its first key as the command table has it. MGET, MSET, DEL,
+// UNLINK, EXISTS and TOUCH are split by server. Returns NULL with rsp->reply->errorMsg set if any server failed
+RESPROTO * respShardCommandArgv(RESPSHARDS *rsp,int argc,const char **argv,const size_t *argvlen);
+
+#endif /* resp_shard_h */
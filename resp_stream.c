@@ -0,0 +1,213 @@
+//
+//  resp_stream.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A partial reply is parsed as it arrives and the parser picks up where it stopped, as the
+//  client does. Replies that were handed out are dropped from the front of the input on the
+//  next feed, which moves what's left and so makes the partial reply be parsed again.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_stream.h"
+
+
+RESPSTREAM *
+freeRespStream(RESPSTREAM *rsm)
+{
+  if(rsm)
+  {
+    if(rsm->rpp)
+      freeRespProto(rsm->rpp);
+    if(rsm->inBuf)
+      ramisFree(rsm->inBuf);
+    if(rsm->outBuf)
+      ramisFree(rsm->outBuf);
+    ramisFree(rsm);
+  }
+  return(NULL);
+}
+
+RESPSTREAM *
+newRespStream(void)
+{
+  RESPSTREAM *rsm=ramisCalloc(1,sizeof(RESPSTREAM));
+
+  if(!rsm)
+    return(NULL);
+  rsm->rpp=newResProto(0);
+  rsm->inBuf=ramisMalloc(RESPCLIENTBUFSZ);
+  rsm->outBuf=ramisMalloc(RESPCLIENTBUFSZ);
+  if(!rsm->rpp || !rsm->inBuf || !rsm->outBuf)
+    return(freeRespStream(rsm));
+  rsm->inSize=rsm->outSize=RESPCLIENTBUFSZ;
+  return(rsm);
+}
+
+void
+respStreamReset(RESPSTREAM *rsm)
+{
+  resetResProto(rsm->rpp);
+  rsm->inUsed=rsm->inTaken=0;
+  rsm->parsing=0;
+  rsm->outUsed=rsm->outSent=0;
+  rsm->nPending=0;
+  rsm->errorMsg=NULL;
+}
+
+
+/* ********************************* output ********************************* */
+
+// moves what hasn't been written yet to the front before more is added
+static void
+compactOutput(RESPSTREAM *rsm)
+{
+  if(!rsm->outSent)
+    return;
+  memmove(rsm->outBuf,rsm->outBuf+rsm->outSent,rsm->outUsed-rsm->outSent);
+  rsm->outUsed-=rsm->outSent;
+  rsm->outSent=0;
+}
+
+int
+respStreamCommand(RESPSTREAM *rsm,char *fmt,...)
+{
+  va_list arg;
+  ssize_t n;
+
+  compactOutput(rsm);
+  va_start(arg,fmt);
+  n=respEncodeIntoV(&rsm->outBuf,&rsm->outSize,rsm->outUsed,&rsm->errorMsg,fmt,&arg);
+  va_end(arg);
+  if(n<0)
+    return(RAMISFAIL);
+  rsm->outUsed+=n;
+  rsm->nPending++;
+  return(RAMISOK);
+}
+
+int
+respStreamCommandArgv(RESPSTREAM *rsm,int argc,const char **argv,const size_t *argvlen)
+{
+  ssize_t n;
+
+  compactOutput(rsm);
+  n=respEncodeArgv(&rsm->outBuf,&rsm->outSize,rsm->outUsed,argc,argv,argvlen);
+  if(n<0)
+  {
+    rsm->errorMsg="Memory allocation error in respStreamCommandArgv()";
+    return(RAMISFAIL);
+  }
+  rsm->outUsed+=n;
+  rsm->nPending++;
+  return(RAMISOK);
+}
+
+int
+respStreamWants(RESPSTREAM *rsm)
+{
+  return((rsm->outUsed>rsm->outSent?RESPWANTWRITE:0)|(rsm->nPending>0?RESPWANTREAD:0));
+}
+
+byte *
+respStreamOutput(RESPSTREAM *rsm,size_t *lenp)
+{
+  *lenp=rsm->outUsed-rsm->outSent;
+  return(rsm->outBuf+rsm->outSent);
+}
+
+void
+respStreamWritten(RESPSTREAM *rsm,size_t n)
+{
+  rsm->outSent+=n<rsm->outUsed-rsm->outSent?n:rsm->outUsed-rsm->outSent;
+  if(rsm->outSent==rsm->outUsed)
+    rsm->outUsed=rsm->outSent=0;
+}
+
+
+/* ********************************** input ********************************* */
+
+// drops the replies handed out by the last respFeed()
+static void
+dropTaken(RESPSTREAM *rsm)
+{
+  if(!rsm->inTaken)
+    return;
+  memmove(rsm->inBuf,rsm->inBuf+rsm->inTaken,rsm->inUsed-rsm->inTaken);
+  rsm->inUsed-=rsm->inTaken;
+  rsm->inTaken=0;
+  rsm->parsing=0; // the partial reply moved under the parser
+}
+
+// makes room for want more bytes, keeping the parser's pointers right if it's mid reply
+static int
+growInput(RESPSTREAM *rsm,size_t want)
+{
+  size_t newSize=rsm->inSize;
+  byte  *newBuf;
+
+  if(rsm->inUsed+want<=rsm->inSize)
+    return(RAMISOK);
+  while(newSize<rsm->inUsed+want)
+    newSize*=2;
+  if(rsm->parsing)
+    newBuf=respBufRealloc(rsm->rpp,rsm->inBuf,newSize);
+  else
+    newBuf=ramisRealloc(rsm->inBuf,newSize);
+  if(!newBuf)
+  {
+    rsm->errorMsg="Could not expand the input buffer in respFeed()";
+    return(RAMISFAIL);
+  }
+  rsm->inBuf=newBuf;
+  rsm->inSize=newSize;
+  return(RAMISOK);
+}
+
+byte *
+respStreamReadBuf(RESPSTREAM *rsm,size_t want,size_t *roomp)
+{
+  dropTaken(rsm);
+  if(!growInput(rsm,want?want:RESPCLIENTBUFSZ))
+    return(NULL);
+  *roomp=rsm->inSize-rsm->inUsed;
+  return(rsm->inBuf+rsm->inUsed);
+}
+
+int
+respFeed(RESPSTREAM *rsm,const byte *bytes,size_t n)
+{
+  int parseRet;
+
+  rsm->errorMsg=NULL;
+  if(bytes!=rsm->inBuf+rsm->inUsed || rsm->inTaken) // not read in place by respStreamReadBuf()
+  {
+    dropTaken(rsm);
+    if(!growInput(rsm,n))
+      return(-1);
+    memcpy(rsm->inBuf+rsm->inUsed,bytes,n);
+  }
+  rsm->inUsed+=n;
+
+  parseRet=parseResProto(rsm->rpp,rsm->inBuf,rsm->inUsed,!rsm->parsing);
+  if(parseRet==RESP_PARSE_ERROR)
+  {
+    rsm->errorMsg=rsm->rpp->errorMsg;
+    rsm->parsing=0;
+    return(-1);
+  }
+  rsm->parsing=1;
+  if(rsm->rpp->nReplies)
+  {
+    rsm->inTaken=rsm->rpp->replyEnd-rsm->inBuf;
+    rsm->nPending-=rsm->rpp->nReplies<rsm->nPending?rsm->rpp->nReplies:rsm->nPending;
+  }
+  return(rsm->rpp->nReplies);
+}
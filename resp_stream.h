@@ -0,0 +1,62 @@
+//
+//  resp_stream.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  The protocol without the I/O, for event loops like libuv or libevent. Commands are encoded
+//  into an output buffer the loop writes when the socket is writable, and whatever the loop
+//  reads is fed in and comes back as the replies that are complete. Nothing here blocks,
+//  polls, times out or reconnects; that's left to the loop.
+//
+
+#ifndef resp_stream_h
+#define resp_stream_h
+#include "respClient.h"
+
+#define RESPWANTREAD   1 // replies are outstanding
+#define RESPWANTWRITE  2 // encoded commands are waiting to be written
+
+#define RESPSTREAM struct respStreamStruct
+RESPSTREAM
+{
+  RESPROTO *rpp;       // replies from the last respFeed(), items[0..rpp->nReplyItems-1]
+  byte     *inBuf;     // bytes fed in
+  size_t    inSize;
+  size_t    inUsed;
+  size_t    inTaken;   // the front of inBuf that rpp's replies are in, dropped by the next respFeed()
+  int       parsing;   // rpp has parsed inBuf up to a partial reply and can pick up from there
+  byte     *outBuf;    // encoded commands
+  size_t    outSize;
+  size_t    outUsed;
+  size_t    outSent;   // how much of outBuf the loop has written
+  int       nPending;  // commands encoded whose replies haven't come back
+  char     *errorMsg;  // set when something fails
+};
+
+RESPSTREAM * newRespStream(void);
+RESPSTREAM * freeRespStream(RESPSTREAM *rsm);
+
+// queues a command formatted like sendRespCommand() or given as an argument vector
+int respStreamCommand(RESPSTREAM *rsm,char *fmt,...);
+int respStreamCommandArgv(RESPSTREAM *rsm,int argc,const char **argv,const size_t *argvlen);
+
+// RESPWANTREAD and/or RESPWANTWRITE. A subscriber should read even when this is 0
+int respStreamWants(RESPSTREAM *rsm);
+
+// the encoded bytes still to be written. Tell the stream how many were with respStreamWritten()
+byte * respStreamOutput(RESPSTREAM *rsm,size_t *lenp);
+void respStreamWritten(RESPSTREAM *rsm,size_t n);
+
+// room for at least want bytes to be read into directly, *roomp is set to how much there is.
+// Pass the same pointer to respFeed() and they aren't copied. NULL if memory runs out
+byte * respStreamReadBuf(RESPSTREAM *rsm,size_t want,size_t *roomp);
+
+// adds n bytes read from the server and returns how many replies are now complete, they are in
+// rsm->rpp until the next call. -1 with rsm->errorMsg set if the server sent garbage
+int respFeed(RESPSTREAM *rsm,const byte *bytes,size_t n);
+
+// forgets everything queued, fed and pending, for when the loop makes a new connection
+void respStreamReset(RESPSTREAM *rsm);
+
+#endif /* resp_stream_h */
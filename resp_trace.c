@@ -0,0 +1,198 @@
+//
+//  resp_trace.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  A command starts with its first timed phase and ends when its reply is parsed or it
+//  fails. Pipelined commands sent before that are counted as part of the first one.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ramis.h"
+#include "resp_trace.h"
+
+static const char *phaseNames[RESPTRACEPHASES]={"encode","send","wait","parse"};
+
+
+RESPTRACE *
+freeRespTrace(RESPTRACE *rtp)
+{
+  if(rtp)
+  {
+    if(rtp->slowLog)
+      ramisFree(rtp->slowLog);
+    ramisFree(rtp);
+  }
+  return(NULL);
+}
+
+RESPTRACE *
+newRespTrace(respTraceHook hook,void *hookData,uint64_t slowNs,int nSlowLog)
+{
+  RESPTRACE *rtp=ramisCalloc(1,sizeof(RESPTRACE));
+
+  if(!rtp)
+    return(NULL);
+  rtp->hook=hook;
+  rtp->hookData=hookData;
+  rtp->slowNs=slowNs;
+  if(nSlowLog>0 && !(rtp->slowLog=ramisCalloc(nSlowLog,sizeof(RESPSLOWENTRY))))
+    return(freeRespTrace(rtp));
+  rtp->nSlowLog=nSlowLog>0?nSlowLog:0;
+  return(rtp);
+}
+
+static void
+startCommand(RESPTRACE *rtp,uint64_t startNs)
+{
+  rtp->active=1;
+  rtp->startNs=startNs;
+  memset(rtp->phaseNs,0,sizeof(rtp->phaseNs));
+  *rtp->command='\0';
+  *rtp->key='\0';
+}
+
+uint64_t
+respTracePhase(RESPTRACE *rtp,int phase,uint64_t startNs)
+{
+  uint64_t now=respTraceNow();
+
+  if(!rtp->active)
+    startCommand(rtp,startNs);
+  rtp->phaseNs[phase]+=now-startNs;
+  if(rtp->hook)
+    (*rtp->hook)(rtp->hookData,phase,startNs,now);
+  return(now);
+}
+
+// finds the bulk string at *pp, "$L\r\n...\r\n", and leaves *pp after it. NULL if there isn't one
+static const uint8_t *
+nextBulkString(const uint8_t **pp,const uint8_t *end,size_t *lenp)
+{
+  const uint8_t *p=*pp;
+  size_t len=0;
+
+  if(p>=end || *p!='$')
+    return(NULL);
+  for(++p;p<end && isdigit(*p);p++)
+    len=len*10+(*p-'0');
+  p+=2;
+  if(p>end || len>(size_t)(end-p))
+    return(NULL);
+  *lenp=len;
+  *pp=p+len+2;
+  return(p);
+}
+
+// copies what fits of a name or key, leaving room for the '\0'
+static void
+copyTruncated(char *dst,size_t dstSize,const uint8_t *src,size_t len)
+{
+  if(len>dstSize-1)
+    len=dstSize-1;
+  memcpy(dst,src,len);
+  dst[len]='\0';
+}
+
+void
+respTraceRequest(RESPTRACE *rtp,const uint8_t *buf,size_t n)
+{
+  const uint8_t *p=buf,*end=buf+n,*s;
+  size_t len;
+
+  if(!rtp->active)
+    startCommand(rtp,respTraceNow());
+  if(*rtp->command) // pipelined behind the one being traced
+    return;
+  if(n<4 || *p!='*' || !(p=memchr(p,'\n',n)))
+    return;
+  ++p;
+  if(!(s=nextBulkString(&p,end,&len)))
+    return;
+  copyTruncated(rtp->command,sizeof(rtp->command),s,len);
+  if((s=nextBulkString(&p,end,&len)))
+    copyTruncated(rtp->key,sizeof(rtp->key),s,len);
+}
+
+void
+respTraceDone(RESPTRACE *rtp,int failed)
+{
+  RESPSLOWENTRY *ep;
+  uint64_t total;
+
+  if(!rtp->active)
+    return;
+  rtp->active=0;
+  total=respTraceNow()-rtp->startNs;
+  if(!rtp->nSlowLog || total<rtp->slowNs)
+    return;
+
+  ep=&rtp->slowLog[rtp->nSlow%rtp->nSlowLog];
+  ep->id=rtp->nSlow++;
+  ep->when=time(NULL);
+  ep->totalNs=total;
+  memcpy(ep->phaseNs,rtp->phaseNs,sizeof(ep->phaseNs));
+  ep->failed=failed;
+  memcpy(ep->command,rtp->command,sizeof(ep->command));
+  memcpy(ep->key,rtp->key,sizeof(ep->key));
+}
+
+int
+respTraceSlowLog(const RESPTRACE *rtp,RESPSLOWENTRY *out,int max)
+{
+  uint64_t id;
+  int n=0;
+
+  if(!rtp || !rtp->nSlowLog)
+    return(0);
+  for(id=rtp->nSlow;id>0 && n<max && n<rtp->nSlowLog;id--)
+    out[n++]=rtp->slowLog[(id-1)%rtp->nSlowLog];
+  return(n);
+}
+
+// keys can be binary, anything unprintable is shown as a '.'
+static void
+printSafely(FILE *fh,const char *s)
+{
+  for(;*s;s++)
+    fputc(isprint((unsigned char)*s)?*s:'.',fh);
+}
+
+void
+respTraceDump(const RESPTRACE *rtp,FILE *fh)
+{
+  const RESPSLOWENTRY *ep;
+  char when[32];
+  uint64_t id;
+  int i,n=0;
+
+  if(!rtp || !rtp->nSlowLog)
+    return;
+  for(id=rtp->nSlow;id>0 && n<rtp->nSlowLog;id--,n++)
+  {
+    ep=&rtp->slowLog[(id-1)%rtp->nSlowLog];
+    strftime(when,sizeof(when),"%Y-%m-%d %H:%M:%S",localtime(&ep->when));
+    fprintf(fh,"%llu %s %.3fms%s ",(unsigned long long)ep->id,when,ep->totalNs/1e6,ep->failed?" FAILED":"");
+    printSafely(fh,*ep->command?ep->command:"?");
+    if(*ep->key)
+    {
+      fputc(' ',fh);
+      printSafely(fh,ep->key);
+    }
+    for(i=0;i<RESPTRACEPHASES;i++)
+      fprintf(fh," %s=%.3fms",phaseNames[i],ep->phaseNs[i]/1e6);
+    fputc('\n',fh);
+  }
+}
+
+void
+respTraceReset(RESPTRACE *rtp)
+{
+  rtp->nSlow=0;
+  if(rtp->slowLog)
+    memset(rtp->slowLog,0,rtp->nSlowLog*sizeof(RESPSLOWENTRY));
+}
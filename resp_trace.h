@@ -0,0 +1,93 @@
+//
+//  resp_trace.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Times the phases of each command: encoding it, sending it, waiting on the socket for the
+//  reply and parsing it. A hook can be called as each phase ends, and commands that take
+//  longer than a threshold are kept in a fixed size ring, the slow log, with a breakdown.
+//  When tracing is off the client's only cost is a NULL check per phase.
+//
+
+#ifndef resp_trace_h
+#define resp_trace_h
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define RESPTRACEENCODE   0 // formatting the command into the send buffer
+#define RESPTRACESEND     1 // send() calls
+#define RESPTRACEWAIT     2 // poll() and recv() until the reply is in
+#define RESPTRACEPARSE    3 // parseResProto() and decompression
+#define RESPTRACEPHASES   4
+
+#define RESPSLOWNAMELEN  16 // command names and keys are truncated to fit these
+#define RESPSLOWKEYLEN   40
+
+// called as each phase of a command ends, times are CLOCK_MONOTONIC nanoseconds
+typedef void (*respTraceHook)(void *hookData,int phase,uint64_t startNs,uint64_t endNs);
+
+#define RESPSLOWENTRY struct respSlowEntryStruct
+RESPSLOWENTRY
+{
+  uint64_t id;                      // counts up from 0 for each slow command logged
+  time_t   when;                    // wall clock time it finished
+  uint64_t totalNs;                 // from the start of encoding to the end of parsing
+  uint64_t phaseNs[RESPTRACEPHASES];
+  int      failed;                  // it ended with an error rather than a reply
+  char     command[RESPSLOWNAMELEN];
+  char     key[RESPSLOWKEYLEN];     // its first argument
+};
+
+#define RESPTRACE struct respTraceStruct
+RESPTRACE
+{
+  respTraceHook  hook;              // may be NULL
+  void          *hookData;
+  uint64_t       slowNs;            // commands taking at least this long are logged
+  RESPSLOWENTRY *slowLog;           // a ring of the most recent nSlowLog slow commands
+  int            nSlowLog;
+  uint64_t       nSlow;             // slow commands ever logged, the next goes in slowLog[nSlow%nSlowLog]
+
+  // the command in progress
+  int            active;
+  uint64_t       startNs;
+  uint64_t       phaseNs[RESPTRACEPHASES];
+  char           command[RESPSLOWNAMELEN];
+  char           key[RESPSLOWKEYLEN];
+};
+
+// nSlowLog may be 0 to only call the hook
+RESPTRACE * newRespTrace(respTraceHook hook,void *hookData,uint64_t slowNs,int nSlowLog);
+RESPTRACE * freeRespTrace(RESPTRACE *rtp);
+
+static inline uint64_t
+respTraceNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec);
+}
+
+// adds the time since startNs to a phase of the current command, starting one if need be
+// returns the time now so phases can be chained
+uint64_t respTracePhase(RESPTRACE *rtp,int phase,uint64_t startNs);
+
+// notes the name and first argument of the command in the RESP encoded buf being sent
+void respTraceRequest(RESPTRACE *rtp,const uint8_t *buf,size_t n);
+
+// the current command is finished, it's logged if it was slow
+void respTraceDone(RESPTRACE *rtp,int failed);
+
+// copies up to max slow log entries into out, newest first. Returns how many
+int respTraceSlowLog(const RESPTRACE *rtp,RESPSLOWENTRY *out,int max);
+
+// prints the slow log, newest first
+void respTraceDump(const RESPTRACE *rtp,FILE *fh);
+
+// empties the slow log
+void respTraceReset(RESPTRACE *rtp);
+
+#endif /* resp_trace_h */
@@ -0,0 +1,203 @@
+//
+//  resp_transaction.c
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  MULTI, each queued command and EXEC are encoded back to back into one buffer.
+//  The server's replies (+OK, a +QUEUED per command, then the EXEC array) come
+//  back as one pipelined stream which is parsed into a single items list.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ramis.h"
+#include "resp_protocol.h"
+#include "respClient.h"
+#include "resp_transaction.h"
+
+static const char *multiArgv[]={"MULTI"};
+static const char *execArgv[]={"EXEC"};
+
+
+RESPTRANS *
+respTransactionFree(RESPTRANS *rtp)
+{
+  if(rtp)
+  {
+    if(rtp->buf)
+      ramisFree(rtp->buf);
+    if(rtp->results)
+      ramisFree(rtp->results);
+    ramisFree(rtp);
+  }
+  return(NULL);
+}
+
+void
+respTransactionDiscard(RESPTRANS *rtp)
+{
+  rtp->nCommands=0;
+  rtp->used=respEncodeArgv(&rtp->buf,&rtp->bufSize,0,1,multiArgv,NULL); // it fits, it was there before
+}
+
+RESPTRANS *
+respTransactionBegin(RESPCLIENT *rcp)
+{
+  RESPTRANS *rtp=ramisCalloc(1,sizeof(RESPTRANS));
+  ssize_t n;
+
+  if(!rtp)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respTransactionBegin";
+    return(NULL);
+  }
+  rtp->rcp=rcp;
+  rtp->failedCommand=-1;
+  n=respEncodeArgv(&rtp->buf,&rtp->bufSize,0,1,multiArgv,NULL);
+  if(n<0)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respTransactionBegin";
+    return(respTransactionFree(rtp));
+  }
+  rtp->used=n;
+  return(rtp);
+}
+
+int
+respTransactionAdd(RESPTRANS *rtp,int argc,const char **argv,const size_t *argvlen)
+{
+  ssize_t n=respEncodeArgv(&rtp->buf,&rtp->bufSize,rtp->used,argc,argv,argvlen);
+
+  if(n<0)
+  {
+    rtp->rcp->rppFrom->errorMsg="Memory allocation error in respTransactionAdd";
+    return(RAMISFAIL);
+  }
+  rtp->used+=n;
+  rtp->nCommands++;
+  return(RAMISOK);
+}
+
+int
+respTransactionAddf(RESPTRANS *rtp,char *fmt,...)
+{
+  va_list arg;
+  ssize_t n;
+
+  va_start(arg,fmt);
+  n=appendRespCommandV(rtp->rcp,&rtp->buf,&rtp->bufSize,rtp->used,fmt,&arg);
+  va_end(arg);
+
+  if(n<0)
+    return(RAMISFAIL);
+  rtp->used+=n;
+  rtp->nCommands++;
+  return(RAMISOK);
+}
+
+
+// makes sure there's room to remember where each command's result is
+static int
+growTransactionResults(RESPTRANS *rtp)
+{
+  int *newResults;
+
+  if(rtp->maxResults>=rtp->nCommands)
+    return(RAMISOK);
+  newResults=ramisRealloc(rtp->results,rtp->nCommands*sizeof(int));
+  if(!newResults)
+    return(RAMISFAIL);
+  rtp->results=newResults;
+  rtp->maxResults=rtp->nCommands;
+  return(RAMISOK);
+}
+
+
+RESPROTO *
+respTransactionExec(RESPTRANS *rtp)
+{
+  RESPCLIENT *rcp=rtp->rcp;
+  RESPROTO   *rpp;
+  RESPITEM   *items;
+  char       *queueError=NULL;
+  int         i,c,span;
+  int         nCommands=rtp->nCommands;
+  ssize_t     n;
+
+  rtp->nResults=0;
+  rtp->failedCommand=-1;
+  rtp->aborted=0;
+
+  if(!growTransactionResults(rtp) || (n=respEncodeArgv(&rtp->buf,&rtp->bufSize,rtp->used,1,execArgv,NULL))<0)
+  {
+    rcp->rppFrom->errorMsg="Memory allocation error in respTransactionExec";
+    return(NULL);
+  }
+
+  // everything goes in one write, the builder is ready for the next transaction after that
+  rcp->rppFrom->errorMsg=NULL;
+  i=transmitRespCommand(rcp,rtp->buf,rtp->used+n);
+  respTransactionDiscard(rtp);
+  if(!i || !(rpp=getRespReplies(rcp,nCommands+2)))
+    return(NULL);
+
+  items=rpp->items;
+  if(items[0].respType==RESPISERRORMSG) // MULTI itself was refused, nested MULTI perhaps
+    return(NULL);
+
+  // check the acknowledgements all at once, the first refusal is the one worth reporting
+  for(i=1,c=0;c<nCommands;c++,i+=span)
+  {
+    span=respReplySpan(items,rpp->nItems,i);
+    if(!span)
+    {
+      rpp->errorMsg="Incomplete reply to queued command in respTransactionExec()";
+      return(NULL);
+    }
+    if(items[i].respType==RESPISERRORMSG && rtp->failedCommand<0)
+    {
+      rtp->failedCommand=c;
+      queueError=(char *)items[i].loc;
+    }
+  }
+
+  if(i>=rpp->nItems)
+  {
+    rpp->errorMsg="Missing reply to EXEC in respTransactionExec()";
+    return(NULL);
+  }
+  if(items[i].respType==RESPISERRORMSG) // EXECABORT
+  {
+    rpp->errorMsg=queueError?queueError:(char *)items[i].loc;
+    return(NULL);
+  }
+  if(items[i].respType==RESPISNULL)
+  {
+    rtp->aborted=1;
+    rpp->errorMsg="Transaction aborted because a WATCHed key changed";
+    return(NULL);
+  }
+  if(items[i].respType!=RESPISARRAY || items[i].nItems!=(uint64_t)nCommands)
+  {
+    rpp->errorMsg="Unexpected reply to EXEC in respTransactionExec()";
+    return(NULL);
+  }
+
+  for(++i,c=0;c<nCommands;c++,i+=span)
+  {
+    span=respReplySpan(items,rpp->nItems,i);
+    rtp->results[c]=i;
+  }
+  rtp->nResults=nCommands;
+  return(rpp);
+}
+
+RESPITEM *
+respTransactionResult(RESPTRANS *rtp,int i)
+{
+  if(i<0 || i>=rtp->nResults)
+    return(NULL);
+  return(&rtp->rcp->rppFrom->items[rtp->results[i]]);
+}
@@ -0,0 +1,51 @@
+//
+//  resp_transaction.h
+//  ramis_client
+//
+//  Copyright © 2020 P. B. Richards. All rights reserved.
+//
+//  Builds a MULTI ... EXEC transaction in memory and sends it in a single write,
+//  so the whole transaction costs one round trip instead of one per command.
+//
+
+#ifndef resp_transaction_h
+#define resp_transaction_h
+#include "respClient.h"
+
+#define RESPTRANS struct respTransactionStruct
+RESPTRANS
+{
+  RESPCLIENT *rcp;
+  byte      *buf;          // MULTI followed by the queued commands
+  size_t     bufSize;
+  size_t     used;
+  int        nCommands;    // commands added since MULTI
+  int       *results;      // after EXEC, index in rcp->rppFrom->items of each command's result
+  int        maxResults;
+  int        nResults;     // how many results there are, 0 if EXEC didn't run them
+  int        failedCommand;// if the server refused to queue a command this is its index, otherwise -1
+  int        aborted;      // EXEC returned NULL because a WATCHed key changed
+};
+
+// starts building a transaction, WATCH if needed should already have been sent on rcp
+RESPTRANS * respTransactionBegin(RESPCLIENT *rcp);
+
+// queues a command given as an argument vector, argvlen may be NULL for '\0' terminated args
+int respTransactionAdd(RESPTRANS *rtp,int argc,const char **argv,const size_t *argvlen);
+
+// queues a command formatted like sendRespCommand()
+int respTransactionAddf(RESPTRANS *rtp,char *fmt,...);
+
+// sends MULTI, the commands and EXEC in one write and reads all the replies.
+// returns the reply list or NULL if the transaction failed, see respClienError()
+RESPROTO * respTransactionExec(RESPTRANS *rtp);
+
+// the first item of the result of the i'th command, use respReplySpan() for nested results
+RESPITEM * respTransactionResult(RESPTRANS *rtp,int i);
+
+// throws away the queued commands so the builder can be reused, nothing is sent
+void respTransactionDiscard(RESPTRANS *rtp);
+
+RESPTRANS * respTransactionFree(RESPTRANS *rtp);
+
+#endif /* resp_transaction_h */